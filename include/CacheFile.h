@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// 网格/纹理/程序三种磁盘缓存共用的部分: 源文件的键、文件头的魔数与版本校验、FNV-1a 哈希,
+// 以及先写临时文件再改名的写入方式 (写到一半失败不会留下损坏的缓存)
+namespace CacheFile
+{
+    constexpr std::uint64_t HASH_SEED = 14695981039346656037ull;
+
+    // 累加 text 的 FNV-1a 哈希, 末尾加一个分隔符, 避免 "ab"+"c" 与 "a"+"bc" 得到同一个值
+    std::uint64_t Hash(std::uint64_t h, std::string_view text);
+
+    // 源文件的修改时间和大小, 文件不存在时返回false
+    bool SourceKey(std::string const &sourcePath, std::int64_t &mtime, std::uint64_t &size);
+
+    // 文件开头是否为 magic 加上当前版本号. 每种缓存的文件头都以 char[4] 魔数和 uint32 版本开始
+    bool CheckMagic(const unsigned char *data, std::size_t size, const char (&magic)[4], std::uint32_t version);
+
+    // 调用 writer 写入 <path>.tmp, 流状态正常时再改名为 path. 失败时打印 ERROR::<tag>::WRITE_FAILED 并删除临时文件
+    bool Write(std::string const &path, const char *tag, std::function<void(std::ofstream &)> const &writer);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GeometryPool.h>
+#include <InstanceBatch.h>
+#include <RadixSort.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Mesh;
+class ShaderProgram;
+
+// 一帧内收集的绘制命令. Submit 时按材质分组, 每组用一次 glMultiDrawElementsIndirect 提交;
+// 每次绘制的模型矩阵和材质号放进 InstanceBatch, 以 baseInstance 索引. 着色器需以 INSTANCED 编译.
+// 没有 GL_ARB_multi_draw_indirect 或 GL_ARB_base_instance 时每个命令一次 glDrawElementsInstancedBaseVertex. 只能在GL线程上使用
+class DrawCommandBuffer
+{
+public:
+    DrawCommandBuffer();
+    ~DrawCommandBuffer();
+    DrawCommandBuffer(const DrawCommandBuffer &) = delete;
+    DrawCommandBuffer &operator=(const DrawCommandBuffer &) = delete;
+
+    // 网格必须在 GeometryPool 中 (ModelLoadOptions::geometryPool), 且在 Submit 之前一直存在
+    void Add(Mesh &mesh, unsigned int lod, glm::mat4 const &model, std::uint32_t material = 0);
+    // 提交并清空
+    void Submit(ShaderProgram &shader);
+    std::size_t Size() const noexcept { return entries.size(); }
+
+    // 当前上下文是否支持带 baseInstance 的间接多重绘制
+    static bool MultiDrawIndirectSupported() noexcept;
+
+private:
+    struct Entry
+    {
+        Mesh *mesh;
+        DrawElementsIndirectCommand command;
+        InstanceData instance;
+    };
+
+    std::vector<Entry> entries;
+    // Submit 中按材质排好序的数据, 每帧复用
+    std::vector<std::uint64_t> order, scratch;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<InstanceData> instances;
+    InstanceBatch batch;
+    GLuint commandBuffer = 0;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// 视锥体: 6个归一化平面 (法线指向内侧), ax + by + cz + d >= 0 表示在内侧
+class Frustum
+{
+public:
+    // 从裁剪矩阵提取平面 (Gribb & Hartmann). 传入 projection * view 得到世界空间平面,
+    // 传入 projection * view * model 得到该模型物体空间中的平面
+    explicit Frustum(glm::mat4 const &clip) noexcept;
+
+    bool IntersectsSphere(glm::vec3 const &center, float radius) const noexcept;
+    // 轴对齐包围盒: 对每个平面只测离平面最远的内侧角点
+    bool IntersectsBox(glm::vec3 const &min, glm::vec3 const &max) const noexcept;
+
+    glm::vec4 const &GetPlane(int i) const noexcept { return planes[i]; }
+
+private:
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+};
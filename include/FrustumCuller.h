@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Frustum.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 一组轴对齐包围盒的视锥剔除. 包围盒按分量分开存放 (SoA), 用 SSE 一次测4个, 编译时打开 AVX 则一次8个;
+// 包围盒很多时分块到 ThreadPool::Global() 上并行. 每次 Cull 的个数和时间累加到 renderStats
+class FrustumCuller
+{
+public:
+    void Clear() noexcept;
+    void Reserve(std::size_t count);
+    // 加入一个包围盒, 返回它的下标
+    std::size_t Add(glm::vec3 const &min, glm::vec3 const &max);
+    // 加入经 transform 变换后的包围盒的外接AABB
+    std::size_t Add(glm::vec3 const &min, glm::vec3 const &max, glm::mat4 const &transform);
+    std::size_t Size() const noexcept { return minX.size(); }
+    glm::vec3 GetMin(std::size_t index) const noexcept { return glm::vec3(minX[index], minY[index], minZ[index]); }
+    glm::vec3 GetMax(std::size_t index) const noexcept { return glm::vec3(maxX[index], maxY[index], maxZ[index]); }
+
+    // 与 frustum 相交的包围盒下标按升序写入 visible, 返回个数. 平面与包围盒在同一空间中.
+    // parallel 为 false 时只在调用线程上测试
+    std::size_t Cull(Frustum const &frustum, std::vector<std::uint32_t> &visible, bool parallel = true);
+
+    // 少于这个数的包围盒不分块, 分块时每块的大小也不小于它
+    static constexpr std::size_t MIN_BOXES_PER_TASK = 4096;
+
+private:
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    // 并行时每块的结果, 每帧复用
+    std::vector<std::vector<std::uint32_t>> chunks;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <utility>
+#include <vector>
+
+// 当前上下文中绑定状态的缓存: 程序、VAO、纹理单元、缓冲绑定和 glEnable 开关.
+// 与缓存相同的设置不发给驱动, 发出和跳过的次数计入 renderStats.
+// 缓存只有在所有修改都经过这里时才正确: 直接调用GL改了这些状态的代码之后要调用 Invalidate.
+// 只能在GL线程上使用
+class GLState
+{
+public:
+    // 缓存绑定的纹理单元数, 更高的单元每次都直接绑定
+    static constexpr unsigned int MAX_TEXTURE_UNITS = 32;
+
+    static GLState &Instance();
+
+    GLState(const GLState &) = delete;
+    GLState &operator=(const GLState &) = delete;
+
+    // 以下返回是否真的调用了GL
+    bool UseProgram(GLuint program);
+    bool BindVertexArray(GLuint vertexArray);
+    bool ActiveTexture(unsigned int unit);
+    // 切换到 unit 并绑定, 返回是否调用了 glBindTexture. 只缓存 GL_TEXTURE_2D 和 GL_TEXTURE_2D_ARRAY
+    bool BindTexture(unsigned int unit, GLenum target, GLuint texture);
+    // 绑定到当前活动的纹理单元
+    bool BindTexture(GLenum target, GLuint texture);
+    // GL_ELEMENT_ARRAY_BUFFER 属于VAO的状态, 切换VAO后重新变为未知
+    bool BindBuffer(GLenum target, GLuint buffer);
+    // 同时设置 target 的通用绑定点, 与GL的行为一致
+    bool BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    bool Enable(GLenum capability);
+    bool Disable(GLenum capability);
+
+    // 在 glDelete* 之后调用: GL把删除的对象从当前上下文的绑定上解除, 它的名字之后可能被复用
+    void DeletedProgram(GLuint program) noexcept;
+    void DeletedVertexArray(GLuint vertexArray) noexcept;
+    void DeletedTexture(GLuint texture) noexcept;
+    void DeletedBuffer(GLuint buffer) noexcept;
+
+    // 所有状态变为未知, 下一次设置总会调用GL
+    void Invalidate() noexcept;
+
+private:
+    GLState();
+
+    // 未知的状态, 与任何名字都不相等
+    static constexpr GLuint UNKNOWN = ~0u;
+
+    struct TextureBinding
+    {
+        GLuint texture2D = UNKNOWN, textureArray = UNKNOWN;
+    };
+
+    // 返回 target 的缓存槽, 不缓存的 target 返回nullptr
+    GLuint *bufferSlot(GLenum target) noexcept;
+    GLuint *textureSlot(unsigned int unit, GLenum target) noexcept;
+    bool setCapability(GLenum capability, bool enabled);
+    // 计数并返回 issue
+    static bool count(bool issue) noexcept;
+
+    GLuint program = UNKNOWN;
+    GLuint vertexArray = UNKNOWN;
+    unsigned int activeUnit = UNKNOWN;
+    TextureBinding textures[MAX_TEXTURE_UNITS];
+    GLuint arrayBuffer = UNKNOWN;
+    GLuint elementBuffer = UNKNOWN;
+    GLuint uniformBuffer = UNKNOWN;
+    GLuint pixelUnpackBuffer = UNKNOWN;
+    GLuint drawIndirectBuffer = UNKNOWN;
+    std::vector<GLuint> uniformBindings; // glBindBufferBase(GL_UNIFORM_BUFFER, i, ...)
+    std::vector<std::pair<GLenum, bool>> capabilities; // 设置过的开关, 数量很少, 线性查找
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class VertexFormat;
+class InstanceBatch;
+
+// glMultiDrawElementsIndirect 的命令格式
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// 所有网格共享的几何缓冲: 每种顶点格式一个大顶点缓冲、一个索引缓冲和一个VAO.
+// 网格的索引保持相对自身顶点, 绘制时用 baseVertex 偏移; 切换网格不再切换VAO,
+// 同一格式的网格可以在一次多重绘制中提交. 释放的区间进入空闲表, 之后的分配先从中找 (首次适配),
+// 缓冲本身只增不减. 只能在GL线程上使用
+class GeometryPool
+{
+public:
+    struct Allocation
+    {
+        GLint baseVertex = 0;
+        unsigned int firstIndex = 0;
+    };
+    struct Stats
+    {
+        std::size_t vertexBytes = 0, indexBytes = 0; // 已分配且未释放
+        std::size_t capacityBytes = 0;               // 所有缓冲的容量
+        std::size_t growths = 0;                     // 扩容复制的次数
+        std::size_t reuses = 0;                      // 从空闲表中分配的区间数
+    };
+
+    static GeometryPool &Instance();
+
+    GeometryPool(const GeometryPool &) = delete;
+    GeometryPool &operator=(const GeometryPool &) = delete;
+
+    // vertexBytes 为 vertexCount 个 format 格式的顶点; 容量不够时扩容, 已有数据在GPU上复制过去
+    Allocation Allocate(VertexFormat format, const void *vertices, std::size_t vertexCount, const unsigned int *indices,
+                        std::size_t indexCount);
+    // 归还 Allocate 得到的区间, 计数须与分配时相同
+    void Free(VertexFormat format, Allocation allocation, std::size_t vertexCount, std::size_t indexCount);
+    GLuint GetVertexArray(VertexFormat format) const noexcept;
+    // 把 format 的VAO的实例属性指向 batch 的第 first 个实例起, 与当前相同时跳过. VAO需已绑定
+    void AttachInstances(VertexFormat format, InstanceBatch const &batch, std::size_t first = 0);
+    Stats GetStats() const noexcept { return stats; }
+
+private:
+    GeometryPool();
+
+    // 初始容量, 不够时翻倍
+    static constexpr std::size_t INITIAL_VERTICES = 1 << 16;
+    static constexpr std::size_t INITIAL_INDICES = 1 << 18;
+    static constexpr int FORMAT_COUNT = 3;
+
+    // 以顶点或索引为单位的区间
+    struct Range
+    {
+        std::size_t offset, count;
+    };
+
+    struct Arena
+    {
+        GLuint vertexArray = 0, vertexBuffer = 0, indexBuffer = 0;
+        std::size_t vertexCount = 0, vertexCapacity = 0; // vertexCount: 已用部分的末尾
+        std::size_t indexCount = 0, indexCapacity = 0;
+        std::vector<Range> freeVertices, freeIndices; // 按起点排序, 相邻的已合并
+        std::uint64_t instanceSerial = 0; // AttachInstances 当前挂上的批次和起点
+        std::size_t instanceFirst = 0;
+    };
+
+    Arena &arena(VertexFormat format) noexcept { return arenas[static_cast<int>(format)]; }
+    void create(Arena &arena, VertexFormat format);
+    // 把 buffer 换成容量为 bytes 的新缓冲, 复制前 usedBytes 字节
+    void grow(GLuint &buffer, std::size_t usedBytes, std::size_t bytes);
+    // 从空闲表中切出 count 个, 没有足够大的区间时返回 NO_RANGE
+    static std::size_t takeRange(std::vector<Range> &free, std::size_t count) noexcept;
+    // 归还并与相邻区间合并; 到达末尾的空闲区间直接缩回 used
+    static void releaseRange(std::vector<Range> &free, std::size_t &used, std::size_t offset, std::size_t count);
+    static constexpr std::size_t NO_RANGE = ~std::size_t(0);
+
+    Arena arenas[FORMAT_COUNT];
+    Stats stats;
+};
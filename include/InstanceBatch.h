@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 一个实例: 模型矩阵和材质号. 着色器以 INSTANCED 宏编译时从实例属性读取 (见 modeling.vs)
+struct InstanceData
+{
+    glm::mat4 model{1.0f};
+    std::uint32_t material = 0;
+};
+
+// 每实例数据的顶点缓冲. 以 divisor 为1的属性挂到VAO上, 一次 glDraw*Instanced 画完所有实例,
+// 绘制的CPU开销与实例数无关; 只有 Update 时拷贝一次数据. 只能在GL线程上使用
+class InstanceBatch
+{
+public:
+    // 模型矩阵的四列占用 MODEL_ATTRIBUTE .. MODEL_ATTRIBUTE + 3, 材质号为整数属性 MATERIAL_ATTRIBUTE
+    static constexpr GLuint MODEL_ATTRIBUTE = 5;
+    static constexpr GLuint MATERIAL_ATTRIBUTE = 9;
+
+    InstanceBatch();
+    ~InstanceBatch();
+    InstanceBatch(const InstanceBatch &) = delete;
+    InstanceBatch &operator=(const InstanceBatch &) = delete;
+
+    // 整个替换实例数据. 每次重新分配缓冲存储, 不等待GPU读完上一次的数据
+    void Update(InstanceData const *instances, std::size_t count);
+    void Update(std::vector<InstanceData> const &instances) { Update(instances.data(), instances.size()); }
+
+    std::size_t Count() const noexcept { return count; }
+    // 进程内唯一, 不会像缓冲名那样在删除后被复用; 网格用它判断VAO上挂的是不是这个批次
+    std::uint64_t GetSerial() const noexcept { return serial; }
+
+    // 把当前绑定的VAO的实例属性指向本缓冲的第 first 个实例起
+    void Attach(std::size_t first = 0) const;
+
+private:
+    GLuint buffer = 0;
+    std::size_t count = 0;
+    std::uint64_t serial;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+class ShaderProgram;
+
+struct DirLight
+{
+    glm::vec3 direction{0.0f, -1.0f, 0.0f};
+    glm::vec3 ambient{0.0f}, diffuse{0.0f}, specular{0.0f};
+};
+
+struct PointLight
+{
+    glm::vec3 position{0.0f};
+    glm::vec3 ambient{0.0f}, diffuse{0.0f}, specular{0.0f};
+    // 距离衰减
+    float constant = 1.0f, linear = 0.0f, quadratic = 0.0f;
+};
+
+struct SpotLight
+{
+    glm::vec3 position{0.0f}, direction{0.0f, 0.0f, -1.0f};
+    glm::vec3 ambient{0.0f}, diffuse{0.0f}, specular{0.0f};
+    float constant = 1.0f, linear = 0.0f, quadratic = 0.0f;
+    float cutOff = 1.0f, outerCutOff = 1.0f; // 内外锥角的余弦
+};
+
+// 着色器中 std140 uniform块 Lights 的CPU端镜像 (见 materials.fs), 所有程序共享同一份灯光.
+// 修改只记录脏区间, Upload 时写进两个UBO中接下来要用的那个, GPU可能还在读的另一个不动.
+// 只能在GL线程上使用
+class LightBuffer
+{
+public:
+    static constexpr int MAX_POINT_LIGHTS = 4;
+    // Lights 块使用的 uniform buffer 绑定点
+    static constexpr GLuint BINDING = 0;
+
+    struct Stats
+    {
+        std::size_t uploads = 0; // glBufferSubData 次数
+        std::size_t bytes = 0;
+    };
+
+    LightBuffer();
+    ~LightBuffer();
+    LightBuffer(const LightBuffer &) = delete;
+    LightBuffer &operator=(const LightBuffer &) = delete;
+
+    // 值没有变化时不产生脏区间, 每帧重复设置同样的灯光没有代价
+    void SetDirLight(DirLight const &light) noexcept;
+    void SetPointLight(int index, PointLight const &light) noexcept;
+    void SetSpotLight(SpotLight const &light) noexcept;
+
+    // 绘制前每帧调用一次: 有修改时把脏区间写进另一个UBO并绑定到 BINDING
+    void Upload();
+
+    // 把程序中的 Lights 块连接到 BINDING; 程序没有这个块或大小不符时返回false
+    static bool Attach(ShaderProgram const &program);
+
+    Stats const &GetStats() const noexcept { return stats; }
+
+private:
+    // std140: vec3 按16字节对齐, 后面紧跟的一个 float 可以填进它的空位
+    struct DirLightStd140
+    {
+        glm::vec3 direction;
+        float pad0;
+        glm::vec3 ambient;
+        float pad1;
+        glm::vec3 diffuse;
+        float pad2;
+        glm::vec3 specular;
+        float pad3;
+    };
+    struct PointLightStd140
+    {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 ambient;
+        float linear;
+        glm::vec3 diffuse;
+        float quadratic;
+        glm::vec3 specular;
+        float pad0;
+    };
+    struct SpotLightStd140
+    {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 direction;
+        float linear;
+        glm::vec3 ambient;
+        float quadratic;
+        glm::vec3 diffuse;
+        float cutOff;
+        glm::vec3 specular;
+        float outerCutOff;
+    };
+    struct LightsStd140
+    {
+        DirLightStd140 dirLight;
+        PointLightStd140 pointLights[MAX_POINT_LIGHTS];
+        SpotLightStd140 spotLight;
+    };
+    static_assert(sizeof(DirLightStd140) == 64 && sizeof(PointLightStd140) == 64 && sizeof(SpotLightStd140) == 80);
+    static_assert(sizeof(LightsStd140) == 64 + 64 * MAX_POINT_LIGHTS + 80);
+
+    // 每个UBO自上次写入以来被修改过的字节区间 [begin, end)
+    struct DirtyRange
+    {
+        std::size_t begin = 0, end = 0;
+    };
+
+    void write(std::size_t offset, const void *data, std::size_t size) noexcept;
+
+    LightsStd140 lights{};
+    GLuint buffers[2] = {0, 0};
+    DirtyRange dirty[2];
+    unsigned int current = 0; // 当前绑定到 BINDING 的UBO
+    bool changed = false;     // 上次 Upload 之后有修改
+    Stats stats;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// 只读内存映射文件 read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const &path);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    bool IsOpen() const noexcept { return data_ != nullptr; }
+    const unsigned char *Data() const noexcept { return data_; }
+    std::size_t Size() const noexcept { return size_; }
+
+private:
+    const unsigned char *data_;
+    std::size_t size_;
+#ifdef _WIN32
+    void *file_;
+    void *mapping_;
+#else
+    int fd_;
+#endif
+};
@@ -2,10 +2,16 @@
 
 #include <glad/glad.h>
 #include <Shader.h>
+#include <Frustum.h>
+#include <GeometryPool.h>
+#include <InstanceBatch.h>
+#include <TextureManager.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -22,22 +28,172 @@ struct Vertex
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// GPU端顶点格式, 可按网格选择
+enum class VertexFormat
+{
+    Float,        // Vertex, 64 bytes
+    Packed,       // PackedVertex, 16 bytes, 静态网格
+    PackedSkinned // PackedSkinnedVertex, 24 bytes, 带骨骼的网格
+};
+
+// 位置按网格AABB量化为unorm16, 法线八面体编码为snorm16x2, 纹理坐标为half2
+struct PackedVertex
+{
+    std::uint16_t Position[3];
+    std::uint16_t Padding;
+    std::uint32_t Normal;    // packSnorm2x16(octahedron)
+    std::uint32_t TexCoords; // packHalf2x16
+};
+
+struct PackedSkinnedVertex
+{
+    std::uint16_t Position[3];
+    std::uint16_t Padding;
+    std::uint32_t Normal;
+    std::uint32_t TexCoords;
+    std::uint8_t BoneIDs[MAX_BONE_INFLUENCE];
+    std::uint8_t Weights[MAX_BONE_INFLUENCE]; // unorm8
+};
+
 struct Texture
 {
     unsigned int id;
     std::string type;
     std::string path;
+    TextureHandle handle; // 持有引用, 网格存在期间纹理不会被释放
+    int layer = 0;        // handle 为纹理数组时所在的层
+};
+
+// 索引缓冲中的一级LOD, 所有LOD共享同一个顶点缓冲
+struct MeshLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error; // 相对LOD0的物体空间误差
+};
+
+// 网格簇: LOD0 索引中连续的一段三角形, 用于细粒度剔除
+struct Meshlet
+{
+    unsigned int indexOffset;
+    unsigned int triangleCount;
+    glm::vec3 center; // 物体空间包围球
+    float radius;
+    glm::vec3 coneAxis; // 法线锥: 从相机看过去与 coneAxis 的夹角余弦 >= coneCutoff 时整簇背面朝向相机
+    float coneCutoff;   // >= 1 时不做背面剔除
+};
+
+// 导入后、上传GPU前的网格数据 CPU-side mesh produced by the importer (or the mesh cache)
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices; // 有LOD时依次存放 LOD0, LOD1, ...
+    unsigned int materialIndex;
+    bool skinned = false; // 有骨骼权重
+    std::vector<MeshLod> lods; // 为空时整个 indices 就是唯一的一级
+    std::vector<Meshlet> meshlets; // 覆盖LOD0的网格簇, 可以为空
+};
+
+// 材质对应的纹理表 texture table of one material, ids are filled in when the textures are loaded
+struct MaterialData
+{
+    std::vector<Texture> textures;
 };
 
 class Mesh{
 public:
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) ;
-    void Draw(ShaderProgram& shader) noexcept;
+    // pooled: 顶点和索引放进 GeometryPool, 不单独创建缓冲和VAO.
+    // cullBackFaces: 网格闭合, 背面看不见. 绘制时打开 GL_CULL_FACE, 网格簇才做法线锥背面剔除
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+         VertexFormat format = VertexFormat::Float, std::vector<MeshLod> lods = {}, std::vector<Meshlet> meshlets = {},
+         bool pooled = false, bool cullBackFaces = false);
+    // lod: 绘制第几级, 超出范围时画最粗的一级
+    void Draw(ShaderProgram& shader, unsigned int lod = 0) noexcept;
+    // 绘制LOD0, 逐簇做视锥剔除, cullBackFaces 时还做法线锥剔除. 可见簇用一次 glMultiDrawElements 提交.
+    // frustum 与 cameraPosition 都在物体空间; 没有网格簇时退化为 Draw(shader, 0)
+    void DrawClusters(ShaderProgram& shader, Frustum const& frustum, glm::vec3 const& cameraPosition) noexcept;
+    // 用一次 glDrawElementsInstanced 画出 batch 中从 first 起的 count 个实例 (默认全部), 着色器需以 INSTANCED 编译.
+    // 不做逐实例剔除
+    void DrawInstanced(ShaderProgram& shader, InstanceBatch const& batch, unsigned int lod = 0, std::size_t first = 0,
+                       std::size_t count = ~std::size_t(0)) noexcept;
+
+    // 由 DrawCommandBuffer 合并绘制用: 池中的网格, 材质号相同的可以在同一次多重绘制中提交
+    bool IsPooled() const noexcept { return pooled; }
+    bool CullsBackFaces() const noexcept { return cullBackFaces; }
+    std::uint32_t GetMaterialKey() const noexcept { return materialKey ? *materialKey : 0; }
+    // 第 lod 级的间接绘制命令, 一个实例, baseInstance 为0
+    DrawElementsIndirectCommand GetDrawCommand(unsigned int lod) const noexcept;
+    // 压缩顶点位置的反量化变换, 合并绘制时乘进每次绘制的模型矩阵
+    glm::mat4 GetDequantizeMatrix() const noexcept;
+    // 为一组合并绘制设置材质和VAO, 着色器需以 INSTANCED 编译
+    void BindMultiDraw(ShaderProgram& shader) noexcept;
+    // 把VAO的实例属性指向 batch 的第 first 个实例起, 与当前相同时跳过. VAO需已绑定
+    void AttachInstances(InstanceBatch const& batch, std::size_t first = 0) noexcept;
+
+    VertexFormat GetVertexFormat() const noexcept { return format; }
+    GLuint GetVertexArray() const noexcept { return VAO; }
+    std::size_t VertexCount() const noexcept { return vertices.size(); }
+    // 导入时的顶点和索引保留在CPU上, 例如用作 OcclusionCuller 的遮挡物
+    std::vector<Vertex> const &GetVertices() const noexcept { return vertices; }
+    std::vector<unsigned int> const &GetIndices() const noexcept { return indices; }
+    static std::size_t VertexStride(VertexFormat format) noexcept;
+    // 在当前绑定的VAO上设置 format 的顶点属性, 数据来自当前的 GL_ARRAY_BUFFER
+    static void SetupVertexAttributes(VertexFormat format) noexcept;
+    // 上传到GPU的顶点缓冲大小
+    std::size_t VertexBufferBytes() const noexcept;
+    // 归还GPU上的几何: 池中的区间还给 GeometryPool, 否则删除自己的VAO和缓冲. 之后不能再绘制.
+    // Mesh 可以被复制 (vector 扩容), 所以不在析构函数里做, 由拥有者 (Model) 调用一次
+    void ReleaseGeometry() noexcept;
+
+    std::size_t LodCount() const noexcept { return lods.size(); }
+    bool HasMeshlets() const noexcept { return !meshlets.empty(); }
+    MeshLod const &GetLod(std::size_t lod) const noexcept { return lods[lod]; }
+    // 物体空间包围球, 用于LOD选择
+    glm::vec3 GetBoundsCenter() const noexcept { return boundsMin + boundsExtent * 0.5f; }
+    float GetBoundsRadius() const noexcept { return glm::length(boundsExtent) * 0.5f; }
+    // 物体空间AABB, 导入时由顶点算出, 用于视锥剔除
+    glm::vec3 GetBoundsMin() const noexcept { return boundsMin; }
+    glm::vec3 GetBoundsMax() const noexcept { return boundsMin + boundsExtent; }
+
+    // 第i个材质纹理为二维纹理时绑定到单元i, 为纹理数组时绑定到 ARRAY_UNIT_BASE + i.
+    // 两种采样器总是指向不同的单元, 同一单元上不会出现类型不同的采样器
+    static constexpr unsigned int ARRAY_UNIT_BASE = 8;
+
+    // 向 TextureManager 请求材质纹理的mip: pixelsPerUnit 为屏幕上每个物体空间单位的像素数, <= 0 时请求最清晰的一级
+    void RequestTextureMips(float pixelsPerUnit) const noexcept;
     
 private:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    std::vector<MeshLod> lods; // 至少一级, indices 中的区间
+    std::vector<Meshlet> meshlets;
+    // DrawClusters 每帧复用的可见区间
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void *> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+    VertexFormat format;
+    glm::vec3 boundsMin, boundsExtent; // 位置反量化用的AABB
+    float uvDensity; // 每物体空间单位的UV变化量, 由LOD0的UV面积与表面积之比估计
     unsigned int VAO, VBO, EBO;
+    bool pooled = false;
+    bool cullBackFaces = false; // 开放或双面的网格背面可见, 不能按法线锥丢掉簇
+    GLint baseVertex = 0;        // 在池中时顶点和索引的起点, 否则为0
+    unsigned int firstIndex = 0;
+    std::shared_ptr<const std::uint32_t> materialKey; // 复制的网格共享同一个号码
+    std::uint64_t instanceSerial = 0; // VAO的实例属性当前指向的 InstanceBatch 和起点
+    std::size_t instanceFirst = 0;
+    // bindMaterial 用到的uniform, 换用另一个程序时重新解析; 与 textures 一一对应
+    struct MaterialUniforms
+    {
+        unsigned int program = 0;
+        std::vector<UniformHandle> samplers, arraySamplers, layers;
+        UniformHandle packedVertex, boundsMin, boundsExtent;
+    };
+    MaterialUniforms uniforms;
     void setupMesh() noexcept;
+    const void *indexPointer(unsigned int offset) const noexcept { return (const void *)((firstIndex + offset) * sizeof(unsigned int)); }
+    void bindMaterial(ShaderProgram& shader) noexcept;
+    void resolveUniforms(ShaderProgram& shader);
+    std::vector<unsigned char> packVertices() const;
 };
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <vector>
+#include <string>
+
+// 二进制网格缓存: 以源文件路径、修改时间和导入标志为键, 保存最终的顶点/索引数组和材质纹理表.
+// 命中时直接内存映射读取, 跳过Assimp的文本解析.
+namespace MeshCache
+{
+    // 文件布局或导入流程的输出改变时加一
+    constexpr unsigned int VERSION = 5;
+
+    std::string CachePath(std::string const &sourcePath);
+
+    // 没有缓存文件、键过期、版本或顶点布局不符以及数据损坏时返回false
+    bool Load(std::string const &sourcePath, unsigned int importFlags,
+              std::vector<MeshData> &meshes, std::vector<MaterialData> &materials);
+
+    bool Save(std::string const &sourcePath, unsigned int importFlags,
+              std::vector<MeshData> const &meshes, std::vector<MaterialData> const &materials);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <cstddef>
+#include <vector>
+
+// 导入时的网格优化: 顶点去重 -> 顶点缓存重排(Tipsify) -> 减少overdraw的簇排序 -> 顶点读取顺序重映射
+namespace MeshOptimizer
+{
+    // 模拟的GPU post-transform缓存大小(FIFO)
+    constexpr unsigned int CACHE_SIZE = 16;
+
+    struct CacheStats
+    {
+        float acmr; // average cache miss ratio: transformed vertices per triangle (0.5 .. 3)
+        float atvr; // average transform to vertex ratio: transformed vertices per unique vertex (1 is optimal)
+        std::size_t misses;
+        std::size_t triangles;
+        std::size_t vertices;
+    };
+
+    CacheStats AnalyzeVertexCache(std::vector<unsigned int> const &indices, std::size_t vertexCount,
+                                  unsigned int cacheSize = CACHE_SIZE);
+
+    // 合并逐字节相同的顶点
+    void DeduplicateVertices(MeshData &mesh);
+
+    // Tipsify (Sander et al. 2007). clusters 返回每个"硬"簇的起始三角形, 可供 OptimizeOverdraw 使用
+    void OptimizeVertexCache(std::vector<unsigned int> &indices, std::size_t vertexCount,
+                             std::vector<unsigned int> *clusters = nullptr, unsigned int cacheSize = CACHE_SIZE);
+
+    // 在不让ACMR变差超过 threshold 倍的前提下细分簇, 再按遮挡潜力由外向内排序
+    void OptimizeOverdraw(std::vector<unsigned int> &indices, std::vector<Vertex> const &vertices,
+                          std::vector<unsigned int> const &clusters, float threshold = 1.05f,
+                          unsigned int cacheSize = CACHE_SIZE);
+
+    // 按首次使用的顺序重排顶点, 提高顶点读取的局部性
+    void OptimizeVertexFetch(MeshData &mesh);
+
+    // 依次执行以上全部步骤
+    void Optimize(MeshData &mesh);
+
+    // 二次误差度量(QEM)的边折叠简化, 只改索引不改顶点. 边界和纹理接缝上的顶点保持不动.
+    // resultError 返回物体空间中的近似几何误差
+    std::vector<unsigned int> Simplify(std::vector<unsigned int> const &indices, std::vector<Vertex> const &vertices,
+                                       std::size_t targetIndexCount, float *resultError = nullptr);
+
+    // 各级LOD的目标三角形比例
+    constexpr float LOD_RATIOS[] = {0.5f, 0.25f, 0.125f};
+
+    // 从 mesh.indices (LOD0) 生成LOD链, 追加到 mesh.indices 后并填写 mesh.lods
+    void GenerateLods(MeshData &mesh);
+
+    // 网格簇大小上限 (与常见的 mesh shader 配置一致)
+    constexpr unsigned int MESHLET_MAX_VERTICES = 64;
+    constexpr unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+    // 从相邻三角形贪心生长, 把LOD0切成法线相近的网格簇, 并按簇重写LOD0的索引 (每个簇连续).
+    // 簇内再做一遍顶点缓存优化, 簇之间按 OptimizeOverdraw 的遮挡潜力排序. 其余LOD不变.
+    // 计算每个簇的包围球和法线锥, 填写 mesh.meshlets
+    void BuildMeshlets(MeshData &mesh);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+enum class MipFilter
+{
+    Box,    // 2x2平均, 最快
+    Kaiser, // 宽度3、alpha 4 的 Kaiser 窗 sinc, 远处更清晰, 闪烁更少
+};
+
+struct MipOptions
+{
+    MipFilter filter = MipFilter::Kaiser;
+    bool srgb = false;      // 颜色通道按sRGB编码: 转到线性空间滤波后再编码回sRGB, alpha 始终线性
+    bool normalMap = false; // xyz 为 [0,1] 编码的法线, 每级重新归一化
+};
+
+// 一级mip, 像素紧密排列, 通道数与输入相同
+struct MipLevel
+{
+    int width = 0, height = 0;
+    std::vector<unsigned char> data;
+};
+
+// CPU端的mip链生成, 代替加载时的 glGenerateMipmap. 内部用 float RGBA (SSE2) 计算,
+// 每级从上一级的浮点结果滤波, 大图的行在 ThreadPool::Global() 上并行
+namespace MipGenerator
+{
+    // 包括第0级在内的级数, 到1x1为止
+    int LevelCount(int width, int height) noexcept;
+
+    // 返回第1级到最后一级 (不含第0级), channels 为 1..4
+    std::vector<MipLevel> Generate(const unsigned char *pixels, int width, int height, int channels,
+                                   MipOptions const &options = MipOptions());
+}
@@ -3,6 +3,11 @@
 #include <glad/glad.h>
 #include <Shader.h>
 #include <Mesh.h>
+#include <Camera.h>
+#include <DrawCommandBuffer.h>
+#include <FrustumCuller.h>
+#include <OcclusionCuller.h>
+#include <RenderQueue.h>
 #include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -15,25 +20,179 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+
+// 模型导入选项
+struct ModelLoadOptions
+{
+    // convert meshes on the thread pool; the result is identical to the serial path
+    bool parallelImport = true;
+    // 对 .obj 文件使用内置解析器, 其他格式(或解析失败)仍然走Assimp
+    bool objFastPath = true;
+    // 导入时做顶点去重/顶点缓存/overdraw/顶点读取优化, 结果写入网格缓存
+    bool optimizeMeshes = true;
+    // 使用压缩顶点格式 (静态网格 PackedVertex, 带骨骼的网格 PackedSkinnedVertex)
+    bool packVertices = true;
+    // 导入时用边折叠简化生成LOD链 (MeshOptimizer::LOD_RATIOS), 与LOD0共享顶点缓冲
+    bool generateLods = true;
+    // 把LOD0切成网格簇 (MeshOptimizer::BuildMeshlets), 绘制时逐簇剔除
+    bool buildMeshlets = true;
+    // 模型的网格都是闭合的, 背面看不见: 绘制时打开 GL_CULL_FACE, 网格簇另做法线锥背面剔除.
+    // 开放或双面的网格背面可见, 丢掉背面簇会少画东西, 所以默认关闭
+    bool closedMeshes = false;
+    // 纹理压缩为BC1/BC3(颜色)和BC5(法线), 首次载入时编码并缓存到 <image>.texcache
+    bool compressTextures = true;
+    // 尺寸和格式相同的漫反射贴图打包成 GL_TEXTURE_2D_ARRAY, 网格记录层号; 不同网格之间不再需要切换纹理.
+    // 只有漫反射贴图在着色器里有数组版本 (texture_diffuseN_array / texture_diffuseN_layer), 其他贴图仍是二维纹理
+    bool textureArrays = true;
+    // 顶点和索引放进共享的 GeometryPool: 网格之间不切换VAO, 可以用 DrawCommandBuffer 合并绘制.
+    // 模型销毁时区间还给池, 重新载入时复用
+    bool geometryPool = true;
+};
+
+struct DecodedImage;
 
 class Model
 {
 public:
     /*  函数   */
-    Model(std::string const &path)
+    Model(std::string const &path, ModelLoadOptions const &options = ModelLoadOptions())
+        : options(options)
     {
         loadModel(path);
     }
+    // 析构时归还网格的GPU几何, 需在GL线程上
+    ~Model();
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    // 异步加载: 立即返回句柄, 几何解析和纹理解码在工作线程上进行
+    static std::shared_ptr<Model> LoadAsync(std::string const &path, ModelLoadOptions const &options = ModelLoadOptions());
+    // 在GL线程上每帧调用, 在时间预算内上传已就绪的网格; 全部驻留后返回true
+    bool Update(double budgetMs = 2.0);
+    bool IsLoaded() const noexcept { return !pending; }
+    // 只绘制已经驻留的网格
     void Draw(ShaderProgram &shader);
+    // 先用网格的AABB做视锥剔除, 再按投影到屏幕上的误差为每个网格选择LOD: 选误差不超过 lodErrorPixels 像素的最粗一级.
+    // 选中LOD0且网格有网格簇时, 逐簇做视锥/背面剔除
+    void Draw(ShaderProgram &shader, Camera const &camera, glm::mat4 const &projection, glm::mat4 const &model,
+              float viewportHeight);
+    // 与上面相同的剔除和LOD选择, 但不绘制: 视锥内的网格作为不透明绘制加入 queue, 深度为到包围球的距离.
+    // 需要先调用 queue.SetCamera
+    void Enqueue(RenderQueue &queue, ShaderProgram &shader, Camera const &camera, glm::mat4 const &projection, glm::mat4 const &model,
+                 float viewportHeight);
+    // 与上面相同的LOD选择, 但不绘制: 视锥内的网格加入 commands, 由 DrawCommandBuffer::Submit 合并提交.
+    // 不做网格簇剔除; material 为每次绘制的材质号 (InstanceData::material)
+    void AddDrawCommands(DrawCommandBuffer &commands, Camera const &camera, glm::mat4 const &projection, glm::mat4 const &model,
+                         float viewportHeight, std::uint32_t material = 0);
+    // 每个网格用一次实例化绘制画出 batch 的所有实例, 使用第 lod 级; 着色器需以 INSTANCED 编译
+    void DrawInstanced(ShaderProgram &shader, InstanceBatch const &batch, unsigned int lod = 0);
+    // 逐实例选择LOD: instances 与 batch 中的数据相同且顺序一致. 每个网格把选中同一级的相邻实例合成一次绘制,
+    // 所以实例按到相机的距离从近到远排好时, 每个网格只画 LOD 级数那么多次
+    void DrawInstanced(ShaderProgram &shader, InstanceBatch const &batch, std::vector<InstanceData> const &instances,
+                       Camera const &camera, float viewportHeight);
+    void SetLodErrorThreshold(float pixels) noexcept { lodErrorPixels = pixels; }
+    void SetLodEnabled(bool enabled) noexcept { lodEnabled = enabled; }
+    void SetClusterCulling(bool enabled) noexcept { clusterCulling = enabled; }
+    // 关掉时 Draw/Enqueue/AddDrawCommands 提交所有网格
+    void SetFrustumCulling(bool enabled) noexcept { frustumCulling = enabled; }
+    // 设置后 Draw/Enqueue/AddDrawCommands 还跳过被遮挡的网格; occlusion 必须已为本帧光栅化. nullptr 关闭
+    void SetOcclusionCuller(OcclusionCuller *occlusion) noexcept { occlusionCuller = occlusion; }
+    // 把每个已驻留网格的第 lod 级 (超出时为最粗的一级) 作为遮挡物加入 occlusion. 简化后的网格可能比原网格大,
+    // 挡住本该看得见的物体, 所以默认用LOD0
+    void AddOccluders(OcclusionCuller &occlusion, glm::mat4 const &model, unsigned int lod = 0) const;
+    // 按距离为每个网格选遮挡物的LOD: 误差投影到遮挡缓冲上不超过1个像素的最粗一级
+    void AddOccluders(OcclusionCuller &occlusion, glm::mat4 const &model, Camera const &camera) const;
+    // 已驻留网格的物体空间AABB的并集; 还没有网格时为0
+    glm::vec3 GetBoundsMin() const noexcept { return boundsMin; }
+    glm::vec3 GetBoundsMax() const noexcept { return boundsMax; }
+    std::size_t MeshCount() const noexcept { return meshes.size(); }
+
+    // Assimp后处理标志, 同时也是网格缓存键的一部分
+    static constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+    // 缓存键中标记OBJ快速路径的位(不是Assimp标志), 两条路径的顶点输出不同
+    static constexpr unsigned int OBJ_FAST_PATH_KEY = 0x80000000u;
+    // 缓存键中标记网格已经过 MeshOptimizer 处理的位
+    static constexpr unsigned int OPTIMIZED_KEY = 0x40000000u;
+    // 缓存键中标记已生成LOD链的位
+    static constexpr unsigned int LOD_KEY = 0x20000000u;
+    // 缓存键中标记已生成网格簇的位
+    static constexpr unsigned int MESHLET_KEY = 0x10000000u;
 
 private:
+    struct PendingLoad;
+    struct AsyncTag
+    {
+    };
+    Model(AsyncTag, ModelLoadOptions const &options)
+        : options(options)
+    {
+    }
+
     /*  模型数据  */
+    ModelLoadOptions options;
     std::vector<Mesh> meshes;
     std::string directory;
-    std::vector<Texture> textures_loaded; // 储存所有已载入的textures
+    std::shared_ptr<PendingLoad> pending; // 异步加载中尚未上传的数据
+    // textureArrays 打开时, 材质中的相对路径 -> 所在的纹理数组和层
+    struct ArrayLayer
+    {
+        TextureHandle array;
+        int layer;
+    };
+    std::unordered_map<std::string, ArrayLayer> arrayLayers;
+    // 与 meshes 一一对应的物体空间AABB, 绘制时先整体剔除
+    FrustumCuller meshBounds;
+    std::vector<std::uint32_t> visibleMeshes;
+    glm::vec3 boundsMin{0.0f}, boundsMax{0.0f};
+    float lodErrorPixels = 1.0f;
+    bool lodEnabled = true;
+    bool clusterCulling = true;
+    bool frustumCulling = true;
+    OcclusionCuller *occlusionCuller = nullptr;
     /*  函数   */
+    // 把 frustum 内且没有被遮挡的网格下标写入 visibleMeshes; frustum 在物体空间中
+    void cullMeshes(Frustum const &frustum, glm::mat4 const &model);
+    // 网格投影到屏幕上的大小, 所有按距离选择LOD和纹理mip的地方共用
+    struct MeshExtent
+    {
+        float distance;      // 到包围球表面的距离, 相机在球内时为负
+        float pixelsPerUnit; // 每个物体空间单位在屏幕上的像素数, 相机在包围球内时为0 (用最细的一级)
+    };
+    // 在高 viewportHeight 像素的缓冲上, 距离1处一个单位投影成的像素数
+    static float projectionScale(Camera const &camera, float viewportHeight) noexcept;
+    static MeshExtent measureMesh(Mesh const &mesh, glm::mat4 const &model, glm::vec3 const &eye, float projScale) noexcept;
+    // 屏幕上每个物体空间单位 pixelsPerUnit 像素时误差不超过 lodErrorPixels 的最粗一级; <= 0 时为LOD0
+    unsigned int selectLod(Mesh const &mesh, float pixelsPerUnit) const noexcept;
+    // 误差不超过 maxErrorPixels 像素的最粗一级, 不看 lodEnabled
+    static unsigned int coarsestLod(Mesh const &mesh, float pixelsPerUnit, float maxErrorPixels) noexcept;
+    std::vector<unsigned int> instanceLods; // DrawInstanced 每帧复用
     void loadModel(std::string const &path);
-    void processNode(aiNode *node, const aiScene *scene);
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
+    // 缓存 / OBJ快速路径 / Assimp, 只做CPU工作, 可以在工作线程上调用
+    static bool importGeometry(std::string const &path, ModelLoadOptions const &options,
+                               std::vector<MeshData> &meshData, std::vector<MaterialData> &materials, const char *&source);
+    static bool importScene(std::string const &path, ModelLoadOptions const &options,
+                            std::vector<MeshData> &meshData, std::vector<MaterialData> &materials);
+    static bool useObjFastPath(std::string const &path, ModelLoadOptions const &options);
+    static void optimizeMeshes(std::string const &path, ModelLoadOptions const &options, std::vector<MeshData> &meshData);
+    static void generateLods(std::string const &path, ModelLoadOptions const &options, std::vector<MeshData> &meshData);
+    static void buildMeshlets(std::string const &path, ModelLoadOptions const &options, std::vector<MeshData> &meshData);
+    static std::vector<Texture> collectTextureFiles(std::vector<MaterialData> const &materials);
+    static TextureCompression textureCompression(Texture const &texture, ModelLoadOptions const &options);
+    // 着色器中有 sampler2DArray 版本的贴图类型 (texture_diffuse), 只有这些打包进纹理数组
+    static bool packsIntoArray(Texture const &texture);
+    // texture_diffuse 为颜色, texture_normal 为法线, 其余 (高光、高度) 为线性数据
+    static TextureUsage textureUsage(Texture const &texture);
+    static void processNode(aiNode *node, const aiScene *scene, std::vector<aiMesh *> &work);
+    static MeshData processMesh(aiMesh *mesh);
+    static MaterialData processMaterial(aiMaterial *mat);
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, std::vector<Texture> &textures);
+    void addMesh(MeshData &data, std::vector<Texture> textures);
+    // GL线程: 把模型的所有纹理按 TextureManager::CanShareArray 分组, 每组上传为一个纹理数组
+    void buildTextureArrays(std::vector<Texture> const &files,
+                            std::unordered_map<std::string, std::shared_ptr<DecodedImage>> const &images);
+    void reportVertexMemory(std::string const &path) const;
+    // images: 已在工作线程上解码好的图像, 与 material.textures 一一对应
+    std::vector<Texture> loadMaterialTextures(MaterialData const &material,
+                                              std::vector<std::shared_ptr<DecodedImage>> const *images = nullptr);
 };
\ No newline at end of file
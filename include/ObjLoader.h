@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <vector>
+#include <string>
+
+// Wavefront OBJ/MTL 快速导入路径.
+// 文件被内存映射后按行切块并行解析, 结果直接写成 Mesh.h 中的 Vertex 布局.
+// 与 aiProcess_Triangulate | aiProcess_FlipUVs 的输出等价: 多边形按扇形三角化, v 坐标翻转.
+// 每个 o/g/usemtl 切换产生一个新网格, 相同的 v/vt/vn 组合在网格内共享一个顶点.
+namespace ObjLoader
+{
+    bool Load(std::string const &path, std::vector<MeshData> &meshes, std::vector<MaterialData> &materials,
+              bool parallel = true);
+}
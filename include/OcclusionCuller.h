@@ -0,0 +1,83 @@
+#pragma once
+
+#include <FrustumCuller.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU上的遮挡剔除. 选定的遮挡物 (例如简化过的网格) 光栅化到低分辨率的深度缓冲, 每 TILE_SIZE x TILE_SIZE 像素
+// 另记一个最远深度, 组成两级的层次深度. 物体包围盒投影到屏幕上的矩形, 若处处都在遮挡物后面则被遮挡.
+// 光栅化用 SSE2 一次处理4个像素; 三角形准备按遮挡物分组, 光栅化按行分带, 都在 ThreadPool::Global() 上并行.
+// 判断是保守的: 只有整个被某一个三角形盖住的像素才写入深度 (取像素内最远的一点), 所以遮挡物之间的缝, 哪怕窄于
+// 一个像素, 也不会被当作挡住, 代价是遮挡物的边缘和相邻三角形的公共边上少挡一圈像素. 不调用GL
+class OcclusionCuller
+{
+public:
+    static constexpr int TILE_SIZE = 8;
+
+    struct Stats
+    {
+        std::size_t occluderTriangles = 0; // 经过近平面裁剪和背面剔除后光栅化的三角形
+        std::size_t tested = 0;
+        std::size_t occluded = 0;
+        double rasterMs = 0.0; // 三角形准备、光栅化和建立层次深度
+        double testMs = 0.0;
+    };
+
+    // 宽高向上取整到 TILE_SIZE 的倍数, 宽高比应与投影相同
+    explicit OcclusionCuller(int width = 256, int height = 192);
+
+    // 清空深度、遮挡物和统计; viewProjection 为本帧的 projection * view
+    void Begin(glm::mat4 const &viewProjection);
+    // 加入遮挡物: positions 相隔 stride 字节, indices 每3个一个三角形, 经 model 变换到世界空间.
+    // 数据在 Rasterize 之前必须有效. closed: 网格是闭合的, 只画正面 (逆时针)
+    void AddOccluder(glm::vec3 const *positions, std::size_t stride, unsigned int const *indices, std::size_t indexCount,
+                     glm::mat4 const &model, bool closed = false);
+    void Rasterize(bool parallel = true);
+
+    // 物体空间AABB经 model 变换后是否完全被遮挡. 跨过近平面或在屏幕外时返回 false
+    bool IsOccluded(glm::vec3 const &min, glm::vec3 const &max, glm::mat4 const &model = glm::mat4(1.0f));
+    // 从 indices 中去掉被遮挡的包围盒 (bounds 中的下标, 世界空间), 其余保持顺序
+    void Filter(FrustumCuller const &bounds, std::vector<std::uint32_t> &indices, bool parallel = true);
+
+    Stats const &GetStats() const noexcept { return stats; }
+    int GetWidth() const noexcept { return width; }
+    int GetHeight() const noexcept { return height; }
+    // 光栅化后的深度, [0,1], 从下往上逐行, 没有遮挡物处为1
+    std::vector<float> const &GetDepth() const noexcept { return depth; }
+
+private:
+    struct Occluder
+    {
+        glm::vec3 const *positions;
+        std::size_t stride;
+        unsigned int const *indices;
+        std::size_t indexCount;
+        glm::mat4 transform; // viewProjection * model
+        bool closed;
+    };
+    // 屏幕空间三角形: 三条边函数 a*x + b*y + c 在内部非负, 深度 z = zx*x + zy*y + z0; 像素范围已裁到屏幕
+    struct Triangle
+    {
+        float a[3], b[3], c[3];
+        float zx, zy, z0;
+        int minX, maxX, minY, maxY;
+    };
+
+    void setupOccluder(Occluder const &occluder, std::vector<Triangle> &out) const;
+    void setupTriangle(glm::vec4 const *clip, bool closed, std::vector<Triangle> &out) const;
+    void rasterizeRows(int tileRowBegin, int tileRowEnd);
+    // transform 把包围盒变换到裁剪空间
+    bool testBox(glm::vec3 const &min, glm::vec3 const &max, glm::mat4 const &transform) const noexcept;
+
+    int width, height, tilesX, tilesY;
+    glm::mat4 viewProjection{1.0f};
+    std::vector<Occluder> occluders;
+    std::vector<std::vector<Triangle>> triangles; // 每个准备任务一组, 每帧复用
+    std::vector<float> depth;
+    std::vector<float> tileDepth; // 每块的最远深度
+    std::vector<std::vector<std::uint32_t>> chunks;
+    Stats stats;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// 像素解包缓冲(PBO)环: 纹理数据先拷进暂存缓冲, 再由 glTexImage2D 从缓冲异步传输, GL线程不再等待驱动拷贝.
+// 有 GL_ARB_buffer_storage 时各缓冲持久映射, 否则每次用 glMapBufferRange 映射. 每个缓冲用fence保护,
+// 绕回时若GPU还没读完就在 glClientWaitSync 上等待, 等待时间计入统计.
+// 只能在GL线程上使用; 缓冲随上下文一起销毁
+class PixelUploadRing
+{
+public:
+    static constexpr unsigned int SLOT_COUNT = 4;
+    static constexpr std::size_t SLOT_SIZE = 16u << 20; // 够放一张 2048x2048 RGBA
+
+    struct Stats
+    {
+        std::size_t uploads = 0;
+        std::size_t bytes = 0;
+        std::size_t fallbacks = 0; // 超过 SLOT_SIZE, 直接从客户端内存上传
+        double stallMs = 0.0;      // 在fence上等待的总时间
+        double maxStallMs = 0.0;
+    };
+
+    PixelUploadRing();
+
+    // 上传到当前绑定的 GL_TEXTURE_2D 的第 level 级
+    void TexImage2D(GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type,
+                    const void *pixels, std::size_t bytes);
+    void CompressedTexImage2D(GLint level, GLenum internalFormat, GLsizei width, GLsizei height, const void *data,
+                              std::size_t bytes);
+    // 上传到当前绑定的 GL_TEXTURE_2D_ARRAY 的第 level 级, data 为 layers 层依次排列
+    void TexImage3D(GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei layers, GLenum format,
+                    GLenum type, const void *pixels, std::size_t bytes);
+    void CompressedTexImage3D(GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers,
+                              const void *data, std::size_t bytes);
+
+    bool IsPersistent() const noexcept { return persistent; }
+    Stats const &GetStats() const noexcept { return stats; }
+
+private:
+    struct Slot
+    {
+        GLuint buffer = 0;
+        void *mapped = nullptr; // 持久映射时有效
+        GLsync fence = nullptr;
+    };
+
+    // 把数据拷进下一个缓冲并绑定到 GL_PIXEL_UNPACK_BUFFER; 放不下或映射失败时返回false, 调用方直接从客户端内存上传
+    bool stage(const void *pixels, std::size_t bytes);
+    // 传输命令发出后插入fence, 解绑
+    void finish(std::size_t bytes);
+
+    Slot slots[SLOT_COUNT];
+    unsigned int next = 0;
+    bool persistent = false;
+    Stats stats;
+};
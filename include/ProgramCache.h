@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 链接好的着色器程序的磁盘缓存 (glGetProgramBinary): 以两段源码、宏定义和驱动的
+// GL_VENDOR/GL_RENDERER/GL_VERSION 的哈希为键. 命中时 glProgramBinary 直接得到链接好的程序, 跳过编译和链接.
+// 驱动更新或拒绝二进制时视为未命中, 调用方重新编译并覆盖缓存
+namespace ProgramCache
+{
+    // 文件布局改变时加一
+    constexpr unsigned int VERSION = 1;
+
+    // 驱动支持 GL_ARB_get_program_binary 且至少提供一种二进制格式
+    bool Supported();
+
+    std::uint64_t Key(std::string_view vertexSource, std::string_view fragmentSource, std::string_view defines);
+
+    // 顶点着色器旁的 <vertex>.<片段着色器路径与宏定义的哈希>.progcache, 同一对源文件的不同宏定义各有一个文件
+    std::string CachePath(std::string const &vertexPath, std::string const &fragmentPath, std::string_view defines);
+
+    // 在尚未链接的 program 上调用 glProgramBinary; 未命中、键不匹配或驱动拒绝时返回false
+    bool Load(GLuint program, std::string const &cachePath, std::uint64_t key);
+
+    // program 必须已成功链接, 链接前应设置 GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    bool Save(GLuint program, std::string const &cachePath, std::uint64_t key);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace RadixSort
+{
+    // 按 [lowBit, highBit) 位升序的稳定LSD基数排序, 每趟11位. 一次遍历统计所有趟的直方图, 所有键在某一段上都相同时跳过那一趟.
+    // 低于 lowBit 的位不参与比较, 通常放载荷的下标: 键按下标顺序加入时, 排序后相同的键仍保持加入的顺序.
+    // highBit 及以上的位必须全为0, 少一段就少一趟. scratch 为工作区, 大小按需调整, 跨帧复用以免分配
+    void Sort(std::vector<std::uint64_t> &keys, std::vector<std::uint64_t> &scratch, int lowBit = 0, int highBit = 64);
+}
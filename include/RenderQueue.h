@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <RadixSort.h>
+#include <Shader.h>
+#include <SortKey.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Mesh;
+
+// 一帧的网格绘制队列. 每个绘制打包一个64位排序键 (见 SortKey.h), Submit 前用基数排序. 只能在GL线程上使用
+class RenderQueue
+{
+public:
+    using Layer = SortKey::Layer;
+
+    static constexpr int INDEX_BITS = SortKey::INDEX_BITS;
+    static constexpr std::size_t MAX_ITEMS = SortKey::MAX_ITEMS;
+
+    // 网格簇剔除需要的相机, 每帧在 Push 之前设置
+    void SetCamera(glm::mat4 const &viewProjection, glm::vec3 const &eye) noexcept;
+    // shader 上每帧不变的uniform (view, projection) 由调用者在 Submit 之前设置, 队列只设置 model.
+    // clusters: 画LOD0并逐簇剔除 (Mesh::DrawClusters). 超过 MAX_ITEMS 的绘制被丢弃
+    void Push(Layer layer, ShaderProgram &shader, Mesh &mesh, unsigned int lod, glm::mat4 const &model, float depth,
+              bool clusters = false);
+    // 排序并按顺序绘制, 然后清空
+    void Submit();
+    std::size_t Size() const noexcept { return items.size(); }
+    // 上一次 Submit 中排序花的时间
+    double GetSortMs() const noexcept { return sortMs; }
+
+private:
+    struct Item
+    {
+        ShaderProgram *shader;
+        Mesh *mesh;
+        glm::mat4 model;
+        unsigned int lod;
+        bool clusters;
+    };
+
+    std::vector<Item> items;
+    std::vector<std::uint64_t> keys, scratch;
+    glm::mat4 viewProjection{1.0f};
+    glm::vec3 eye{0.0f};
+    double sortMs = 0.0;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// 每帧的绘制统计, 由 Mesh::Draw 累加, 渲染循环在帧首调用 Reset
+struct RenderStats
+{
+    std::size_t drawCalls = 0;
+    std::size_t triangles = 0;
+    // 网格簇剔除: 参与测试的簇数, 被视锥/法线锥剔除的簇数
+    std::size_t clustersTested = 0;
+    std::size_t clustersFrustumCulled = 0;
+    std::size_t clustersBackfaceCulled = 0;
+    // 实际发出的 glBindTexture 次数, 由 TextureManager::Bind 累加 (跳过的重复绑定不计)
+    std::size_t textureBinds = 0;
+    // ShaderProgram::set_uniform 次数, 其中按名字查表的次数 (按 UniformHandle 设置的不查表)
+    std::size_t uniformSets = 0;
+    std::size_t uniformLookups = 0;
+    // 经过 GLState 的状态设置: 实际发给驱动的GL调用, 与缓存相同而跳过的调用
+    std::size_t stateCalls = 0;
+    std::size_t stateCallsFiltered = 0;
+    // FrustumCuller::Cull: 测试的包围盒数, 其中可见的个数, 花的时间
+    std::size_t boundsTested = 0;
+    std::size_t boundsVisible = 0;
+    double cullMs = 0.0;
+
+    void Reset() noexcept
+    {
+        *this = RenderStats();
+    }
+};
+
+inline RenderStats renderStats;
@@ -1,11 +1,31 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
+
+// 注入到 #version 之后的宏定义, 名字 -> 值. 按名字排序, 同一组宏总是得到同样的源码和缓存键
+using ShaderDefines = std::map<std::string, std::string>;
+
 class Shader
 {
 public:
+    // 构造时直接给出源码而不是文件路径
+    struct from_source_t
+    {
+        explicit from_source_t() = default;
+    };
+    static constexpr from_source_t from_source{};
+
     explicit Shader(std::string_view file_path);
+    Shader(from_source_t, std::string source);
 
     //禁用拷贝构造函数
     Shader(const Shader&) = delete;
@@ -18,32 +38,107 @@ public:
 
     constexpr unsigned get_id() const noexcept { return id_; }
 
+    // 读取整个文件, 失败时打印错误并返回空串
+    static std::string read_source(std::string_view file_path);
+    // 在 #version 行之后插入 defines, 再用 #line 让编译错误的行号仍对应原文件
+    static std::string inject_defines(std::string source, ShaderDefines const &defines);
+    // defines 的规范文本 "NAME=VALUE;...", 用作程序缓存和 ShaderPermutations 的键
+    static std::string defines_key(ShaderDefines const &defines);
+
+    // 查询编译结果, 失败时打印日志. 驱动在后台编译时会等到编译完成
+    bool compiled() const;
+
 protected:
+    // 创建 type 类型的着色器对象并提交编译, 不等待结果; stage 用于错误消息
+    void compile(GLenum type, const char *stage);
+
     unsigned id_;
     std::string source_;
+    const char *stage_ = "";
 };
 
+// 从文件构造时立即检查编译结果; 从源码构造时只提交编译, 由调用者在需要时调用 compiled()
 class VertexShader : public Shader
 {
 public:
     explicit VertexShader(std::string_view file_path);
+    VertexShader(from_source_t, std::string source);
 };
 
 class FragmentShader : public Shader
 {
 public:
     explicit FragmentShader(std::string_view file_path);
+    FragmentShader(from_source_t, std::string source);
+};
+
+// 程序中一个uniform的位置. 热路径上用 ShaderProgram::get_uniform 解析一次并保存,
+// 之后按句柄设置, 不再做字符串查找. 程序中不存在(或被优化掉)的uniform得到无效句柄, 设置时被忽略
+class UniformHandle
+{
+public:
+    constexpr UniformHandle() noexcept = default;
+    constexpr explicit UniformHandle(GLint location) noexcept : location_{location} {}
+
+    constexpr GLint get_location() const noexcept { return location_; }
+    constexpr bool valid() const noexcept { return location_ >= 0; }
+
+private:
+    GLint location_ = -1;
 };
 
 class ShaderProgram
 {
 public:
-    ShaderProgram(std::string_view vertex_shader, std::string_view fragment_shader);
+    // 进程内所有程序的创建统计
+    struct Stats
+    {
+        std::size_t compiled = 0;  // 从源码编译链接
+        std::size_t cacheHits = 0; // 从 ProgramCache 载入
+        std::size_t asyncBuilds = 0; // 其中以 Async 模式提交的
+        double compileMs = 0.0; // GL线程上花在提交和取回结果上的时间, 不含驱动后台编译的时间
+        double cacheMs = 0.0;
+    };
+
+    // Sync: 构造返回时程序已链接好.
+    // Async: 构造只提交编译和链接, 不查询状态; 驱动支持 GL_KHR_parallel_shader_compile 时在后台线程上编译,
+    // 可以先把所有程序都提交, 再去加载资源. is_ready() 之前 use() 绑定一个什么都不画的占位程序
+    enum class BuildMode
+    {
+        Sync,
+        Async,
+    };
+
+    // 驱动支持时先查 ProgramCache, 未命中再编译链接并写回缓存
+    ShaderProgram(std::string_view vertex_shader, std::string_view fragment_shader, BuildMode mode = BuildMode::Sync);
+    // 两个阶段的源码都注入 defines 后再编译, 不同的宏组合各有一份程序缓存
+    ShaderProgram(std::string_view vertex_shader, std::string_view fragment_shader, ShaderDefines const &defines,
+                  BuildMode mode = BuildMode::Sync);
 
     ~ShaderProgram();
 
     void use() const noexcept;
 
+    // 不阻塞地查询异步构建是否完成, 完成时检查链接结果、写程序缓存并反射uniform.
+    // 驱动不支持 GL_KHR_parallel_shader_compile 时无法不阻塞地查询, 第一次调用即等待完成
+    bool is_ready() const noexcept;
+    // 等待异步构建完成
+    void wait() const noexcept;
+
+    // 链接时反射出的活动uniform表中查找, 不调用GL. 位置在链接后才有, 所以异步构建的程序会先等待完成;
+    // 不想阻塞时在 is_ready() 之后再解析句柄
+    UniformHandle get_uniform(std::string_view name) const noexcept;
+    std::size_t uniform_count() const noexcept;
+
+    // 按句柄设置, 程序需为当前程序. 当前绑定的是占位程序时记下来, 链接后第一次 use() 时补设
+    void set_uniform(UniformHandle uniform, bool value) const noexcept;
+    void set_uniform(UniformHandle uniform, int value) const noexcept;
+    void set_uniform(UniformHandle uniform, float value) const noexcept;
+    void set_uniform(UniformHandle uniform, float v0, float v1, float v2, float v3) const noexcept;
+    void set_uniform(UniformHandle uniform, float v0, float v1, float v2) const noexcept;
+    void set_uniform(UniformHandle uniform, GLsizei count, GLboolean transpose, GLfloat* value) const noexcept;
+
+    // 按名字设置: 每次查一次哈希表, 适合不在每帧路径上的调用. 异步构建未完成时不等待, 同样记下来等 use() 补设
     void set_uniform(std::string_view name, bool value) const noexcept;
     void set_uniform(std::string_view name, int value) const noexcept;
     void set_uniform(std::string_view name, float value) const noexcept;
@@ -52,6 +147,69 @@ public:
     void set_uniform(std::string_view name, GLsizei count, GLboolean transpose, GLfloat* value) const noexcept;
 
     constexpr unsigned get_id() const noexcept { return id_; }
+
+    static Stats const &get_stats() noexcept { return stats_; }
 private:
+    // 支持用 string_view 直接查找, 不构造临时 std::string
+    struct UniformNameHash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const noexcept { return std::hash<std::string_view>{}(name); }
+    };
+
+    // 已提交、还未取回结果的编译链接
+    struct PendingBuild
+    {
+        std::unique_ptr<VertexShader> vertex;
+        std::unique_ptr<FragmentShader> fragment;
+        bool useCache = false;
+        std::uint64_t key = 0;
+        std::string cachePath;
+        double submitMs = 0.0;
+    };
+
+    // 编译两段源码并提交链接到 id_, 不等待结果
+    void submit(std::string vertex_source, std::string fragment_source);
+    // 取回 pending_ 的结果, 返回是否链接成功
+    bool finish() const;
+    void reflect_uniforms() const;
+    // 记下未能设置的uniform, 按调用顺序追加; 同一个名字或位置之前的记录丢弃
+    void defer(UniformHandle uniform, std::function<void()> set) const;
+    void defer(std::string_view name, std::function<void()> set) const;
+
+    static Stats stats_;
+
     unsigned id_;
-};
\ No newline at end of file
+    // 链接完成前的一次 set_uniform. 按名字的调用 location 为 -1, 补设时才解析成位置
+    struct DeferredUniform
+    {
+        std::string name;
+        GLint location = -1;
+        std::function<void()> set;
+    };
+
+    // 异步构建的结果在第一次查询时才取回, 所以这几项对外仍是 const
+    mutable std::unique_ptr<PendingBuild> pending_;
+    mutable bool placeholder_bound_ = false;
+    mutable std::unordered_map<std::string, GLint, UniformNameHash, std::equal_to<>> uniforms_;
+    // 链接完成前的 set_uniform, 按调用顺序
+    mutable std::vector<DeferredUniform> deferred_;
+};
+
+// 同一对着色器文件按不同宏定义特化出的程序 (排列). 每组宏只构建一次, 之后按宏的规范文本 O(1) 取出.
+// 程序的地址在 ShaderPermutations 的生命周期内不变
+class ShaderPermutations
+{
+public:
+    ShaderPermutations(std::string vertex_shader, std::string fragment_shader,
+                       ShaderProgram::BuildMode mode = ShaderProgram::BuildMode::Sync);
+
+    ShaderProgram &get(ShaderDefines const &defines);
+    std::size_t size() const noexcept { return programs_.size(); }
+
+private:
+    std::string vertex_shader_;
+    std::string fragment_shader_;
+    ShaderProgram::BuildMode mode_;
+    std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> programs_;
+};
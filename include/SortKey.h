@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// RenderQueue 的64位排序键. 只有整数运算, 不依赖GL, sortbench 和测试直接使用.
+// 不透明的绘制按 程序 > 材质 > VAO 聚在一起, 组内由近到远; 透明的绘制由远到近.
+// 程序、材质和VAO只取低位, 不同的值偶尔落在同一段只影响合并效果, 不影响正确性
+namespace SortKey
+{
+    enum class Layer : std::uint64_t
+    {
+        Opaque = 0,
+        Transparent = 1,
+    };
+
+    // 键的布局, 从高位到低位, 最高的 64 - HIGH_BIT 位为0, 最低的 INDEX_BITS 位是绘制的下标, 不参与排序:
+    //   不透明: layer 1 | program 6 | material 10 | vertexArray 4 | depth 12 | index 20
+    //   透明:   layer 1 | 反转的 depth 12 | program 6 | material 10 | vertexArray 4 | index 20
+    // 排序只看中间的33位, 三趟11位的基数排序
+    constexpr int INDEX_BITS = 20;
+    constexpr int SORT_BITS = 33;
+    constexpr int HIGH_BIT = INDEX_BITS + SORT_BITS;
+    constexpr std::size_t MAX_ITEMS = std::size_t(1) << INDEX_BITS;
+
+    // 非负浮点数的位模式与数值同序, 取符号位之后的12位 (指数和4位尾数, 相对精度约6%); 负数 (相机在物体内) 视为0
+    inline std::uint64_t QuantizeDepth(float depth) noexcept
+    {
+        if (!(depth > 0.0f))
+            return 0;
+        std::uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 19;
+    }
+
+    inline std::uint64_t Make(Layer layer, std::uint32_t program, std::uint32_t material, std::uint32_t vertexArray, float depth) noexcept
+    {
+        std::uint64_t state = (static_cast<std::uint64_t>(program & 0x3F) << 14) | (static_cast<std::uint64_t>(material & 0x3FF) << 4) |
+                              (vertexArray & 0xF);
+        std::uint64_t quantized = QuantizeDepth(depth);
+        std::uint64_t key = static_cast<std::uint64_t>(layer) << (HIGH_BIT - 1);
+        if (layer == Layer::Opaque)
+            key |= (state << 32) | (quantized << INDEX_BITS);
+        else
+            key |= ((~quantized & 0xFFF) << 40) | (state << INDEX_BITS);
+        return key;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// 毫秒计时. 基准程序和运行时的统计 (例如 OcclusionCuller::Stats) 共用
+class Stopwatch
+{
+public:
+    Stopwatch() noexcept : start(std::chrono::steady_clock::now()) {}
+
+    // 从构造或上次 Restart 到现在
+    double ElapsedMs() const noexcept
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    void Restart() noexcept { start = std::chrono::steady_clock::now(); }
+
+    // 调用 run 共 repeats 次, 返回最快一次的毫秒数; 最快的一次受调度和冷缓存的干扰最小
+    template <typename Run>
+    static double BestOfMs(int repeats, Run &&run)
+    {
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++)
+        {
+            Stopwatch watch;
+            run();
+            best = std::min(best, watch.ElapsedMs());
+        }
+        return best;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <iostream>
+
+// src/*Test.cpp 共用的检查: 条件不成立时打印 ERROR::<名字>::<原因> 并记一次失败,
+// 全部检查完后 main 返回 Finish(), 有失败时为1, ctest 据此判定
+class TestCheck
+{
+public:
+    explicit TestCheck(char const *name) noexcept : name(name) {}
+
+    void operator()(bool condition, char const *what)
+    {
+        if (!condition)
+        {
+            std::cout << "ERROR::" << name << "::" << what << std::endl;
+            failures++;
+        }
+    }
+
+    int Failures() const noexcept { return failures; }
+
+    // 没有失败时打印 "<title>: all tests passed" 和可选的附加说明
+    template <typename... Notes>
+    int Finish(char const *title, Notes const &...notes) const
+    {
+        if (failures)
+            return 1;
+        std::cout << title << ": all tests passed";
+        ((std::cout << notes), ...);
+        std::cout << std::endl;
+        return 0;
+    }
+
+private:
+    char const *name;
+    int failures = 0;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <TextureCompressor.h>
+
+#include <string>
+
+// 块压缩纹理的磁盘缓存: 源图像旁的 <image>.texcache, 以源文件修改时间/大小、压缩格式和颜色空间为键,
+// 保存完整的mip链. 命中时直接内存映射读取, 不再解码PNG.
+// srgb 表示mip链在线性空间滤波后编码回sRGB (颜色贴图), 否则直接线性滤波 (数据和法线贴图).
+// 同一张图两种用法的mip不同, 所以各存一个文件 (sRGB的为 <image>.srgb.texcache)
+namespace TextureCache
+{
+    // 文件布局或编码器的输出改变时加一
+    constexpr unsigned int VERSION = 4;
+
+    std::string CachePath(std::string const &sourcePath, bool srgb);
+
+    // 没有缓存文件、键过期、版本不符或数据损坏时返回false; format 返回缓存中的压缩格式.
+    // maxSize > 0 时只读取宽高都不超过 maxSize 的级别, 其余级别只有尺寸, data 为空 (留给流式加载)
+    bool Load(std::string const &sourcePath, bool srgb, TextureCompressor::Format &format, CompressedTexture &texture, int maxSize = 0);
+
+    // 只读取第 index 级, 供工作线程上的流式加载使用
+    bool LoadLevel(std::string const &sourcePath, bool srgb, unsigned int index, CompressedLevel &level);
+
+    bool Save(std::string const &sourcePath, bool srgb, TextureCompressor::Format format, CompressedTexture const &texture);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// 一级压缩后的mip
+struct CompressedLevel
+{
+    int width = 0, height = 0;
+    std::vector<unsigned char> data;
+};
+
+// 带完整mip链的块压缩纹理, format 为 glCompressedTexImage2D 的内部格式
+struct CompressedTexture
+{
+    GLenum format = 0;
+    std::vector<CompressedLevel> levels;
+
+    std::size_t Bytes() const noexcept;
+};
+
+// CPU端的BC块压缩编码器, 输入都是 RGBA8
+namespace TextureCompressor
+{
+    enum class Format
+    {
+        BC1, // RGB 4bpp (DXT1), 不透明的颜色贴图
+        BC3, // RGBA 8bpp (DXT5), 有透明度的颜色贴图
+        BC5, // RG 8bpp (RGTC2), 法线贴图只存xy, 着色器中重建 z = sqrt(1 - x*x - y*y)
+    };
+
+    std::size_t BlockBytes(Format format) noexcept;
+    GLenum GLFormat(Format format) noexcept;
+
+    // 编码一个4x4块, texels 为16个RGBA像素(行优先)
+    void EncodeBC1(const unsigned char *texels, unsigned char *block);
+    // 单通道块 (BC3的alpha, BC5的每个通道); values[i * stride] 为第i个像素
+    void EncodeBC4(const unsigned char *values, int stride, unsigned char *block);
+    void EncodeBC3(const unsigned char *texels, unsigned char *block);
+    void EncodeBC5(const unsigned char *texels, unsigned char *block);
+
+    // 压缩整幅图像, 宽高不是4的倍数时边缘块复制最后一行/列
+    std::vector<unsigned char> Compress(const unsigned char *rgba, int width, int height, Format format);
+
+    // 用 MipGenerator 生成到1x1的完整mip链并逐级压缩; srgb 时颜色在线性空间滤波, 高光等数据贴图要传 false.
+    // BC5 按法线贴图处理, 忽略 srgb
+    CompressedTexture CompressMipChain(const unsigned char *rgba, int width, int height, Format format, bool srgb);
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <MipGenerator.h>
+#include <PixelUploadRing.h>
+#include <TextureCompressor.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 采样参数, 与解析后的路径一起组成纹理缓存的键
+struct SamplerParams
+{
+    GLint wrapS = GL_REPEAT;
+    GLint wrapT = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+
+    bool operator==(SamplerParams const &other) const noexcept = default;
+};
+
+// 纹理在GPU上的存储方式. 压缩纹理在首次载入时编码并写入 TextureCache, 之后直接读取缓存
+enum class TextureCompression
+{
+    None,      // RGBA8, mip链由 MipGenerator 在解码线程上生成
+    Color,     // 不透明 BC1, 有透明度 BC3
+    NormalMap, // BC5, 只保留xy
+};
+
+// 贴图的用途, 决定mip链怎样滤波 (压缩与否都一样)
+enum class TextureUsage
+{
+    Color,     // sRGB编码的颜色 (漫反射), 转到线性空间滤波
+    Data,      // 线性的非颜色数据 (高光、高度等), 直接滤波
+    NormalMap, // [0,1] 编码的法线, 每级重新归一化
+};
+
+// GPU上的纹理对象, 最后一个句柄释放时 glDeleteTextures (必须发生在GL线程上)
+struct TextureObject
+{
+    unsigned int id = 0;
+    GLenum target = GL_TEXTURE_2D; // 纹理数组为 GL_TEXTURE_2D_ARRAY
+    int width = 0, height = 0;
+    int layers = 1;
+    std::size_t bytes = 0; // 估计的显存占用, 含当前驻留的mip
+};
+using TextureHandle = std::shared_ptr<const TextureObject>;
+
+// 解码好、等待上传的图像. 同一文件的并发解码共享一个对象, 第一个调用者解码, 其余的等待
+struct DecodedImage
+{
+    int width = 0, height = 0, nrComponents = 0;
+    unsigned char *data = nullptr;
+    std::string path;
+    TextureCompression compression = TextureCompression::None;
+    TextureUsage usage = TextureUsage::Color;
+    std::vector<MipLevel> mips;   // 未压缩时 data 之后的第1级到最后一级, 在解码线程上生成
+    CompressedTexture compressed; // compression 不为 None 时有效, data 为空; 流式加载时只有低分辨率的几级有数据
+    bool streamable = false;      // 有 TextureCache 文件可供流式读取高分辨率的级别
+    std::once_flag decoded;
+
+    DecodedImage() = default;
+    DecodedImage(const DecodedImage &) = delete;
+    DecodedImage &operator=(const DecodedImage &) = delete;
+    ~DecodedImage();
+};
+
+// 进程内共享的纹理缓存: 以 (解析后的绝对路径, 采样参数) 为键, O(1) 查找, 引用计数的句柄.
+// 每个纹理在驻留期间只解码、上传一次, 不同模型之间也共享
+class TextureManager
+{
+public:
+    struct Stats
+    {
+        std::size_t decodes = 0; // stbi_load 次数
+        std::size_t uploads = 0; // glTexImage2D 次数
+        std::size_t hits = 0;    // 命中已驻留纹理或进行中的解码
+        std::size_t resident = 0;
+        std::size_t residentBytes = 0;
+        std::size_t cooked = 0;         // 解码PNG并压缩编码的次数
+        std::size_t cookedCacheHits = 0; // 直接从 TextureCache 读取的次数
+        double decodeMs = 0.0; // 工作线程上的解码/生成mip/压缩编码时间总和
+        double uploadMs = 0.0; // GL线程上 Upload 的时间总和
+        PixelUploadRing::Stats ring;
+
+        // 流式加载
+        std::size_t streamingTextures = 0;
+        std::size_t streamingBytes = 0;  // 可流式加载的纹理当前驻留的字节数, 受 streamingBudget 限制
+        std::size_t streamingBudget = 0;
+        std::size_t pendingStreams = 0;  // 正在工作线程上读取的mip级
+        std::size_t streamedLevels = 0;  // 累计载入的mip级
+        std::size_t evictedLevels = 0;   // 累计淘汰的mip级
+        std::size_t budgetRejects = 0;   // 因预算不足而未能载入的请求 (每帧计一次)
+    };
+
+    // 可流式加载的纹理初始只驻留宽高不超过此值的mip
+    static constexpr int STREAM_TAIL_SIZE = 64;
+    // 连续这么多帧没有请求的纹理被视为不可见, 淘汰到只剩初始的低分辨率mip
+    static constexpr unsigned int STREAM_EVICT_FRAMES = 120;
+    // 同时在工作线程上读取的mip级数上限
+    static constexpr std::size_t MAX_PENDING_STREAMS = 4;
+
+    static TextureManager &Instance();
+
+    TextureManager(const TextureManager &) = delete;
+    TextureManager &operator=(const TextureManager &) = delete;
+
+    // GL线程: 命中时直接返回, 否则解码并上传
+    TextureHandle Load(std::string const &path, SamplerParams const &sampler = SamplerParams(),
+                       TextureCompression compression = TextureCompression::None, TextureUsage usage = TextureUsage::Color);
+    // 任意线程: 纹理已驻留时返回nullptr, 否则返回解码结果 (与其他线程上对同一文件的解码共享)
+    std::shared_ptr<DecodedImage> Decode(std::string const &path, SamplerParams const &sampler = SamplerParams(),
+                                         TextureCompression compression = TextureCompression::None,
+                                         TextureUsage usage = TextureUsage::Color);
+    // GL线程: 上传 Decode 的结果; 已驻留时直接返回已有句柄, image 为空时退化为 Load
+    TextureHandle Upload(std::string const &path, std::shared_ptr<DecodedImage> image,
+                         SamplerParams const &sampler = SamplerParams(),
+                         TextureCompression compression = TextureCompression::None, TextureUsage usage = TextureUsage::Color);
+
+    // 任意线程: 与 Decode 相同, 但二维纹理已驻留时也返回解码结果. 打包纹理数组需要每层的尺寸和像素
+    std::shared_ptr<DecodedImage> DecodeLayer(std::string const &path, TextureCompression compression,
+                                              TextureUsage usage = TextureUsage::Color);
+    // GL线程: 把 layers 打包成一个 GL_TEXTURE_2D_ARRAY, 第i个图像为第i层. 各层的尺寸和格式必须相同
+    // (见 CanShareArray), 否则返回nullptr. 以各层路径为键, 同一组图像只上传一次
+    TextureHandle UploadArray(std::vector<std::shared_ptr<DecodedImage>> const &layers,
+                              SamplerParams const &sampler = SamplerParams(),
+                              TextureCompression compression = TextureCompression::None,
+                              TextureUsage usage = TextureUsage::Color);
+    static bool CanShareArray(DecodedImage const &a, DecodedImage const &b) noexcept;
+
+    // GL线程: 经 GLState 绑定到纹理单元, 与该单元上已绑定的相同时跳过
+    void Bind(unsigned int unit, TextureObject const &texture);
+
+    Stats GetStats() const;
+
+    // GL线程: 本帧需要 texture 驻留到第 level 级 (0最清晰). 同一帧内多次请求取最清晰的一级
+    void RequestMip(TextureHandle const &texture, int level);
+    // GL线程, 每帧一次: 上传已读好的mip, 按本帧的请求和预算发起新的读取, 淘汰不可见或超出预算的mip
+    void UpdateStreaming();
+    // 可流式加载的纹理的显存预算; 0 表示关闭流式加载 (之后载入的纹理整条mip链常驻)
+    void SetStreamingBudget(std::size_t bytes);
+
+    // 绝对、规范化的路径, 不同写法的同一文件得到同一个键
+    static std::string ResolvePath(std::string const &path);
+
+private:
+    TextureManager() = default;
+
+    struct Key
+    {
+        std::string path;
+        SamplerParams sampler;
+        TextureCompression compression;
+        TextureUsage usage;
+        bool operator==(Key const &other) const noexcept = default;
+    };
+    struct KeyHash
+    {
+        std::size_t operator()(Key const &key) const noexcept;
+    };
+
+    // 调用前需持有 mutex
+    TextureHandle findLocked(Key const &key);
+    std::shared_ptr<DecodedImage> decodeShared(std::string const &resolvedPath, TextureCompression compression, TextureUsage usage);
+    // 在工作线程上: 读取压缩缓存, 未命中时解码PNG、编码并写缓存
+    bool cook(DecodedImage &image);
+    void release(Key const &key, TextureObject *texture);
+    // 最后一个引用释放时删除图像, 并去掉 decoding 中对应的空槽
+    void releaseDecoded(DecodedImage *image);
+
+    // 一个可流式加载的纹理. 驻留的是 [baseLevel, 最后一级], 通过 GL_TEXTURE_BASE_LEVEL 限制采样
+    struct Stream
+    {
+        TextureObject *texture = nullptr;
+        std::uint64_t serial = 0;       // 区分复用的纹理名
+        std::vector<std::string> paths; // 每层的源图像, TextureCache 以它为键
+        bool srgb = false;              // 各层都是颜色贴图, 读 TextureCache 的sRGB文件
+        GLenum format = 0;
+        std::vector<std::size_t> levelBytes; // 所有层合计
+        int tailLevel = 0;   // 始终驻留的最清晰一级
+        int baseLevel = 0;   // 当前驻留的最清晰一级
+        int wantedLevel = 0; // 最近一次请求的级别
+        int requestedLevel = 0; // 本帧请求中最清晰的一级, 未请求时为 levelBytes.size()
+        std::uint64_t lastRequestFrame = 0;
+        bool loading = false;
+    };
+    // 工作线程读完一级后放进这里, 由 UpdateStreaming 上传; 任务持有共享指针, 不依赖 TextureManager 的生命周期
+    struct StreamResult
+    {
+        unsigned int id;
+        std::uint64_t serial;
+        int level;
+        bool ok;
+        CompressedLevel data;
+    };
+    struct StreamQueue
+    {
+        std::mutex mutex;
+        std::vector<StreamResult> finished;
+    };
+
+    void addStream(TextureObject *texture, std::vector<DecodedImage const *> const &layers);
+    void dropLevels(Stream &stream, int newBase);
+    TextureHandle finishUpload(Key const &key, TextureObject *texture, double uploadMs);
+    // 上传路径上的绑定, 使用当前活动的纹理单元
+    void bindForUpload(TextureObject const &texture);
+
+    std::unique_ptr<PixelUploadRing> uploadRing; // 第一次上传时在GL线程上创建
+    mutable std::mutex mutex;
+    std::unordered_map<Key, std::weak_ptr<const TextureObject>, KeyHash> textures;
+    // 进行中或等待上传的解码, 键为路径、压缩方式和用途 (decodingKey); 图像释放时去掉
+    std::unordered_map<std::string, std::weak_ptr<DecodedImage>> decoding;
+    Stats stats;
+
+    bool streaming = true;
+    std::size_t streamingBudget = 256u * 1024 * 1024;
+    std::unordered_map<unsigned int, Stream> streams; // 以纹理名为键
+    std::shared_ptr<StreamQueue> streamQueue = std::make_shared<StreamQueue>();
+    std::uint64_t streamFrame = 0;
+    std::uint64_t nextStreamSerial = 1;
+};
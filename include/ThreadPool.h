@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// 简单的线程池, 用于导入/解码等CPU工作. GL调用必须留在上下文线程上.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool();
+
+    // process-wide pool shared by the loaders
+    static ThreadPool &Global();
+
+    unsigned int Size() const noexcept { return static_cast<unsigned int>(workers.size()); }
+
+    template <class F>
+    auto Submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    // 并行执行 fn(i), i in [0, count). 调用线程也参与执行, 所以在工作线程中嵌套调用也不会死锁.
+    // fn 抛出的第一个异常在所有下标结束后于调用线程重新抛出, 之后的下标不再执行.
+    template <class F>
+    void ParallelFor(std::size_t count, F &&fn)
+    {
+        if (count == 0)
+            return;
+        auto state = std::make_shared<ParallelState>();
+        state->count = count;
+        state->body = [&fn](std::size_t i) { fn(i); };
+
+        std::size_t helpers = std::min<std::size_t>(workers.size(), count - 1);
+        for (std::size_t i = 0; i < helpers; i++)
+            enqueue([state]() { runParallel(*state); });
+        runParallel(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state]() { return state->done.load() == state->count; });
+        if (state->error)
+            std::rethrow_exception(state->error);
+    }
+
+private:
+    struct ParallelState
+    {
+        std::size_t count = 0;
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::function<void(std::size_t)> body;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error; // 只由第一个把 failed 置位的线程写入
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    static void runParallel(ParallelState &state);
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping;
+};
@@ -1,7 +1,12 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+#ifdef INSTANCED
+layout (location = 5) in mat4 aInstanceModel;
+#define model aInstanceModel
+#else
 uniform mat4 model;
+#endif
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -14,6 +14,8 @@ struct Material{
     float shininess;
 };
 
+// 灯光放在 std140 uniform块中, 由 C++ 端的 LightBuffer 维护, 所有程序共享.
+// 成员顺序与 LightBuffer 中的 *Std140 结构一致: vec3 后面的 float 填进它的16字节空位
 struct DirLight{
     vec3 direction; // 平行光源
 
@@ -24,39 +26,52 @@ struct DirLight{
 
 struct PointLight{
     vec3 position; // 点光源
-    // 距离衰减
-    float constant;
-    float linear;
-    float quadratic;
-
+    float constant; // 距离衰减
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight{
     vec3 position;
+    float constant; // 距离衰减
     vec3 direction;
-
-    float cutOff; //聚光
-    float outerCutOff; //外围
-    // 距离衰减
-    float constant;
     float linear;
-    float quadratic;
-
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff; //聚光
     vec3 specular;
-
+    float outerCutOff; //外围
 };
   
 uniform vec3 viewPos;
 uniform Material material;
-uniform DirLight dirLight;
+
+// 场景实际使用的灯光, 由 ShaderProgram 的宏定义特化 (见 ShaderPermutations). 未定义时使用全部灯光
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 4
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+#endif
+#ifndef DIR_LIGHT
+#define DIR_LIGHT 1
+#endif
+#ifndef SPOT_LIGHT
+#define SPOT_LIGHT 1
+#endif
+
+// 块的布局与特化无关, 始终是 LightBuffer::MAX_POINT_LIGHTS 个点光源, 所有排列共享同一个UBO
+#define MAX_POINT_LIGHTS 4
+// 特化出的点光源数超过块里的数组时, 循环会读到块外面; 在编译时报错而不是静默越界
+#if NR_POINT_LIGHTS > MAX_POINT_LIGHTS
+#error NR_POINT_LIGHTS exceeds MAX_POINT_LIGHTS
+#endif
+layout (std140) uniform Lights{
+    DirLight dirLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
 // uniform float matrixLight;
 // uniform float matrixMove;
@@ -69,13 +84,20 @@ void main()
 {
     vec3 viewDir = normalize(viewPos - FragPos);
 
+    vec3 result = vec3(0.0);
     // 平行光
-    vec3 result = CalDirLight(dirLight, Normal, viewDir);
+#if DIR_LIGHT
+    result += CalDirLight(dirLight, Normal, viewDir);
+#endif
     // 点光源
+#if NR_POINT_LIGHTS > 0
     for(int i=0; i < NR_POINT_LIGHTS; i++)
         result += CalPointLight(pointLights[i], Normal, FragPos, viewDir);
+#endif
     // 聚光
+#if SPOT_LIGHT
     result += CalSpotLight(spotLight, Normal, FragPos, viewDir);
+#endif
 
     FragColor = vec4(result, 1.0);
 
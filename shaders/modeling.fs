@@ -2,10 +2,23 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+flat in uint Material;
+
+// 实例的材质号: 0 不着色, 其余乘上对应的颜色
+const vec3 materialTints[8] = vec3[8](
+    vec3(1.0), vec3(1.0, 0.55, 0.55), vec3(0.55, 1.0, 0.55), vec3(0.55, 0.55, 1.0),
+    vec3(1.0, 1.0, 0.5), vec3(0.5, 1.0, 1.0), vec3(1.0, 0.5, 1.0), vec3(0.7));
 
 uniform sampler2D texture_diffuse1;
+// 纹理数组中的漫反射贴图, texture_diffuse1_layer 为 -1 时使用 texture_diffuse1
+uniform sampler2DArray texture_diffuse1_array;
+uniform int texture_diffuse1_layer;
 
 void main()
 {    
-    FragColor = texture(texture_diffuse1, TexCoords);
-}
\ No newline at end of file
+    if (texture_diffuse1_layer >= 0)
+        FragColor = texture(texture_diffuse1_array, vec3(TexCoords, texture_diffuse1_layer));
+    else
+        FragColor = texture(texture_diffuse1, TexCoords);
+    FragColor.rgb *= materialTints[Material % 8u];
+}
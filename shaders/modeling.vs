@@ -1,16 +1,35 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec3 aNormal; // 压缩格式下为八面体编码的 xy
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
+flat out uint Material;
 
+// INSTANCED: 模型矩阵和材质号来自每实例属性 (InstanceBatch), 否则来自 uniform
+#ifdef INSTANCED
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in uint aInstanceMaterial;
+#define model aInstanceModel
+#else
 uniform mat4 model;
+#endif
 uniform mat4 view;
 uniform mat4 projection;
 
+// 压缩顶点格式: 位置是相对网格AABB的unorm16
+uniform bool packedVertex;
+uniform vec3 boundsMin;
+uniform vec3 boundsExtent;
+
 void main()
 {
+    vec3 position = packedVertex ? boundsMin + aPos * boundsExtent : aPos;
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+#ifdef INSTANCED
+    Material = aInstanceMaterial;
+#else
+    Material = 0u;
+#endif
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
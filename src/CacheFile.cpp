@@ -0,0 +1,62 @@
+#include "CacheFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+std::uint64_t CacheFile::Hash(std::uint64_t h, std::string_view text)
+{
+    for (char c : text)
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    return (h ^ 0xFFu) * 1099511628211ull;
+}
+
+bool CacheFile::SourceKey(std::string const &sourcePath, std::int64_t &mtime, std::uint64_t &size)
+{
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(sourcePath, ec);
+    if (ec)
+        return false;
+    auto bytes = std::filesystem::file_size(sourcePath, ec);
+    if (ec)
+        return false;
+    mtime = static_cast<std::int64_t>(time.time_since_epoch().count());
+    size = static_cast<std::uint64_t>(bytes);
+    return true;
+}
+
+bool CacheFile::CheckMagic(const unsigned char *data, std::size_t size, const char (&magic)[4], std::uint32_t version)
+{
+    std::uint32_t fileVersion;
+    if (!data || size < sizeof(magic) + sizeof(fileVersion))
+        return false;
+    std::memcpy(&fileVersion, data + sizeof(magic), sizeof(fileVersion));
+    return std::memcmp(data, magic, sizeof(magic)) == 0 && fileVersion == version;
+}
+
+bool CacheFile::Write(std::string const &path, const char *tag, std::function<void(std::ofstream &)> const &writer)
+{
+    std::string tmpPath = path + ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        writer(out);
+        if (!out)
+        {
+            std::cout << "ERROR::" << tag << "::WRITE_FAILED " << tmpPath << std::endl;
+            out.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
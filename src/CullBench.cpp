@@ -0,0 +1,62 @@
+// 视锥剔除的基准: 逐个 Frustum::IntersectsBox 与 FrustumCuller 的SIMD核心 (单线程 / 分块并行) 的对比
+#include <Frustum.h>
+#include <FrustumCuller.h>
+#include <Stopwatch.h>
+#include <ThreadPool.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const int REPEATS = 9;
+
+    struct Box
+    {
+        glm::vec3 min, max;
+    };
+}
+
+int main()
+{
+    // 相机在原点看向 -z, 包围盒散布在 400x50x400 的范围内, 约3%可见
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum(projection * view);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f), height(-25.0f, 25.0f), size(0.5f, 4.0f);
+    std::cout << "worker threads: " << ThreadPool::Global().Size() << std::endl;
+    for (std::size_t count : {std::size_t(1000), std::size_t(10000), std::size_t(100000), std::size_t(1000000)})
+    {
+        std::vector<Box> boxes(count);
+        FrustumCuller culler;
+        culler.Reserve(count);
+        for (Box &box : boxes)
+        {
+            box.min = glm::vec3(position(random), height(random), position(random));
+            box.max = box.min + glm::vec3(size(random), size(random), size(random));
+            culler.Add(box.min, box.max);
+        }
+
+        std::vector<std::uint32_t> scalar, simd, parallel;
+        double scalarMs = Stopwatch::BestOfMs(REPEATS, [&]() {
+            scalar.clear();
+            for (std::size_t i = 0; i < count; i++)
+                if (frustum.IntersectsBox(boxes[i].min, boxes[i].max))
+                    scalar.push_back(static_cast<std::uint32_t>(i));
+        });
+        double simdMs = Stopwatch::BestOfMs(REPEATS, [&]() { culler.Cull(frustum, simd, false); });
+        double parallelMs = Stopwatch::BestOfMs(REPEATS, [&]() { culler.Cull(frustum, parallel); });
+        bool same = scalar == simd && scalar == parallel;
+        std::cout << count << " boxes, " << scalar.size() << " visible: IntersectsBox " << scalarMs << " ms, FrustumCuller " << simdMs
+                  << " ms, parallel " << parallelMs << " ms" << (same ? "" : " (MISMATCH)") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "DrawCommandBuffer.h"
+#include "GLState.h"
+#include "Mesh.h"
+#include "RenderStats.h"
+
+#include <iostream>
+
+DrawCommandBuffer::DrawCommandBuffer()
+{
+    glGenBuffers(1, &commandBuffer);
+}
+
+DrawCommandBuffer::~DrawCommandBuffer()
+{
+    glDeleteBuffers(1, &commandBuffer);
+    GLState::Instance().DeletedBuffer(commandBuffer);
+}
+
+bool DrawCommandBuffer::MultiDrawIndirectSupported() noexcept
+{
+    // 命令的 baseInstance 不为0时需要 GL_ARB_base_instance (GL 4.2), 只有多重间接绘制时仍逐命令绘制
+#if defined(GL_ARB_multi_draw_indirect) && defined(GL_ARB_base_instance)
+    return GLAD_GL_ARB_multi_draw_indirect != 0 && GLAD_GL_ARB_base_instance != 0;
+#else
+    return false;
+#endif
+}
+
+void DrawCommandBuffer::Add(Mesh &mesh, unsigned int lod, glm::mat4 const &model, std::uint32_t material)
+{
+    if (!mesh.IsPooled())
+    {
+        static bool warned = false;
+        if (!warned)
+            std::cout << "WARNING::DRAW_COMMAND_BUFFER::MESH_NOT_POOLED" << std::endl;
+        warned = true;
+        return;
+    }
+    Entry entry;
+    entry.mesh = &mesh;
+    entry.command = mesh.GetDrawCommand(lod);
+    entry.instance.model = model * mesh.GetDequantizeMatrix();
+    entry.instance.material = material;
+    entries.push_back(entry);
+}
+
+void DrawCommandBuffer::Submit(ShaderProgram &shader)
+{
+    if (entries.empty())
+        return;
+    // 同一材质的命令排在一起, 组内保持加入的顺序 (基数排序是稳定的)
+    // 高32位为材质号, 低32位为下标
+    order.clear();
+    for (std::size_t i = 0; i < entries.size(); i++)
+        order.push_back(static_cast<std::uint64_t>(entries[i].mesh->GetMaterialKey()) << 32 | i);
+    RadixSort::Sort(order, scratch, 32);
+    commands.clear();
+    instances.clear();
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        Entry const &entry = entries[static_cast<std::uint32_t>(order[i])];
+        commands.push_back(entry.command);
+        commands.back().baseInstance = static_cast<GLuint>(i);
+        instances.push_back(entry.instance);
+    }
+    batch.Update(instances);
+
+    bool indirect = MultiDrawIndirectSupported();
+#ifdef GL_ARB_multi_draw_indirect
+    if (indirect)
+    {
+        GLState::Instance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+    }
+#endif
+
+    for (std::size_t begin = 0, end; begin < order.size(); begin = end)
+    {
+        Mesh &mesh = *entries[static_cast<std::uint32_t>(order[begin])].mesh;
+        for (end = begin + 1; end < order.size() && order[end] >> 32 == order[begin] >> 32; end++)
+            ;
+        std::size_t triangles = 0;
+        for (std::size_t i = begin; i < end; i++)
+            triangles += commands[i].count / 3;
+        renderStats.triangles += triangles;
+
+        mesh.BindMultiDraw(shader);
+#ifdef GL_ARB_multi_draw_indirect
+        if (indirect)
+        {
+            // 实例属性指向批次开头, 每个命令的 baseInstance 选出自己的数据
+            mesh.AttachInstances(batch);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void *)(begin * sizeof(DrawElementsIndirectCommand)),
+                                        static_cast<GLsizei>(end - begin), 0);
+            renderStats.drawCalls++;
+            continue;
+        }
+#endif
+        // 没有 baseInstance: 每个命令把实例属性移到自己的数据上
+        for (std::size_t i = begin; i < end; i++)
+        {
+            DrawElementsIndirectCommand const &command = commands[i];
+            mesh.AttachInstances(batch, i);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                              (const void *)(command.firstIndex * sizeof(unsigned int)), 1, command.baseVertex);
+            renderStats.drawCalls++;
+        }
+    }
+    entries.clear();
+}
@@ -0,0 +1,157 @@
+#include "FrustumCuller.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_USE_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULL_USE_SSE2 1
+#endif
+
+namespace
+{
+    struct Bounds
+    {
+        float const *minX, *minY, *minZ, *maxX, *maxY, *maxZ;
+    };
+
+    // 对每个平面, 法线的每个分量乘上 min 和 max 取大的一个, 三个分量加起来就是离平面最远的内侧角点.
+    // 该角点在任一平面外侧则整个包围盒在视锥外
+    void cullRange(glm::vec4 const *planes, Bounds const &bounds, std::size_t begin, std::size_t end, std::vector<std::uint32_t> &visible)
+    {
+        std::size_t i = begin;
+#ifdef CULL_USE_AVX
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 x0 = _mm256_loadu_ps(bounds.minX + i), y0 = _mm256_loadu_ps(bounds.minY + i), z0 = _mm256_loadu_ps(bounds.minZ + i);
+            __m256 x1 = _mm256_loadu_ps(bounds.maxX + i), y1 = _mm256_loadu_ps(bounds.maxY + i), z1 = _mm256_loadu_ps(bounds.maxZ + i);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m256 nx = _mm256_set1_ps(planes[p].x), ny = _mm256_set1_ps(planes[p].y), nz = _mm256_set1_ps(planes[p].z);
+                __m256 d = _mm256_add_ps(_mm256_max_ps(_mm256_mul_ps(x0, nx), _mm256_mul_ps(x1, nx)),
+                                         _mm256_max_ps(_mm256_mul_ps(y0, ny), _mm256_mul_ps(y1, ny)));
+                d = _mm256_add_ps(d, _mm256_max_ps(_mm256_mul_ps(z0, nz), _mm256_mul_ps(z1, nz)));
+                d = _mm256_add_ps(d, _mm256_set1_ps(planes[p].w));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            for (unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(inside)); mask; mask &= mask - 1)
+                visible.push_back(static_cast<std::uint32_t>(i + std::countr_zero(mask)));
+        }
+#endif
+#ifdef CULL_USE_SSE2
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 x0 = _mm_loadu_ps(bounds.minX + i), y0 = _mm_loadu_ps(bounds.minY + i), z0 = _mm_loadu_ps(bounds.minZ + i);
+            __m128 x1 = _mm_loadu_ps(bounds.maxX + i), y1 = _mm_loadu_ps(bounds.maxY + i), z1 = _mm_loadu_ps(bounds.maxZ + i);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 nx = _mm_set1_ps(planes[p].x), ny = _mm_set1_ps(planes[p].y), nz = _mm_set1_ps(planes[p].z);
+                __m128 d = _mm_add_ps(_mm_max_ps(_mm_mul_ps(x0, nx), _mm_mul_ps(x1, nx)), _mm_max_ps(_mm_mul_ps(y0, ny), _mm_mul_ps(y1, ny)));
+                d = _mm_add_ps(d, _mm_max_ps(_mm_mul_ps(z0, nz), _mm_mul_ps(z1, nz)));
+                d = _mm_add_ps(d, _mm_set1_ps(planes[p].w));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+            }
+            for (unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(inside)); mask; mask &= mask - 1)
+                visible.push_back(static_cast<std::uint32_t>(i + std::countr_zero(mask)));
+        }
+#endif
+        // 剩下不足一组的包围盒
+        for (; i < end; i++)
+        {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++)
+            {
+                glm::vec4 const &plane = planes[p];
+                float d = std::max(bounds.minX[i] * plane.x, bounds.maxX[i] * plane.x) + std::max(bounds.minY[i] * plane.y, bounds.maxY[i] * plane.y) +
+                          std::max(bounds.minZ[i] * plane.z, bounds.maxZ[i] * plane.z) + plane.w;
+                inside = d >= 0.0f;
+            }
+            if (inside)
+                visible.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+void FrustumCuller::Clear() noexcept
+{
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+void FrustumCuller::Reserve(std::size_t count)
+{
+    minX.reserve(count);
+    minY.reserve(count);
+    minZ.reserve(count);
+    maxX.reserve(count);
+    maxY.reserve(count);
+    maxZ.reserve(count);
+}
+
+std::size_t FrustumCuller::Add(glm::vec3 const &min, glm::vec3 const &max)
+{
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+    return minX.size() - 1;
+}
+
+std::size_t FrustumCuller::Add(glm::vec3 const &min, glm::vec3 const &max, glm::mat4 const &transform)
+{
+    // 中心照常变换, 半边长乘上矩阵的绝对值 (Arvo)
+    glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+    glm::vec3 half = (max - min) * 0.5f;
+    glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * half.x + glm::abs(glm::vec3(transform[1])) * half.y +
+                       glm::abs(glm::vec3(transform[2])) * half.z;
+    return Add(center - extent, center + extent);
+}
+
+std::size_t FrustumCuller::Cull(Frustum const &frustum, std::vector<std::uint32_t> &visible, bool parallel)
+{
+    auto start = std::chrono::steady_clock::now();
+    glm::vec4 planes[6];
+    for (int p = 0; p < 6; p++)
+        planes[p] = frustum.GetPlane(p);
+    Bounds bounds{minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data()};
+    std::size_t count = Size();
+    visible.clear();
+
+    std::size_t tasks = parallel ? std::min<std::size_t>(count / MIN_BOXES_PER_TASK, (ThreadPool::Global().Size() + 1) * 4) : 0;
+    if (tasks <= 1)
+        cullRange(planes, bounds, 0, count, visible);
+    else
+    {
+        // 块的边界对齐到8个, 每块都整组地测试
+        std::size_t perTask = (count / tasks + 7) & ~std::size_t(7);
+        tasks = (count + perTask - 1) / perTask;
+        if (chunks.size() < tasks)
+            chunks.resize(tasks);
+        ThreadPool::Global().ParallelFor(tasks, [&](std::size_t task) {
+            chunks[task].clear();
+            cullRange(planes, bounds, task * perTask, std::min(count, (task + 1) * perTask), chunks[task]);
+        });
+        for (std::size_t task = 0; task < tasks; task++)
+            visible.insert(visible.end(), chunks[task].begin(), chunks[task].end());
+    }
+
+    renderStats.boundsTested += count;
+    renderStats.boundsVisible += visible.size();
+    renderStats.cullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return visible.size();
+}
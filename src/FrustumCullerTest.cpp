@@ -0,0 +1,77 @@
+// FrustumCuller 的测试: SIMD 和分块并行的结果与逐个调用 Frustum::IntersectsBox 完全相同. 只用CPU
+#include <Frustum.h>
+#include <FrustumCuller.h>
+#include <TestCheck.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+    TestCheck check("FRUSTUMCULLER_TEST");
+}
+
+int main()
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f), extent(0.01f, 8.0f), angle(0.0f, 6.2831853f);
+
+    // 个数不是4和8的倍数, 以覆盖SIMD的尾部; 最大的一组超过 MIN_BOXES_PER_TASK, 会分块
+    for (std::size_t count : {std::size_t(1), std::size_t(7), std::size_t(1001), FrustumCuller::MIN_BOXES_PER_TASK * 3 + 5})
+    {
+        FrustumCuller culler;
+        culler.Reserve(count);
+        std::vector<glm::vec3> mins, maxs;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            glm::vec3 min(position(random), position(random), position(random));
+            glm::vec3 max = min + glm::vec3(extent(random), extent(random), extent(random));
+            // 一半的包围盒经过旋转和平移加入, 存的是变换后的外接AABB
+            if (i % 2)
+            {
+                glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(position(random), 0.0f, 0.0f)), angle(random),
+                                                  glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+                culler.Add(min, max, transform);
+            }
+            else
+                culler.Add(min, max);
+            mins.push_back(culler.GetMin(i));
+            maxs.push_back(culler.GetMax(i));
+            check(glm::all(glm::lessThanEqual(mins.back(), maxs.back())), "stored box has min > max");
+        }
+        check(culler.Size() == count, "Size does not match the number of added boxes");
+
+        for (int view = 0; view < 16; view++)
+        {
+            glm::vec3 eye(position(random), position(random), position(random));
+            glm::vec3 target(position(random), position(random), position(random));
+            glm::mat4 projection = glm::perspective(glm::radians(30.0f + view * 5.0f), 4.0f / 3.0f, 0.1f, 40.0f + view * 10.0f);
+            Frustum frustum(projection * glm::lookAt(eye, target + glm::vec3(0.0f, 0.0f, 1e-3f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+            std::vector<std::uint32_t> expected;
+            for (std::size_t i = 0; i < count; i++)
+                if (frustum.IntersectsBox(mins[i], maxs[i]))
+                    expected.push_back(static_cast<std::uint32_t>(i));
+            for (bool parallel : {false, true})
+            {
+                std::vector<std::uint32_t> visible = {12345}; // 旧内容应被清掉
+                std::size_t visibleCount = culler.Cull(frustum, visible, parallel);
+                check(visibleCount == visible.size(), "Cull returned a count different from the output size");
+                check(visible == expected, "Cull differs from Frustum::IntersectsBox");
+            }
+        }
+    }
+
+    // 清空后不再有包围盒
+    FrustumCuller culler;
+    culler.Add(glm::vec3(-1.0f), glm::vec3(1.0f));
+    culler.Clear();
+    std::vector<std::uint32_t> visible;
+    check(culler.Cull(Frustum(glm::mat4(1.0f)), visible) == 0 && visible.empty(), "Clear left boxes behind");
+
+    return check.Finish("FrustumCuller");
+}
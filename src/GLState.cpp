@@ -0,0 +1,217 @@
+#include "GLState.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+
+GLState &GLState::Instance()
+{
+    static GLState instance;
+    return instance;
+}
+
+GLState::GLState() = default;
+
+bool GLState::count(bool issue) noexcept
+{
+    if (issue)
+        renderStats.stateCalls++;
+    else
+        renderStats.stateCallsFiltered++;
+    return issue;
+}
+
+bool GLState::UseProgram(GLuint program_)
+{
+    if (!count(program != program_))
+        return false;
+    glUseProgram(program_);
+    program = program_;
+    return true;
+}
+
+bool GLState::BindVertexArray(GLuint vertexArray_)
+{
+    if (!count(vertexArray != vertexArray_))
+        return false;
+    glBindVertexArray(vertexArray_);
+    vertexArray = vertexArray_;
+    elementBuffer = UNKNOWN;
+    return true;
+}
+
+bool GLState::ActiveTexture(unsigned int unit)
+{
+    if (!count(activeUnit != unit))
+        return false;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    return true;
+}
+
+GLuint *GLState::textureSlot(unsigned int unit, GLenum target) noexcept
+{
+    if (unit >= MAX_TEXTURE_UNITS)
+        return nullptr;
+    if (target == GL_TEXTURE_2D)
+        return &textures[unit].texture2D;
+    if (target == GL_TEXTURE_2D_ARRAY)
+        return &textures[unit].textureArray;
+    return nullptr;
+}
+
+bool GLState::BindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+    GLuint *slot = textureSlot(unit, target);
+    if (slot && !count(*slot != texture))
+        return false;
+    ActiveTexture(unit);
+    glBindTexture(target, texture);
+    if (slot)
+        *slot = texture;
+    else
+        count(true);
+    return true;
+}
+
+bool GLState::BindTexture(GLenum target, GLuint texture)
+{
+    // 活动单元未知时无法缓存, 直接绑定
+    if (activeUnit == UNKNOWN)
+    {
+        count(true);
+        glBindTexture(target, texture);
+        return true;
+    }
+    return BindTexture(activeUnit, target, texture);
+}
+
+GLuint *GLState::bufferSlot(GLenum target) noexcept
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+        return &arrayBuffer;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return &elementBuffer;
+    case GL_UNIFORM_BUFFER:
+        return &uniformBuffer;
+    case GL_PIXEL_UNPACK_BUFFER:
+        return &pixelUnpackBuffer;
+#ifdef GL_DRAW_INDIRECT_BUFFER
+    case GL_DRAW_INDIRECT_BUFFER:
+        return &drawIndirectBuffer;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint *slot = bufferSlot(target);
+    if (!count(!slot || *slot != buffer))
+        return false;
+    glBindBuffer(target, buffer);
+    if (slot)
+        *slot = buffer;
+    return true;
+}
+
+bool GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    GLuint *slot = nullptr;
+    if (target == GL_UNIFORM_BUFFER)
+    {
+        if (uniformBindings.size() <= index)
+            uniformBindings.resize(index + 1, UNKNOWN);
+        slot = &uniformBindings[index];
+    }
+    if (!count(!slot || *slot != buffer))
+        return false;
+    glBindBufferBase(target, index, buffer);
+    if (slot)
+        *slot = buffer;
+    if (GLuint *generic = bufferSlot(target))
+        *generic = buffer;
+    return true;
+}
+
+bool GLState::setCapability(GLenum capability, bool enabled)
+{
+    auto it = std::find_if(capabilities.begin(), capabilities.end(),
+                           [capability](std::pair<GLenum, bool> const &entry) { return entry.first == capability; });
+    if (it != capabilities.end() && !count(it->second != enabled))
+        return false;
+    if (it == capabilities.end())
+    {
+        count(true);
+        capabilities.emplace_back(capability, enabled);
+    }
+    else
+        it->second = enabled;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+    return true;
+}
+
+bool GLState::Enable(GLenum capability)
+{
+    return setCapability(capability, true);
+}
+
+bool GLState::Disable(GLenum capability)
+{
+    return setCapability(capability, false);
+}
+
+void GLState::DeletedProgram(GLuint program_) noexcept
+{
+    // 删除当前程序时GL推迟到它不再是当前程序时才真正删除, 绑定仍然有效; 但名字可能被复用, 视为未知
+    if (program == program_)
+        program = UNKNOWN;
+}
+
+void GLState::DeletedVertexArray(GLuint vertexArray_) noexcept
+{
+    if (vertexArray == vertexArray_)
+    {
+        vertexArray = 0;
+        elementBuffer = UNKNOWN;
+    }
+}
+
+void GLState::DeletedTexture(GLuint texture) noexcept
+{
+    for (TextureBinding &binding : textures)
+    {
+        if (binding.texture2D == texture)
+            binding.texture2D = 0;
+        if (binding.textureArray == texture)
+            binding.textureArray = 0;
+    }
+}
+
+void GLState::DeletedBuffer(GLuint buffer) noexcept
+{
+    for (GLuint *slot : {&arrayBuffer, &uniformBuffer, &pixelUnpackBuffer, &drawIndirectBuffer})
+        if (*slot == buffer)
+            *slot = 0;
+    // 只从当前VAO上解除, 其他VAO仍引用它
+    if (elementBuffer == buffer)
+        elementBuffer = 0;
+    for (GLuint &binding : uniformBindings)
+        if (binding == buffer)
+            binding = 0;
+}
+
+void GLState::Invalidate() noexcept
+{
+    program = vertexArray = activeUnit = UNKNOWN;
+    for (TextureBinding &binding : textures)
+        binding = TextureBinding();
+    arrayBuffer = elementBuffer = uniformBuffer = pixelUnpackBuffer = drawIndirectBuffer = UNKNOWN;
+    uniformBindings.clear();
+    capabilities.clear();
+}
@@ -0,0 +1,180 @@
+#include "GeometryPool.h"
+#include "GLState.h"
+#include "InstanceBatch.h"
+#include "Mesh.h"
+
+#include <algorithm>
+
+GeometryPool &GeometryPool::Instance()
+{
+    static GeometryPool instance;
+    return instance;
+}
+
+GeometryPool::GeometryPool() = default;
+
+void GeometryPool::create(Arena &arena, VertexFormat format)
+{
+    std::size_t stride = Mesh::VertexStride(format);
+    GLState &state = GLState::Instance();
+    glGenVertexArrays(1, &arena.vertexArray);
+    glGenBuffers(1, &arena.vertexBuffer);
+    glGenBuffers(1, &arena.indexBuffer);
+    // 上传和扩容都经过 GL_COPY_WRITE_BUFFER, 不改动当前VAO的索引缓冲
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, arena.vertexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_VERTICES * stride, nullptr, GL_STATIC_DRAW);
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, arena.indexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_INDICES * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    arena.vertexCapacity = INITIAL_VERTICES;
+    arena.indexCapacity = INITIAL_INDICES;
+    stats.capacityBytes += INITIAL_VERTICES * stride + INITIAL_INDICES * sizeof(unsigned int);
+
+    state.BindVertexArray(arena.vertexArray);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer);
+    state.BindBuffer(GL_ARRAY_BUFFER, arena.vertexBuffer);
+    Mesh::SetupVertexAttributes(format);
+}
+
+void GeometryPool::grow(GLuint &buffer, std::size_t usedBytes, std::size_t bytes)
+{
+    GLState &state = GLState::Instance();
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+    state.BindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    glDeleteBuffers(1, &buffer);
+    state.DeletedBuffer(buffer);
+    buffer = grown;
+    stats.growths++;
+}
+
+std::size_t GeometryPool::takeRange(std::vector<Range> &free, std::size_t count) noexcept
+{
+    if (count == 0)
+        return NO_RANGE;
+    for (std::size_t i = 0; i < free.size(); i++)
+    {
+        if (free[i].count < count)
+            continue;
+        std::size_t offset = free[i].offset;
+        free[i].offset += count;
+        free[i].count -= count;
+        if (free[i].count == 0)
+            free.erase(free.begin() + i);
+        return offset;
+    }
+    return NO_RANGE;
+}
+
+void GeometryPool::releaseRange(std::vector<Range> &free, std::size_t &used, std::size_t offset, std::size_t count)
+{
+    if (count == 0)
+        return;
+    auto next = std::lower_bound(free.begin(), free.end(), offset, [](Range const &range, std::size_t value) { return range.offset < value; });
+    next = free.insert(next, Range{offset, count});
+    // 与后一段合并
+    if (next + 1 != free.end() && next->offset + next->count == (next + 1)->offset)
+    {
+        next->count += (next + 1)->count;
+        free.erase(next + 1);
+    }
+    // 与前一段合并
+    if (next != free.begin() && (next - 1)->offset + (next - 1)->count == next->offset)
+    {
+        (next - 1)->count += next->count;
+        next = free.erase(next) - 1;
+    }
+    if (next->offset + next->count == used)
+    {
+        used = next->offset;
+        free.erase(next);
+    }
+}
+
+GeometryPool::Allocation GeometryPool::Allocate(VertexFormat format, const void *vertices, std::size_t vertexCount,
+                                                const unsigned int *indices, std::size_t indexCount)
+{
+    Arena &target = arena(format);
+    if (target.vertexArray == 0)
+        create(target, format);
+    std::size_t stride = Mesh::VertexStride(format);
+    GLState &state = GLState::Instance();
+
+    // 先在空闲表中找, 找不到时接在已用部分后面
+    std::size_t vertexOffset = takeRange(target.freeVertices, vertexCount);
+    std::size_t indexOffset = takeRange(target.freeIndices, indexCount);
+    if (vertexOffset != NO_RANGE || indexOffset != NO_RANGE)
+        stats.reuses++;
+    if (vertexOffset == NO_RANGE && target.vertexCount + vertexCount > target.vertexCapacity)
+    {
+        std::size_t capacity = target.vertexCapacity;
+        while (capacity < target.vertexCount + vertexCount)
+            capacity *= 2;
+        grow(target.vertexBuffer, target.vertexCount * stride, capacity * stride);
+        stats.capacityBytes += (capacity - target.vertexCapacity) * stride;
+        target.vertexCapacity = capacity;
+        // VAO中的属性指针仍指向旧缓冲
+        state.BindVertexArray(target.vertexArray);
+        state.BindBuffer(GL_ARRAY_BUFFER, target.vertexBuffer);
+        Mesh::SetupVertexAttributes(format);
+    }
+    if (indexOffset == NO_RANGE && target.indexCount + indexCount > target.indexCapacity)
+    {
+        std::size_t capacity = target.indexCapacity;
+        while (capacity < target.indexCount + indexCount)
+            capacity *= 2;
+        grow(target.indexBuffer, target.indexCount * sizeof(unsigned int), capacity * sizeof(unsigned int));
+        stats.capacityBytes += (capacity - target.indexCapacity) * sizeof(unsigned int);
+        target.indexCapacity = capacity;
+        state.BindVertexArray(target.vertexArray);
+        state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, target.indexBuffer);
+    }
+
+    if (vertexOffset == NO_RANGE)
+    {
+        vertexOffset = target.vertexCount;
+        target.vertexCount += vertexCount;
+    }
+    if (indexOffset == NO_RANGE)
+    {
+        indexOffset = target.indexCount;
+        target.indexCount += indexCount;
+    }
+
+    Allocation allocation;
+    allocation.baseVertex = static_cast<GLint>(vertexOffset);
+    allocation.firstIndex = static_cast<unsigned int>(indexOffset);
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, target.vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * stride, vertexCount * stride, vertices);
+    state.BindBuffer(GL_COPY_WRITE_BUFFER, target.indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+    stats.vertexBytes += vertexCount * stride;
+    stats.indexBytes += indexCount * sizeof(unsigned int);
+    return allocation;
+}
+
+void GeometryPool::Free(VertexFormat format, Allocation allocation, std::size_t vertexCount, std::size_t indexCount)
+{
+    Arena &target = arena(format);
+    releaseRange(target.freeVertices, target.vertexCount, static_cast<std::size_t>(allocation.baseVertex), vertexCount);
+    releaseRange(target.freeIndices, target.indexCount, allocation.firstIndex, indexCount);
+    stats.vertexBytes -= vertexCount * Mesh::VertexStride(format);
+    stats.indexBytes -= indexCount * sizeof(unsigned int);
+}
+
+GLuint GeometryPool::GetVertexArray(VertexFormat format) const noexcept
+{
+    return arenas[static_cast<int>(format)].vertexArray;
+}
+
+void GeometryPool::AttachInstances(VertexFormat format, InstanceBatch const &batch, std::size_t first)
+{
+    Arena &target = arena(format);
+    if (target.instanceSerial == batch.GetSerial() && target.instanceFirst == first)
+        return;
+    batch.Attach(first);
+    target.instanceSerial = batch.GetSerial();
+    target.instanceFirst = first;
+}
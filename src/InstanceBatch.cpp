@@ -0,0 +1,45 @@
+#include "InstanceBatch.h"
+#include "GLState.h"
+
+#include <cstddef>
+
+namespace
+{
+    std::uint64_t nextSerial = 1;
+}
+
+InstanceBatch::InstanceBatch() : serial(nextSerial++)
+{
+    glGenBuffers(1, &buffer);
+}
+
+InstanceBatch::~InstanceBatch()
+{
+    glDeleteBuffers(1, &buffer);
+    GLState::Instance().DeletedBuffer(buffer);
+}
+
+void InstanceBatch::Update(InstanceData const *instances, std::size_t count_)
+{
+    count = count_;
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(count * sizeof(InstanceData)), instances, GL_DYNAMIC_DRAW);
+}
+
+void InstanceBatch::Attach(std::size_t first) const
+{
+    GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, buffer);
+    std::size_t base = first * sizeof(InstanceData);
+    // mat4 属性按列占四个位置
+    for (GLuint column = 0; column < 4; column++)
+    {
+        GLuint attribute = MODEL_ATTRIBUTE + column;
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void *)(base + offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glEnableVertexAttribArray(MATERIAL_ATTRIBUTE);
+    glVertexAttribIPointer(MATERIAL_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(InstanceData), (void *)(base + offsetof(InstanceData, material)));
+    glVertexAttribDivisor(MATERIAL_ATTRIBUTE, 1);
+}
@@ -0,0 +1,193 @@
+// 实例化绘制的基准: 逐个物体 set_uniform + glDrawArrays 与 InstanceBatch 一次绘制的CPU提交时间,
+// 以及 Model::DrawInstanced 实际走的 Mesh::DrawInstanced (含按LOD分段绘制).
+// 在软件GL上测: LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe ./instancebench
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <GLState.h>
+#include <InstanceBatch.h>
+#include <Mesh.h>
+#include <Shader.h>
+#include <Stopwatch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+    const int SIZE = 64; // 离屏目标很小, GPU的代价不影响CPU侧的计时
+    const int REPEATS = 5;
+
+    // count 个小立方体排成方阵, 都在视野内
+    std::vector<InstanceData> makeInstances(int count)
+    {
+        int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        std::vector<InstanceData> instances(count);
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 position(-1.0f + 2.0f * (i % side + 0.5f) / side, -1.0f + 2.0f * (i / side + 0.5f) / side, 0.0f);
+            instances[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(1.0f / side));
+            instances[i].material = static_cast<std::uint32_t>(i);
+        }
+        return instances;
+    }
+
+    struct Timing
+    {
+        double submitMs; // 发出GL调用的CPU时间
+        double totalMs;  // 包括 glFinish 等待GPU画完
+    };
+
+    // REPEATS 次中提交最快的一次
+    template <typename Submit>
+    Timing measure(Submit submit)
+    {
+        // 第一次包含驱动生成着色器变体和分配缓冲的时间, 不计入
+        submit();
+        glFinish();
+        Timing best{1e30, 1e30};
+        for (int repeat = 0; repeat < REPEATS; repeat++)
+        {
+            Stopwatch watch;
+            submit();
+            double submitMs = watch.ElapsedMs();
+            glFinish();
+            if (submitMs < best.submitMs)
+                best = Timing{submitMs, watch.ElapsedMs()};
+        }
+        return best;
+    }
+}
+
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow *window = glfwCreateWindow(64, 64, "instancebench", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+
+    GLuint framebuffer, colorBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SIZE, SIZE);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glViewport(0, 0, SIZE, SIZE);
+
+    // 与 Lighting 的灯相同的立方体, 只有位置
+    float vertices[] = {
+        -0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,  0.5f,  0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f, -0.5f,  0.5f,
+        -0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f,  0.5f, -0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,  0.5f,
+        -0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f, -0.5f,
+        -0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,  0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f, -0.5f,
+    };
+    GLState &state = GLState::Instance();
+    GLuint cubeVAO, cubeVBO;
+    glGenVertexArrays(1, &cubeVAO);
+    glGenBuffers(1, &cubeVBO);
+    state.BindVertexArray(cubeVAO);
+    state.BindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    {
+        ShaderProgram perObjectShader("..\\..\\shaders\\light_cube.vs", "..\\..\\shaders\\light_cube.fs");
+        ShaderProgram instancedShader("..\\..\\shaders\\light_cube.vs", "..\\..\\shaders\\light_cube.fs", ShaderDefines{{"INSTANCED", "1"}});
+        glm::mat4 identity(1.0f);
+        for (ShaderProgram *shader : {&perObjectShader, &instancedShader})
+        {
+            shader->use();
+            shader->set_uniform("view", 1, GL_FALSE, glm::value_ptr(identity));
+            shader->set_uniform("projection", 1, GL_FALSE, glm::value_ptr(identity));
+        }
+        UniformHandle modelUniform = perObjectShader.get_uniform("model");
+        // 同一个立方体作为 Mesh, 与模型中的网格一样有自己的VAO和索引缓冲
+        std::vector<Vertex> meshVertices(36);
+        std::vector<unsigned int> meshIndices(36);
+        for (unsigned int i = 0; i < 36; i++)
+        {
+            meshVertices[i] = Vertex{};
+            meshVertices[i].Position = glm::vec3(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+            meshIndices[i] = i;
+        }
+        Mesh mesh(meshVertices, meshIndices, {});
+        InstanceBatch batch;
+        batch.Update(nullptr, 0);
+        state.BindVertexArray(cubeVAO); // Mesh 的构造解绑了VAO
+        batch.Attach();
+
+        for (int count : {10, 1000, 10000, 100000})
+        {
+            std::vector<InstanceData> instances = makeInstances(count);
+            // 逐个物体: 每个一次 uniform 和一次绘制
+            Timing perObject = measure([&] {
+                state.BindVertexArray(cubeVAO);
+                perObjectShader.use();
+                for (InstanceData &instance : instances)
+                {
+                    perObjectShader.set_uniform(modelUniform, 1, GL_FALSE, glm::value_ptr(instance.model));
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                }
+            });
+            // 实例化: 整批上传一次, 一次绘制
+            Timing instanced = measure([&] {
+                state.BindVertexArray(cubeVAO);
+                instancedShader.use();
+                batch.Update(instances);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(batch.Count()));
+            });
+            // 其中上传实例数据的部分
+            Timing upload = measure([&] { batch.Update(instances); });
+            // Mesh::DrawInstanced: 材质绑定、VAO和实例属性的状态过滤都在计时内
+            Timing meshInstanced = measure([&] {
+                instancedShader.use();
+                batch.Update(instances);
+                mesh.DrawInstanced(instancedShader, batch);
+            });
+            // 逐实例LOD选出4段时, Model::DrawInstanced 对每个网格画4次, 每次重新指向实例属性
+            Timing meshSegments = measure([&] {
+                instancedShader.use();
+                batch.Update(instances);
+                std::size_t segment = (instances.size() + 3) / 4;
+                for (std::size_t first = 0; first < instances.size(); first += segment)
+                    mesh.DrawInstanced(instancedShader, batch, 0, first, segment);
+            });
+            std::cout << count << " cubes: per-object submit " << perObject.submitMs << " ms (total " << perObject.totalMs
+                      << " ms), instanced submit " << instanced.submitMs << " ms (upload " << upload.submitMs << " ms, total "
+                      << instanced.totalMs << " ms), Mesh::DrawInstanced submit " << meshInstanced.submitMs << " ms, 4 LOD segments "
+                      << meshSegments.submitMs << " ms" << std::endl;
+        }
+    }
+
+    glDeleteVertexArrays(1, &cubeVAO);
+    glDeleteBuffers(1, &cubeVBO);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "LightBuffer.h"
+#include "GLState.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+LightBuffer::LightBuffer()
+{
+    // 两个UBO都以全零的灯光初始化, 之后只写脏区间
+    GLState &state = GLState::Instance();
+    glGenBuffers(2, buffers);
+    for (GLuint buffer : buffers)
+    {
+        state.BindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightsStd140), &lights, GL_DYNAMIC_DRAW);
+    }
+    state.BindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffers[current]);
+}
+
+LightBuffer::~LightBuffer()
+{
+    glDeleteBuffers(2, buffers);
+    for (GLuint buffer : buffers)
+        GLState::Instance().DeletedBuffer(buffer);
+}
+
+void LightBuffer::write(std::size_t offset, const void *data, std::size_t size) noexcept
+{
+    unsigned char *target = reinterpret_cast<unsigned char *>(&lights) + offset;
+    if (std::memcmp(target, data, size) == 0)
+        return;
+    std::memcpy(target, data, size);
+    changed = true;
+    for (DirtyRange &range : dirty)
+    {
+        if (range.begin == range.end)
+            range = DirtyRange{offset, offset + size};
+        else
+        {
+            range.begin = std::min(range.begin, offset);
+            range.end = std::max(range.end, offset + size);
+        }
+    }
+}
+
+void LightBuffer::SetDirLight(DirLight const &light) noexcept
+{
+    DirLightStd140 data{light.direction, 0.0f, light.ambient, 0.0f, light.diffuse, 0.0f, light.specular, 0.0f};
+    write(offsetof(LightsStd140, dirLight), &data, sizeof(data));
+}
+
+void LightBuffer::SetPointLight(int index, PointLight const &light) noexcept
+{
+    if (index < 0 || index >= MAX_POINT_LIGHTS)
+        return;
+    PointLightStd140 data{light.position, light.constant, light.ambient, light.linear,
+                          light.diffuse,  light.quadratic, light.specular, 0.0f};
+    write(offsetof(LightsStd140, pointLights) + sizeof(PointLightStd140) * index, &data, sizeof(data));
+}
+
+void LightBuffer::SetSpotLight(SpotLight const &light) noexcept
+{
+    SpotLightStd140 data{light.position, light.constant,  light.direction, light.linear,  light.ambient,
+                         light.quadratic, light.diffuse, light.cutOff,    light.specular, light.outerCutOff};
+    write(offsetof(LightsStd140, spotLight), &data, sizeof(data));
+}
+
+void LightBuffer::Upload()
+{
+    if (!changed)
+        return;
+    // 当前的UBO可能还在被上一帧的绘制读取, 写进另一个. 它的脏区间包含了自它上次写入以来的所有修改
+    unsigned int next = current ^ 1u;
+    DirtyRange &range = dirty[next];
+    GLState &state = GLState::Instance();
+    state.BindBuffer(GL_UNIFORM_BUFFER, buffers[next]);
+    glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(range.begin), static_cast<GLsizeiptr>(range.end - range.begin),
+                    reinterpret_cast<const unsigned char *>(&lights) + range.begin);
+    state.BindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffers[next]);
+    stats.uploads++;
+    stats.bytes += range.end - range.begin;
+    range = DirtyRange();
+    current = next;
+    changed = false;
+}
+
+bool LightBuffer::Attach(ShaderProgram const &program)
+{
+    GLuint index = glGetUniformBlockIndex(program.get_id(), "Lights");
+    if (index == GL_INVALID_INDEX)
+        return false;
+    GLint size = 0;
+    glGetActiveUniformBlockiv(program.get_id(), index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    if (size != static_cast<GLint>(sizeof(LightsStd140)))
+    {
+        std::cout << "ERROR::LIGHTBUFFER::Lights block is " << size << " bytes, expected " << sizeof(LightsStd140) << std::endl;
+        return false;
+    }
+    glUniformBlockBinding(program.get_id(), index, BINDING);
+    return true;
+}
@@ -1,8 +1,15 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include <Shader.h>
 #include <Camera.h>
+#include <GLState.h>
+#include <TextureManager.h>
+#include <LightBuffer.h>
+#include <InstanceBatch.h>
 #include <stb_image.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -12,7 +19,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow *window, double xposIn, double yposIn);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
-unsigned int loadTexture(char const * path);
+TextureHandle loadTexture(char const * path);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -30,6 +37,7 @@ float lastFrame = 0.0f; // 上一帧的时间
 
 //lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
+bool useFlashlight = true; // F 键开关手电筒
 
 int main()
 {
@@ -57,10 +65,12 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-    glEnable(GL_DEPTH_TEST);
+    GLState &state = GLState::Instance();
+    state.Enable(GL_DEPTH_TEST);
 
-    ShaderProgram lightingShader("..\\..\\shaders\\materials.vs", "..\\..\\shaders\\materials.fs");
-    ShaderProgram lightCubeShader("..\\..\\shaders\\light_cube.vs", "..\\..\\shaders\\light_cube.fs");
+    // 按场景实际使用的灯光特化的 materials 程序. 箱子和灯都是静止的, 以实例化绘制, 模型矩阵在实例缓冲中
+    ShaderPermutations lightingShaders("..\\..\\shaders\\materials.vs", "..\\..\\shaders\\materials.fs");
+    ShaderProgram lightCubeShader("..\\..\\shaders\\light_cube.vs", "..\\..\\shaders\\light_cube.fs", ShaderDefines{{"INSTANCED", "1"}});
 
     float vertices[] = {
         // positions          // normals           // texture coords
@@ -129,10 +139,10 @@ int main()
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &VBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    state.BindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindVertexArray(cubeVAO);
+    state.BindVertexArray(cubeVAO);
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
@@ -145,23 +155,105 @@ int main()
     // second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
     unsigned int lightCubeVAO;
     glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
+    state.BindVertexArray(lightCubeVAO);
 
     // we only need to bind to the VBO (to link it with glVertexAttribPointer), no need to fill it; the VBO's data already contains all we need (it's already bound, but we do it again for educational purposes)
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    state.BindBuffer(GL_ARRAY_BUFFER, VBO);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
 
+    // 每个箱子和灯的模型矩阵, 场景不变, 只上传一次
+    std::vector<InstanceData> cubeInstances(10), lightInstances(4);
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, cubePositions[i]);
+        float angle = 20.0f * i;
+        cubeInstances[i].model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+    }
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, pointLightPositions[i]);
+        lightInstances[i].model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
+    }
+    auto cubeBatch = std::make_unique<InstanceBatch>();
+    auto lightBatch = std::make_unique<InstanceBatch>();
+    cubeBatch->Update(cubeInstances);
+    lightBatch->Update(lightInstances);
+    state.BindVertexArray(cubeVAO);
+    cubeBatch->Attach();
+    state.BindVertexArray(lightCubeVAO);
+    lightBatch->Attach();
+
     // Load textures
-    unsigned int diffuseMap = loadTexture("..\\..\\images\\container2.png");
-    unsigned int specularMap = loadTexture("..\\..\\images\\container2_specular.png");
+    TextureHandle diffuseMap = loadTexture("..\\..\\images\\container2.png");
+    TextureHandle specularMap = loadTexture("..\\..\\images\\container2_specular.png");
     // unsigned int emissionMap = loadTexture("..\\..\\images\\matrix.jpg");
     
-    lightingShader.use();
-    lightingShader.set_uniform("material.diffuse", 0);
-    lightingShader.set_uniform("material.specular", 1);
-    // lightingShader.set_uniform("material.emission", 2);
+    // 手电筒(聚光)开和关各用一个排列, 关掉时片段着色器里没有聚光的计算. 每帧设置的uniform先解析成句柄
+    struct LightingVariant
+    {
+        ShaderProgram *shader;
+        UniformHandle viewPos, view, projection;
+    };
+    LightingVariant lightingVariants[2];
+    for (int spot = 0; spot < 2; spot++)
+    {
+        ShaderProgram &lightingShader = lightingShaders.get({{"NR_POINT_LIGHTS", std::to_string(LightBuffer::MAX_POINT_LIGHTS)},
+                                                             {"SPOT_LIGHT", std::to_string(spot)},
+                                                             {"INSTANCED", "1"}});
+        lightingShader.use();
+        lightingShader.set_uniform("material.diffuse", 0);
+        lightingShader.set_uniform("material.specular", 1);
+        // lightingShader.set_uniform("material.emission", 2);
+        //lightingShader.set_uniform("material.ambient", 1.0f, 0.5f, 0.31f);
+        //lightingShader.set_uniform("material.diffuse", 1.0f, 0.5f, 0.31f);
+        // lightingShader.set_uniform("material.specular", 0.5f, 0.5f, 0.5f);
+        lightingShader.set_uniform("material.shininess", 32.0f);
+        // 灯光在所有程序共享的 uniform块 Lights 中
+        LightBuffer::Attach(lightingShader);
+        lightingVariants[spot] = LightingVariant{&lightingShader, lightingShader.get_uniform("viewPos"), lightingShader.get_uniform("view"),
+                                                 lightingShader.get_uniform("projection")};
+    }
+
+    // 灯光在所有程序共享的 uniform块 Lights 中, 只有修改过的部分会上传
+    auto lights = std::make_unique<LightBuffer>();
+    // directional light
+    DirLight dirLight;
+    dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    dirLight.ambient = glm::vec3(0.05f);
+    dirLight.diffuse = glm::vec3(0.4f);
+    dirLight.specular = glm::vec3(0.5f);
+    lights->SetDirLight(dirLight);
+    // point lights
+    for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+    {
+        PointLight light;
+        light.position = pointLightPositions[i];
+        light.ambient = glm::vec3(0.05f);
+        light.diffuse = glm::vec3(0.8f);
+        light.specular = glm::vec3(1.0f);
+        light.constant = 1.0f;
+        light.linear = 0.09f;
+        light.quadratic = 0.032f;
+        lights->SetPointLight(i, light);
+    }
+    // spotLight, 位置和方向跟随相机, 每帧更新
+    SpotLight spotLight;
+    spotLight.ambient = glm::vec3(0.0f);
+    spotLight.diffuse = glm::vec3(1.0f);
+    spotLight.specular = glm::vec3(1.0f);
+    spotLight.constant = 1.0f;
+    spotLight.linear = 0.09f;
+    spotLight.quadratic = 0.032f;
+    spotLight.cutOff = glm::cos(glm::radians(12.5f));
+    spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+    // 每帧设置的uniform, 先解析成句柄
+    UniformHandle cubeViewUniform = lightCubeShader.get_uniform("view");
+    UniformHandle cubeProjectionUniform = lightCubeShader.get_uniform("projection");
 
     while (!glfwWindowShouldClose(window)) // GLFW退出前一直运行
     {
@@ -176,61 +268,14 @@ int main()
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        LightingVariant const &lighting = lightingVariants[useFlashlight ? 1 : 0];
+        ShaderProgram &lightingShader = *lighting.shader;
         lightingShader.use();
-        lightingShader.set_uniform("viewPos", camera.GetPosition().x, camera.GetPosition().y, camera.GetPosition().z);
-        //lightingShader.set_uniform("material.ambient", 1.0f, 0.5f, 0.31f);
-        //lightingShader.set_uniform("material.diffuse", 1.0f, 0.5f, 0.31f);
-        // lightingShader.set_uniform("material.specular", 0.5f, 0.5f, 0.5f);
-        lightingShader.set_uniform("material.shininess", 32.0f);
-         
-        // directional light
-        lightingShader.set_uniform("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.set_uniform("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.set_uniform("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        lightingShader.set_uniform("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // point light 1
-        lightingShader.set_uniform("pointLights[0].position", pointLightPositions[0].x, pointLightPositions[0].y, pointLightPositions[0].z);
-        lightingShader.set_uniform("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.set_uniform("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.set_uniform("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.set_uniform("pointLights[0].constant", 1.0f);
-        lightingShader.set_uniform("pointLights[0].linear", 0.09f);
-        lightingShader.set_uniform("pointLights[0].quadratic", 0.032f);
-        // point light 2
-        lightingShader.set_uniform("pointLights[1].position", pointLightPositions[1].x, pointLightPositions[1].y, pointLightPositions[1].z);
-        lightingShader.set_uniform("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.set_uniform("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.set_uniform("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.set_uniform("pointLights[1].constant", 1.0f);
-        lightingShader.set_uniform("pointLights[1].linear", 0.09f);
-        lightingShader.set_uniform("pointLights[1].quadratic", 0.032f);
-        // point light 3
-        lightingShader.set_uniform("pointLights[2].position", pointLightPositions[2].x, pointLightPositions[2].y, pointLightPositions[2].z);
-        lightingShader.set_uniform("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.set_uniform("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.set_uniform("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.set_uniform("pointLights[2].constant", 1.0f);
-        lightingShader.set_uniform("pointLights[2].linear", 0.09f);
-        lightingShader.set_uniform("pointLights[2].quadratic", 0.032f);
-        // point light 4
-        lightingShader.set_uniform("pointLights[3].position", pointLightPositions[3].x, pointLightPositions[3].y, pointLightPositions[3].z);
-        lightingShader.set_uniform("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.set_uniform("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.set_uniform("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.set_uniform("pointLights[3].constant", 1.0f);
-        lightingShader.set_uniform("pointLights[3].linear", 0.09f);
-        lightingShader.set_uniform("pointLights[3].quadratic", 0.032f);
-        // spotLight
-        lightingShader.set_uniform("spotLight.position", camera.GetPosition().x, camera.GetPosition().y, camera.GetPosition().z);
-        lightingShader.set_uniform("spotLight.direction",camera.GetFront().x, camera.GetFront().y, camera.GetFront().z);
-        lightingShader.set_uniform("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.set_uniform("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        lightingShader.set_uniform("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.set_uniform("spotLight.constant", 1.0f);
-        lightingShader.set_uniform("spotLight.linear", 0.09f);
-        lightingShader.set_uniform("spotLight.quadratic", 0.032f);
-        lightingShader.set_uniform("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        lightingShader.set_uniform("spotLight.outerCutOff", glm::cos(glm::radians(15.0f))); 
+        lightingShader.set_uniform(lighting.viewPos, camera.GetPosition().x, camera.GetPosition().y, camera.GetPosition().z);
+        spotLight.position = camera.GetPosition();
+        spotLight.direction = camera.GetFront();
+        lights->SetSpotLight(spotLight);
+        lights->Upload();
 
 
 /*光线可变
@@ -247,19 +292,12 @@ int main()
         
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.GetZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        lightingShader.set_uniform("view", 1, GL_FALSE, glm::value_ptr(view));
-        lightingShader.set_uniform("projection", 1, GL_FALSE, glm::value_ptr(projection));
-
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        lightingShader.set_uniform("model", 1, GL_FALSE, glm::value_ptr(model));
+        lightingShader.set_uniform(lighting.view, 1, GL_FALSE, glm::value_ptr(view));
+        lightingShader.set_uniform(lighting.projection, 1, GL_FALSE, glm::value_ptr(projection));
 
-        //bind diffuse map
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
+        //bind diffuse map, 每帧都相同, 第一帧之后由 TextureManager 跳过
+        TextureManager::Instance().Bind(0, *diffuseMap);
+        TextureManager::Instance().Bind(1, *specularMap);
 /*emission
         float mLight = static_cast<float>(1.5 + sin(glfwGetTime()));
         float mMove = static_cast<float>(glfwGetTime());
@@ -268,34 +306,16 @@ int main()
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, emissionMap);
 */
-        // render the cube
-        glBindVertexArray(cubeVAO);
-        //glDrawArrays(GL_TRIANGLES, 0, 36);
-        for (unsigned int i = 0; i < 10; i++)
-        {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            lightingShader.set_uniform("model", 1, GL_FALSE, glm::value_ptr(model));
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        // render the cubes, 一次绘制画出所有箱子
+        state.BindVertexArray(cubeVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(cubeBatch->Count()));
 //lightcube
         // also draw the lamp object
         lightCubeShader.use();
-        lightCubeShader.set_uniform("view", 1, GL_FALSE, glm::value_ptr(view));
-        lightCubeShader.set_uniform("projection", 1, GL_FALSE, glm::value_ptr(projection));
-        glBindVertexArray(lightCubeVAO);
-        for(unsigned int i = 0; i < 4; i++){
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
-            lightCubeShader.set_uniform("model", 1, GL_FALSE, glm::value_ptr(model));
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        } 
+        lightCubeShader.set_uniform(cubeViewUniform, 1, GL_FALSE, glm::value_ptr(view));
+        lightCubeShader.set_uniform(cubeProjectionUniform, 1, GL_FALSE, glm::value_ptr(projection));
+        state.BindVertexArray(lightCubeVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(lightBatch->Count()));
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -304,6 +324,14 @@ int main()
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteBuffers(1, &VBO);
+    state.DeletedVertexArray(cubeVAO);
+    state.DeletedVertexArray(lightCubeVAO);
+    state.DeletedBuffer(VBO);
+    cubeBatch.reset();
+    lightBatch.reset();
+    diffuseMap.reset();
+    specularMap.reset();
+    lights.reset();
 
     //释放/删除之前的分配的所有资源
     glfwTerminate();
@@ -329,6 +357,12 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+    // 只在按下的那一帧切换
+    static bool flashlightKeyDown = false;
+    bool flashlightKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (flashlightKey && !flashlightKeyDown)
+        useFlashlight = !useFlashlight;
+    flashlightKeyDown = flashlightKey;
 }
 
 //监听鼠标移动事件
@@ -358,39 +392,8 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-unsigned int loadTexture(char const * path)
+// 与模型纹理共用进程内的纹理缓存, 句柄释放后纹理随之删除
+TextureHandle loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
\ No newline at end of file
+    return TextureManager::Instance().Load(path);
+}
@@ -0,0 +1,63 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+MappedFile::MappedFile(std::string const &path)
+    : data_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+{
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+        return;
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_)
+        return;
+    data_ = static_cast<const unsigned char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_)
+        size_ = static_cast<std::size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(std::string const &path)
+    : data_(nullptr), size_(0), fd_(-1)
+{
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        return;
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0)
+        return;
+    void *ptr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (ptr == MAP_FAILED)
+        return;
+    data_ = static_cast<const unsigned char *>(ptr);
+    size_ = static_cast<std::size_t>(st.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        munmap(const_cast<unsigned char *>(data_), size_);
+    if (fd_ >= 0)
+        close(fd_);
+}
+#endif
@@ -1,19 +1,228 @@
 #include "Mesh.h"
+#include "GLState.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex layout");
+static_assert(sizeof(PackedSkinnedVertex) == 24, "PackedSkinnedVertex layout");
+
+namespace
+{
+    // 八面体法线编码, 结果在[-1,1]^2
+    glm::vec2 octEncode(glm::vec3 n)
+    {
+        float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (sum == 0.0f)
+            return glm::vec2(0.0f);
+        n /= sum;
+        glm::vec2 p(n.x, n.y);
+        if (n.z < 0.0f)
+        {
+            p.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            p.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return p;
+    }
+
+    std::uint16_t quantizeUnorm16(float value, float min, float extent)
+    {
+        if (extent <= 0.0f)
+            return 0;
+        float t = glm::clamp((value - min) / extent, 0.0f, 1.0f);
+        return static_cast<std::uint16_t>(t * 65535.0f + 0.5f);
+    }
+
+    template <class PackedT>
+    void packCommon(PackedT &out, Vertex const &v, glm::vec3 const &boundsMin, glm::vec3 const &boundsExtent)
+    {
+        for (int k = 0; k < 3; k++)
+            out.Position[k] = quantizeUnorm16(v.Position[k], boundsMin[k], boundsExtent[k]);
+        out.Padding = 0;
+        out.Normal = glm::packSnorm2x16(octEncode(v.Normal));
+        out.TexCoords = glm::packHalf2x16(v.TexCoords);
+    }
+
+    // 在用的材质号. 网格以 shared_ptr 持有自己的材质号, 最后一个持有者释放时登记项删除, 号码回收
+    struct MaterialRegistry
+    {
+        std::map<std::vector<std::uint64_t>, std::weak_ptr<const std::uint32_t>> keys;
+        std::vector<std::uint32_t> freeKeys;
+        std::uint32_t nextKey = 0;
+    };
+
+    MaterialRegistry &materialRegistry()
+    {
+        static MaterialRegistry registry;
+        return registry;
+    }
+
+    // 纹理对象、层号、类型、顶点格式和面剔除都相同的网格共用一个材质号. 纹理以对象地址区分:
+    // 网格持有纹理句柄, 所以登记项存在期间地址不会被新的纹理复用
+    std::shared_ptr<const std::uint32_t> materialKeyOf(VertexFormat format, bool cullBackFaces, std::vector<Texture> const &textures)
+    {
+        std::vector<std::uint64_t> material{static_cast<std::uint64_t>(format), cullBackFaces};
+        for (auto const &texture : textures)
+        {
+            material.push_back(texture.handle ? reinterpret_cast<std::uintptr_t>(texture.handle.get()) : texture.id);
+            material.push_back(static_cast<std::uint32_t>(texture.layer));
+            material.push_back(std::hash<std::string>()(texture.type));
+        }
+        MaterialRegistry &registry = materialRegistry();
+        std::weak_ptr<const std::uint32_t> &slot = registry.keys[material];
+        if (std::shared_ptr<const std::uint32_t> key = slot.lock())
+            return key;
+        std::uint32_t value = registry.nextKey;
+        if (registry.freeKeys.empty())
+            registry.nextKey++;
+        else
+        {
+            value = registry.freeKeys.back();
+            registry.freeKeys.pop_back();
+        }
+        std::shared_ptr<const std::uint32_t> key(new std::uint32_t(value), [material](const std::uint32_t *key) {
+            MaterialRegistry &registry = materialRegistry();
+            auto it = registry.keys.find(material);
+            if (it != registry.keys.end() && it->second.expired())
+                registry.keys.erase(it);
+            registry.freeKeys.push_back(*key);
+            delete key;
+        });
+        slot = key;
+        return key;
+    }
+}
+
+std::vector<unsigned char> Mesh::packVertices() const
+{
+    std::vector<unsigned char> bytes;
+    if (format == VertexFormat::Packed)
+    {
+        bytes.resize(vertices.size() * sizeof(PackedVertex));
+        auto *out = reinterpret_cast<PackedVertex *>(bytes.data());
+        for (std::size_t i = 0; i < vertices.size(); i++)
+            packCommon(out[i], vertices[i], boundsMin, boundsExtent);
+    }
+    else if (format == VertexFormat::PackedSkinned)
+    {
+        bytes.resize(vertices.size() * sizeof(PackedSkinnedVertex));
+        auto *out = reinterpret_cast<PackedSkinnedVertex *>(bytes.data());
+        for (std::size_t i = 0; i < vertices.size(); i++)
+        {
+            packCommon(out[i], vertices[i], boundsMin, boundsExtent);
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            {
+                out[i].BoneIDs[k] = static_cast<std::uint8_t>(glm::clamp(vertices[i].m_BoneIDs[k], 0, 255));
+                out[i].Weights[k] = static_cast<std::uint8_t>(glm::clamp(vertices[i].m_Weights[k], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+    return bytes;
+}
+
+std::size_t Mesh::VertexStride(VertexFormat format) noexcept
+{
+    switch (format)
+    {
+    case VertexFormat::Packed:
+        return sizeof(PackedVertex);
+    case VertexFormat::PackedSkinned:
+        return sizeof(PackedSkinnedVertex);
+    default:
+        return sizeof(Vertex);
+    }
+}
+
+std::size_t Mesh::VertexBufferBytes() const noexcept
+{
+    return vertices.size() * VertexStride(format);
+}
+
+void Mesh::ReleaseGeometry() noexcept
+{
+    if (pooled)
+        GeometryPool::Instance().Free(format, GeometryPool::Allocation{baseVertex, firstIndex}, vertices.size(), indices.size());
+    else if (VAO != 0)
+    {
+        GLState &state = GLState::Instance();
+        glDeleteVertexArrays(1, &VAO);
+        state.DeletedVertexArray(VAO);
+        glDeleteBuffers(1, &VBO);
+        state.DeletedBuffer(VBO);
+        glDeleteBuffers(1, &EBO);
+        state.DeletedBuffer(EBO);
+    }
+    VAO = VBO = EBO = 0;
+    pooled = false;
+}
 
 void Mesh::setupMesh() noexcept
 {
+    // 压缩格式: 全部用归一化的整数/半精度属性, 着色器中用 boundsMin/boundsExtent 还原位置
+    std::vector<unsigned char> packed;
+    const void *vertexData = vertices.data();
+    if (format != VertexFormat::Float)
+    {
+        packed = packVertices();
+        vertexData = packed.data();
+    }
+    if (pooled)
+    {
+        GeometryPool &pool = GeometryPool::Instance();
+        GeometryPool::Allocation allocation = pool.Allocate(format, vertexData, vertices.size(), indices.data(), indices.size());
+        baseVertex = allocation.baseVertex;
+        firstIndex = allocation.firstIndex;
+        VAO = pool.GetVertexArray(format);
+        VBO = EBO = 0;
+        return;
+    }
+
     // create buffers/arrays
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    GLState &state = GLState::Instance();
+    state.BindVertexArray(VAO);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
     // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    state.BindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, VertexBufferBytes(), vertexData, GL_STATIC_DRAW);
+    SetupVertexAttributes(format);
+    state.BindVertexArray(0);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+void Mesh::SetupVertexAttributes(VertexFormat format) noexcept
+{
+    if (format != VertexFormat::Float)
+    {
+        GLsizei stride = static_cast<GLsizei>(VertexStride(format));
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)offsetof(PackedVertex, Position));
+        // vertex normals (octahedron)
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *)offsetof(PackedVertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, TexCoords));
+        if (format == VertexFormat::PackedSkinned)
+        {
+            // ids
+            glEnableVertexAttribArray(3);
+            glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, stride, (void *)offsetof(PackedSkinnedVertex, BoneIDs));
+            // weights
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(PackedSkinnedVertex, Weights));
+        }
+        return;
+    }
 
     // set the vertex attribute pointers
     // vertex Positions
@@ -37,27 +246,228 @@ void Mesh::setupMesh() noexcept
     // weights
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
 }
 
-Mesh::Mesh(std::vector<Vertex> vertices_, std::vector<unsigned int> indices_, std::vector<Texture> textures_)
+Mesh::Mesh(std::vector<Vertex> vertices_, std::vector<unsigned int> indices_, std::vector<Texture> textures_, VertexFormat format_,
+           std::vector<MeshLod> lods_, std::vector<Meshlet> meshlets_, bool pooled_, bool cullBackFaces_)
 {
-    this->vertices = vertices_;
-    this->indices = indices_;
-    this->textures = textures_;
+    this->pooled = pooled_;
+    this->cullBackFaces = cullBackFaces_;
+    this->vertices = std::move(vertices_);
+    this->indices = std::move(indices_);
+    this->textures = std::move(textures_);
+    this->format = format_;
+    this->lods = std::move(lods_);
+    this->meshlets = std::move(meshlets_);
+    if (lods.empty())
+        lods.push_back(MeshLod{0, static_cast<unsigned int>(indices.size()), 0.0f});
+    // AABB
+    glm::vec3 boundsMax(0.0f);
+    boundsMin = glm::vec3(0.0f);
+    if (!vertices.empty())
+    {
+        boundsMin = boundsMax = vertices[0].Position;
+        for (auto const &vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.Position);
+            boundsMax = glm::max(boundsMax, vertex.Position);
+        }
+    }
+    boundsExtent = boundsMax - boundsMin;
+    // 纹理流式加载用的纹素密度
+    double surfaceArea = 0.0, uvArea = 0.0;
+    for (unsigned int i = lods[0].indexOffset; i + 2 < lods[0].indexOffset + lods[0].indexCount; i += 3)
+    {
+        Vertex const &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+        surfaceArea += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+        glm::vec2 u = b.TexCoords - a.TexCoords, v = c.TexCoords - a.TexCoords;
+        uvArea += std::abs(u.x * v.y - u.y * v.x);
+    }
+    uvDensity = surfaceArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / surfaceArea)) : 0.0f;
+    materialKey = materialKeyOf(format, cullBackFaces, textures);
     setupMesh();
 }
 
-void Mesh::Draw(ShaderProgram &shader) noexcept
+void Mesh::RequestTextureMips(float pixelsPerUnit) const noexcept
+{
+    for (auto const &texture : textures)
+    {
+        int level = 0;
+        if (pixelsPerUnit > 0.0f && texture.handle)
+        {
+            // 每个屏幕像素覆盖的纹素数的 log2
+            float texelsPerUnit = uvDensity * static_cast<float>(std::max(texture.handle->width, texture.handle->height));
+            level = static_cast<int>(std::floor(std::log2(std::max(texelsPerUnit / pixelsPerUnit, 1.0f))));
+        }
+        TextureManager::Instance().RequestMip(texture.handle, level);
+    }
+}
+
+void Mesh::Draw(ShaderProgram &shader, unsigned int lod) noexcept
 {
+    bindMaterial(shader);
+
+    // draw mesh, VAO 保持绑定, 下一次绘制同一网格时不用重新绑定
+    GLState::Instance().BindVertexArray(VAO);
+    MeshLod const &range = lods[std::min<std::size_t>(lod, lods.size() - 1)];
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, indexPointer(range.indexOffset), baseVertex);
+    renderStats.drawCalls++;
+    renderStats.triangles += range.indexCount / 3;
+}
+
+void Mesh::DrawClusters(ShaderProgram &shader, Frustum const &frustum, glm::vec3 const &cameraPosition) noexcept
+{
+    if (meshlets.empty())
+    {
+        Draw(shader, 0);
+        return;
+    }
+
+    // 收集可见簇, 相邻的可见簇合并成一个区间
+    drawCounts.clear();
+    drawOffsets.clear();
+    std::size_t triangles = 0;
+    unsigned int rangeEnd = ~0u;
+    for (auto const &meshlet : meshlets)
+    {
+        renderStats.clustersTested++;
+        if (!frustum.IntersectsSphere(meshlet.center, meshlet.radius))
+        {
+            renderStats.clustersFrustumCulled++;
+            continue;
+        }
+        glm::vec3 view = meshlet.center - cameraPosition;
+        if (cullBackFaces && glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius)
+        {
+            renderStats.clustersBackfaceCulled++;
+            continue;
+        }
+        GLsizei count = static_cast<GLsizei>(meshlet.triangleCount * 3);
+        if (meshlet.indexOffset == rangeEnd)
+            drawCounts.back() += count;
+        else
+        {
+            drawCounts.push_back(count);
+            drawOffsets.push_back(indexPointer(meshlet.indexOffset));
+        }
+        rangeEnd = meshlet.indexOffset + meshlet.triangleCount * 3;
+        triangles += meshlet.triangleCount;
+    }
+    if (drawCounts.empty())
+        return;
+
+    bindMaterial(shader);
+    GLState::Instance().BindVertexArray(VAO);
+    drawBaseVertices.assign(drawCounts.size(), baseVertex);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                  static_cast<GLsizei>(drawCounts.size()), drawBaseVertices.data());
+    renderStats.drawCalls++;
+    renderStats.triangles += triangles;
+}
+
+void Mesh::DrawInstanced(ShaderProgram &shader, InstanceBatch const &batch, unsigned int lod, std::size_t first,
+                         std::size_t count) noexcept
+{
+    if (first >= batch.Count())
+        return;
+    count = std::min(count, batch.Count() - first);
+    bindMaterial(shader);
+
+    GLState::Instance().BindVertexArray(VAO);
+    // 没有 baseInstance (GL 4.2), 从第 first 个实例起画时把实例属性指向那里
+    AttachInstances(batch, first);
+    MeshLod const &range = lods[std::min<std::size_t>(lod, lods.size() - 1)];
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, indexPointer(range.indexOffset),
+                                      static_cast<GLsizei>(count), baseVertex);
+    renderStats.drawCalls++;
+    renderStats.triangles += range.indexCount / 3 * count;
+}
+
+void Mesh::AttachInstances(InstanceBatch const &batch, std::size_t first) noexcept
+{
+    // 实例属性是VAO的状态, 换批次时才重新设置; 池中的网格共享VAO, 由 GeometryPool 记录
+    if (pooled)
+    {
+        GeometryPool::Instance().AttachInstances(format, batch, first);
+        return;
+    }
+    if (instanceSerial != batch.GetSerial() || instanceFirst != first)
+    {
+        batch.Attach(first);
+        instanceSerial = batch.GetSerial();
+        instanceFirst = first;
+    }
+}
+
+DrawElementsIndirectCommand Mesh::GetDrawCommand(unsigned int lod) const noexcept
+{
+    MeshLod const &range = lods[std::min<std::size_t>(lod, lods.size() - 1)];
+    return DrawElementsIndirectCommand{range.indexCount, 1, firstIndex + range.indexOffset, baseVertex, 0};
+}
+
+glm::mat4 Mesh::GetDequantizeMatrix() const noexcept
+{
+    if (format == VertexFormat::Float)
+        return glm::mat4(1.0f);
+    return glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), boundsExtent);
+}
+
+void Mesh::BindMultiDraw(ShaderProgram &shader) noexcept
+{
+    bindMaterial(shader);
+    // 位置的反量化已并入每次绘制的模型矩阵
+    if (shader.is_ready())
+        shader.set_uniform(uniforms.packedVertex, false);
+    GLState::Instance().BindVertexArray(VAO);
+}
+
+void Mesh::bindMaterial(ShaderProgram &shader) noexcept
+{
+    // 异步构建中的程序画的是占位程序, 不需要材质; 也不在这里等它编译完
+    if (!shader.is_ready())
+        return;
+    if (uniforms.program != shader.get_id())
+        resolveUniforms(shader);
+    // 丢掉背面簇的网格也要让GL剔除剩下簇里的背面, 否则画面取决于簇的划分
+    if (cullBackFaces)
+        GLState::Instance().Enable(GL_CULL_FACE);
+    else
+        GLState::Instance().Disable(GL_CULL_FACE);
+
     // bind appropriate textures
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        // 载入失败的纹理没有句柄, 跳过, 采样器保持默认的单元
+        if (!textures[i].handle)
+            continue;
+        // now set the sampler to the correct texture unit; 数组版本的采样器是 <name>_array, 层号 <name>_layer (-1 表示二维纹理)
+        bool array = textures[i].handle->target == GL_TEXTURE_2D_ARRAY;
+        shader.set_uniform(uniforms.samplers[i], (int)i);
+        shader.set_uniform(uniforms.arraySamplers[i], (int)(ARRAY_UNIT_BASE + i));
+        shader.set_uniform(uniforms.layers[i], array ? textures[i].layer : -1);
+        // and finally bind the texture, 与上次绑定相同时由 TextureManager 跳过
+        TextureManager::Instance().Bind(array ? ARRAY_UNIT_BASE + i : i, *textures[i].handle);
+    }
+
+    // 压缩顶点的位置需要在着色器中反量化
+    shader.set_uniform(uniforms.packedVertex, format != VertexFormat::Float);
+    if (format != VertexFormat::Float)
+    {
+        shader.set_uniform(uniforms.boundsMin, boundsMin.x, boundsMin.y, boundsMin.z);
+        shader.set_uniform(uniforms.boundsExtent, boundsExtent.x, boundsExtent.y, boundsExtent.z);
+    }
+}
+
+void Mesh::resolveUniforms(ShaderProgram &shader)
+{
+    uniforms = MaterialUniforms();
+    uniforms.program = shader.get_id();
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
         // retrieve texture number (the N in diffuse_textureN)
         std::string number;
         std::string name = textures[i].type;
@@ -69,18 +479,11 @@ void Mesh::Draw(ShaderProgram &shader) noexcept
             number = std::to_string(normalNr++); // transfer unsigned int to string
         else if (name == "texture_height")
             number = std::to_string(heightNr++); // transfer unsigned int to string
-
-        // now set the sampler to the correct texture unit
-        shader.set_uniform((name + number).c_str(), (int)i);
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        uniforms.samplers.push_back(shader.get_uniform(name + number));
+        uniforms.arraySamplers.push_back(shader.get_uniform(name + number + "_array"));
+        uniforms.layers.push_back(shader.get_uniform(name + number + "_layer"));
     }
-
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+    uniforms.packedVertex = shader.get_uniform("packedVertex");
+    uniforms.boundsMin = shader.get_uniform("boundsMin");
+    uniforms.boundsExtent = shader.get_uniform("boundsExtent");
 }
\ No newline at end of file
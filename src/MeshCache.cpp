@@ -0,0 +1,260 @@
+#include "MeshCache.h"
+#include "CacheFile.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<Vertex>, "Vertex is written to the mesh cache as raw bytes");
+static_assert(std::is_trivially_copyable_v<MeshLod>, "MeshLod is written to the mesh cache as raw bytes");
+static_assert(std::is_trivially_copyable_v<Meshlet>, "Meshlet is written to the mesh cache as raw bytes");
+
+namespace
+{
+    constexpr char MAGIC[4] = {'L', 'G', 'M', 'C'};
+    constexpr std::uint32_t MESH_SKINNED = 0x1;
+
+    struct CacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t vertexSize; // sizeof(Vertex), invalidates the cache when the layout changes
+        std::uint32_t importFlags;
+        std::int64_t sourceMTime;
+        std::uint64_t sourceSize;
+        std::uint32_t pathLength;
+        std::uint32_t meshCount;
+        std::uint32_t materialCount;
+        std::uint32_t reserved;
+    };
+
+    struct MeshRecord
+    {
+        std::uint32_t materialIndex;
+        std::uint32_t vertexCount;
+        std::uint32_t indexCount;
+        std::uint32_t flags; // MESH_SKINNED
+        std::uint64_t vertexOffset; // byte offsets from the start of the file, 16-byte aligned
+        std::uint64_t indexOffset;
+        std::uint64_t lodOffset; // MeshLod table, lodCount entries (0 = no LOD chain)
+        std::uint64_t meshletOffset; // Meshlet table, meshletCount entries
+        std::uint32_t lodCount;
+        std::uint32_t meshletCount;
+    };
+
+    constexpr std::size_t align16(std::size_t n) { return (n + 15) & ~static_cast<std::size_t>(15); }
+
+    // 源文件的键值 identity of the source file at the time of import
+    bool sourceKey(std::string const &sourcePath, std::string &absPath, std::int64_t &mtime, std::uint64_t &size)
+    {
+        std::error_code ec;
+        auto abs = std::filesystem::absolute(sourcePath, ec);
+        if (ec || !CacheFile::SourceKey(abs.string(), mtime, size))
+            return false;
+        absPath = abs.lexically_normal().string();
+        return true;
+    }
+
+    // bounds-checked cursor over the mapped cache file
+    struct Reader
+    {
+        const unsigned char *data;
+        std::size_t size;
+        std::size_t pos;
+
+        bool read(void *dst, std::size_t n)
+        {
+            if (n > size - pos)
+                return false;
+            std::memcpy(dst, data + pos, n);
+            pos += n;
+            return true;
+        }
+        bool readString(std::string &str)
+        {
+            std::uint32_t length;
+            if (!read(&length, sizeof(length)) || length > size - pos)
+                return false;
+            str.assign(reinterpret_cast<const char *>(data + pos), length);
+            pos += length;
+            return true;
+        }
+    };
+
+    void writeString(std::ofstream &out, std::string const &str)
+    {
+        std::uint32_t length = static_cast<std::uint32_t>(str.size());
+        out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+        out.write(str.data(), length);
+    }
+
+    void padTo(std::ofstream &out, std::size_t offset)
+    {
+        static const char zeros[16] = {};
+        std::size_t pos = static_cast<std::size_t>(out.tellp());
+        if (offset > pos)
+            out.write(zeros, static_cast<std::streamsize>(offset - pos));
+    }
+}
+
+std::string MeshCache::CachePath(std::string const &sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+bool MeshCache::Load(std::string const &sourcePath, unsigned int importFlags,
+                     std::vector<MeshData> &meshes, std::vector<MaterialData> &materials)
+{
+    std::string absPath;
+    std::int64_t mtime;
+    std::uint64_t sourceSize;
+    if (!sourceKey(sourcePath, absPath, mtime, sourceSize))
+        return false;
+
+    MappedFile file(CachePath(sourcePath));
+    if (!file.IsOpen())
+        return false;
+
+    Reader reader{file.Data(), file.Size(), 0};
+    CacheHeader header;
+    if (!CacheFile::CheckMagic(file.Data(), file.Size(), MAGIC, VERSION) || !reader.read(&header, sizeof(header)))
+        return false;
+    if (header.vertexSize != sizeof(Vertex) || header.importFlags != importFlags ||
+        header.sourceMTime != mtime || header.sourceSize != sourceSize)
+        return false;
+
+    std::string cachedPath;
+    if (!reader.readString(cachedPath) || cachedPath.size() != header.pathLength || cachedPath != absPath)
+        return false;
+
+    std::vector<MaterialData> cachedMaterials(header.materialCount);
+    for (auto &material : cachedMaterials)
+    {
+        std::uint32_t textureCount;
+        if (!reader.read(&textureCount, sizeof(textureCount)))
+            return false;
+        for (std::uint32_t i = 0; i < textureCount; i++)
+        {
+            Texture texture{};
+            if (!reader.readString(texture.type) || !reader.readString(texture.path))
+                return false;
+            material.textures.push_back(std::move(texture));
+        }
+    }
+
+    std::vector<MeshData> cachedMeshes(header.meshCount);
+    for (auto &mesh : cachedMeshes)
+    {
+        MeshRecord record;
+        if (!reader.read(&record, sizeof(record)))
+            return false;
+        std::size_t vertexBytes = static_cast<std::size_t>(record.vertexCount) * sizeof(Vertex);
+        std::size_t indexBytes = static_cast<std::size_t>(record.indexCount) * sizeof(unsigned int);
+        std::size_t lodBytes = static_cast<std::size_t>(record.lodCount) * sizeof(MeshLod);
+        std::size_t meshletBytes = static_cast<std::size_t>(record.meshletCount) * sizeof(Meshlet);
+        if (record.vertexOffset > file.Size() || vertexBytes > file.Size() - record.vertexOffset ||
+            record.indexOffset > file.Size() || indexBytes > file.Size() - record.indexOffset ||
+            record.lodOffset > file.Size() || lodBytes > file.Size() - record.lodOffset ||
+            record.meshletOffset > file.Size() || meshletBytes > file.Size() - record.meshletOffset ||
+            record.materialIndex >= header.materialCount)
+            return false;
+        // 直接从映射内存拷贝, 不做解析: 数组的布局就是 Mesh::setupMesh 上传的布局
+        const auto *vertexData = reinterpret_cast<const Vertex *>(file.Data() + record.vertexOffset);
+        const auto *indexData = reinterpret_cast<const unsigned int *>(file.Data() + record.indexOffset);
+        // 下标超出顶点数的记录按未命中处理, 否则绘制时会读到顶点缓冲之外
+        if (std::any_of(indexData, indexData + record.indexCount, [&](unsigned int index) { return index >= record.vertexCount; }))
+            return false;
+        mesh.vertices.assign(vertexData, vertexData + record.vertexCount);
+        mesh.indices.assign(indexData, indexData + record.indexCount);
+        mesh.materialIndex = record.materialIndex;
+        mesh.skinned = (record.flags & MESH_SKINNED) != 0;
+        const auto *lodData = reinterpret_cast<const MeshLod *>(file.Data() + record.lodOffset);
+        mesh.lods.assign(lodData, lodData + record.lodCount);
+        for (auto const &lod : mesh.lods)
+            if (lod.indexOffset > record.indexCount || lod.indexCount > record.indexCount - lod.indexOffset)
+                return false;
+        const auto *meshletData = reinterpret_cast<const Meshlet *>(file.Data() + record.meshletOffset);
+        mesh.meshlets.assign(meshletData, meshletData + record.meshletCount);
+        for (auto const &meshlet : mesh.meshlets)
+            if (meshlet.indexOffset > record.indexCount || meshlet.triangleCount > (record.indexCount - meshlet.indexOffset) / 3)
+                return false;
+    }
+
+    meshes = std::move(cachedMeshes);
+    materials = std::move(cachedMaterials);
+    return true;
+}
+
+bool MeshCache::Save(std::string const &sourcePath, unsigned int importFlags,
+                     std::vector<MeshData> const &meshes, std::vector<MaterialData> const &materials)
+{
+    std::string absPath;
+    std::int64_t mtime;
+    std::uint64_t sourceSize;
+    if (!sourceKey(sourcePath, absPath, mtime, sourceSize))
+        return false;
+
+    return CacheFile::Write(CachePath(sourcePath), "MESHCACHE", [&](std::ofstream &out) {
+        CacheHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.importFlags = importFlags;
+        header.sourceMTime = mtime;
+        header.sourceSize = sourceSize;
+        header.pathLength = static_cast<std::uint32_t>(absPath.size());
+        header.meshCount = static_cast<std::uint32_t>(meshes.size());
+        header.materialCount = static_cast<std::uint32_t>(materials.size());
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        writeString(out, absPath);
+
+        for (auto const &material : materials)
+        {
+            std::uint32_t textureCount = static_cast<std::uint32_t>(material.textures.size());
+            out.write(reinterpret_cast<const char *>(&textureCount), sizeof(textureCount));
+            for (auto const &texture : material.textures)
+            {
+                writeString(out, texture.type);
+                writeString(out, texture.path);
+            }
+        }
+
+        // 先算出数据块偏移 lay out the vertex/index blobs after the record table
+        std::size_t offset = align16(static_cast<std::size_t>(out.tellp()) + meshes.size() * sizeof(MeshRecord));
+        std::vector<MeshRecord> records(meshes.size());
+        for (std::size_t i = 0; i < meshes.size(); i++)
+        {
+            records[i].materialIndex = meshes[i].materialIndex;
+            records[i].vertexCount = static_cast<std::uint32_t>(meshes[i].vertices.size());
+            records[i].indexCount = static_cast<std::uint32_t>(meshes[i].indices.size());
+            records[i].flags = meshes[i].skinned ? MESH_SKINNED : 0;
+            records[i].vertexOffset = offset;
+            offset = align16(offset + meshes[i].vertices.size() * sizeof(Vertex));
+            records[i].indexOffset = offset;
+            offset = align16(offset + meshes[i].indices.size() * sizeof(unsigned int));
+            records[i].lodOffset = offset;
+            records[i].lodCount = static_cast<std::uint32_t>(meshes[i].lods.size());
+            offset = align16(offset + meshes[i].lods.size() * sizeof(MeshLod));
+            records[i].meshletOffset = offset;
+            records[i].meshletCount = static_cast<std::uint32_t>(meshes[i].meshlets.size());
+            offset = align16(offset + meshes[i].meshlets.size() * sizeof(Meshlet));
+        }
+        out.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(MeshRecord)));
+
+        for (std::size_t i = 0; i < meshes.size(); i++)
+        {
+            padTo(out, records[i].vertexOffset);
+            out.write(reinterpret_cast<const char *>(meshes[i].vertices.data()), static_cast<std::streamsize>(meshes[i].vertices.size() * sizeof(Vertex)));
+            padTo(out, records[i].indexOffset);
+            out.write(reinterpret_cast<const char *>(meshes[i].indices.data()), static_cast<std::streamsize>(meshes[i].indices.size() * sizeof(unsigned int)));
+            padTo(out, records[i].lodOffset);
+            out.write(reinterpret_cast<const char *>(meshes[i].lods.data()), static_cast<std::streamsize>(meshes[i].lods.size() * sizeof(MeshLod)));
+            padTo(out, records[i].meshletOffset);
+            out.write(reinterpret_cast<const char *>(meshes[i].meshlets.data()), static_cast<std::streamsize>(meshes[i].meshlets.size() * sizeof(Meshlet)));
+        }
+    });
+}
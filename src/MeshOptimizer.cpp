@@ -0,0 +1,871 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+    struct VertexBytesHash
+    {
+        std::size_t operator()(Vertex const &v) const noexcept
+        {
+            // FNV-1a 逐字节哈希
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+            std::uint64_t h = 1469598103934665603ull;
+            for (std::size_t i = 0; i < sizeof(Vertex); i++)
+                h = (h ^ bytes[i]) * 1099511628211ull;
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    struct VertexBytesEqual
+    {
+        bool operator()(Vertex const &a, Vertex const &b) const noexcept
+        {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    // 以时间戳实现的FIFO缓存模拟
+    struct FifoCache
+    {
+        std::vector<unsigned int> timestamps;
+        unsigned int now;
+        unsigned int size;
+
+        FifoCache(std::size_t vertexCount, unsigned int cacheSize)
+            : timestamps(vertexCount, 0), now(cacheSize + 1), size(cacheSize)
+        {
+        }
+        // returns true on a miss
+        bool touch(unsigned int v)
+        {
+            if (now - timestamps[v] > size)
+            {
+                timestamps[v] = now++;
+                return true;
+            }
+            return false;
+        }
+    };
+
+    // 顶点 -> 引用它的三角形
+    struct Adjacency
+    {
+        std::vector<unsigned int> counts;
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+
+        Adjacency(std::vector<unsigned int> const &indices, std::size_t vertexCount)
+            : counts(vertexCount, 0), offsets(vertexCount + 1, 0), triangles(indices.size())
+        {
+            for (unsigned int index : indices)
+                counts[index]++;
+            for (std::size_t v = 0; v < vertexCount; v++)
+                offsets[v + 1] = offsets[v] + counts[v];
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < indices.size(); i++)
+                triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    };
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(std::vector<unsigned int> const &indices, std::size_t vertexCount,
+                                                            unsigned int cacheSize)
+{
+    CacheStats stats{0.0f, 0.0f, 0, indices.size() / 3, 0};
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    for (unsigned int index : indices)
+    {
+        if (cache.touch(index))
+            stats.misses++;
+        if (!used[index])
+        {
+            used[index] = true;
+            stats.vertices++;
+        }
+    }
+    if (stats.triangles)
+        stats.acmr = static_cast<float>(stats.misses) / static_cast<float>(stats.triangles);
+    if (stats.vertices)
+        stats.atvr = static_cast<float>(stats.misses) / static_cast<float>(stats.vertices);
+    return stats;
+}
+
+void MeshOptimizer::DeduplicateVertices(MeshData &mesh)
+{
+    std::unordered_map<Vertex, unsigned int, VertexBytesHash, VertexBytesEqual> lookup;
+    lookup.reserve(mesh.vertices.size());
+    std::vector<unsigned int> remap(mesh.vertices.size());
+    std::vector<Vertex> unique;
+    unique.reserve(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        auto [it, inserted] = lookup.try_emplace(mesh.vertices[i], static_cast<unsigned int>(unique.size()));
+        if (inserted)
+            unique.push_back(mesh.vertices[i]);
+        remap[i] = it->second;
+    }
+    for (unsigned int &index : mesh.indices)
+        index = remap[index];
+    mesh.vertices = std::move(unique);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int> &indices, std::size_t vertexCount,
+                                        std::vector<unsigned int> *clusters, unsigned int cacheSize)
+{
+    std::size_t triangleCount = indices.size() / 3;
+    if (clusters)
+        clusters->clear();
+    if (triangleCount == 0)
+        return;
+
+    Adjacency adjacency(indices, vertexCount);
+    std::vector<unsigned int> live(adjacency.counts); // 每个顶点剩余未输出的三角形数
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd; // 最近用过的顶点栈
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1;
+    std::size_t cursor = 0;
+    int fanning = 0; // 从顶点0开始
+    if (clusters)
+        clusters->push_back(0);
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        // 输出 fanning 顶点周围所有未输出的三角形
+        for (unsigned int k = adjacency.offsets[fanning]; k < adjacency.offsets[fanning + 1]; k++)
+        {
+            unsigned int t = adjacency.triangles[k];
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int v = indices[t * 3 + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - timestamps[v] > cacheSize)
+                    timestamps[v] = time++;
+            }
+        }
+
+        // 选下一个扇心: 优先仍在缓存中、且剩余三角形输出后不会被挤出的顶点
+        int next = -1;
+        int bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - timestamps[v] + 2 * live[v] <= cacheSize)
+                priority = static_cast<int>(time - timestamps[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = static_cast<int>(v);
+            }
+        }
+
+        // 死路: 先从最近用过的顶点里找, 再顺序扫描; 这里是一个硬簇边界
+        if (next < 0)
+        {
+            while (!deadEnd.empty())
+            {
+                unsigned int d = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[d] > 0)
+                {
+                    next = static_cast<int>(d);
+                    break;
+                }
+            }
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    next = static_cast<int>(cursor);
+                cursor++;
+            }
+            if (next >= 0 && clusters && output.size() / 3 < triangleCount)
+                clusters->push_back(static_cast<unsigned int>(output.size() / 3));
+        }
+        fanning = next;
+    }
+    indices = std::move(output);
+}
+
+namespace
+{
+    // 在簇边界 splits 上按遮挡潜力排序: 簇中心相对网格中心沿簇平均法线的距离, 越靠外越先画.
+    // clusterOrder 返回排序后各位置上原来的簇号
+    std::vector<unsigned int> sortClusters(std::vector<unsigned int> const &indices, std::vector<Vertex> const &vertices,
+                                           std::vector<unsigned int> const &splits,
+                                           std::vector<unsigned int> *clusterOrder = nullptr)
+    {
+        std::size_t triangleCount = indices.size() / 3;
+        glm::vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        std::vector<glm::vec3> centers(splits.size());
+        std::vector<glm::vec3> normals(splits.size());
+        for (std::size_t c = 0; c < splits.size(); c++)
+        {
+            std::size_t begin = splits[c];
+            std::size_t end = c + 1 < splits.size() ? splits[c + 1] : triangleCount;
+            glm::vec3 center(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (std::size_t t = begin; t < end; t++)
+            {
+                glm::vec3 const &a = vertices[indices[t * 3 + 0]].Position;
+                glm::vec3 const &b = vertices[indices[t * 3 + 1]].Position;
+                glm::vec3 const &p = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 n = glm::cross(b - a, p - a); // 长度为面积的两倍
+                float triangleArea = glm::length(n);
+                center += (a + b + p) * (triangleArea / 3.0f);
+                normal += n;
+                area += triangleArea;
+            }
+            meshCenter += center;
+            meshArea += area;
+            centers[c] = area > 0.0f ? center / area : vertices[indices[begin * 3]].Position;
+            float length = glm::length(normal);
+            normals[c] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        }
+        if (meshArea > 0.0f)
+            meshCenter /= meshArea;
+        std::vector<float> potential(splits.size());
+        for (std::size_t c = 0; c < splits.size(); c++)
+            potential[c] = glm::dot(centers[c] - meshCenter, normals[c]);
+
+        std::vector<unsigned int> order(splits.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return potential[a] > potential[b]; });
+
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        for (unsigned int c : order)
+        {
+            std::size_t begin = splits[c];
+            std::size_t end = c + 1 < splits.size() ? splits[c + 1] : triangleCount;
+            output.insert(output.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+        }
+        if (clusterOrder)
+            *clusterOrder = std::move(order);
+        return output;
+    }
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<unsigned int> &indices, std::vector<Vertex> const &vertices,
+                                     std::vector<unsigned int> const &clusters, float threshold, unsigned int cacheSize)
+{
+    std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || clusters.size() < 2)
+        return;
+
+    // 1. 细分簇: 从冷缓存开始模拟, 局部ACMR已经不比整体差太多, 且剩下的部分也足够长时切开
+    float targetAcmr = AnalyzeVertexCache(indices, vertices.size(), cacheSize).acmr;
+    float softAcmr = targetAcmr * threshold;
+    std::size_t minLength = cacheSize * 4;
+    std::vector<unsigned int> splits;
+    FifoCache cache(vertices.size(), cacheSize);
+    for (std::size_t c = 0; c < clusters.size(); c++)
+    {
+        std::size_t begin = clusters[c];
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        splits.push_back(static_cast<unsigned int>(begin));
+        cache.now += cacheSize + 1; // 每个簇都可能被排到任意位置, 按冷缓存计算
+        std::size_t start = begin;
+        std::size_t misses = 0;
+        for (std::size_t t = begin; t < end; t++)
+        {
+            for (int k = 0; k < 3; k++)
+                misses += cache.touch(indices[t * 3 + k]) ? 1 : 0;
+            std::size_t length = t + 1 - start;
+            if (end - (t + 1) >= minLength && length >= minLength &&
+                static_cast<float>(misses) / static_cast<float>(length) <= softAcmr)
+            {
+                splits.push_back(static_cast<unsigned int>(t + 1));
+                start = t + 1;
+                misses = 0;
+                cache.now += cacheSize + 1;
+            }
+        }
+    }
+
+    // 2. 排序后缓存效率变差太多就退回只用硬簇, 再不行就保持 Tipsify 的顺序
+    std::vector<unsigned int> const *candidates[] = {&splits, &clusters};
+    for (std::vector<unsigned int> const *boundaries : candidates)
+    {
+        std::vector<unsigned int> sorted = sortClusters(indices, vertices, *boundaries);
+        if (AnalyzeVertexCache(sorted, vertices.size(), cacheSize).acmr <= softAcmr)
+        {
+            indices = std::move(sorted);
+            return;
+        }
+    }
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshData &mesh)
+{
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(mesh.vertices.size(), UNUSED);
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (unsigned int &index : mesh.indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    // 没有被任何三角形引用的顶点直接丢弃
+    mesh.vertices = std::move(ordered);
+}
+
+void MeshOptimizer::Optimize(MeshData &mesh)
+{
+    DeduplicateVertices(mesh);
+    std::vector<unsigned int> clusters;
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size(), &clusters);
+    OptimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+    OptimizeVertexFetch(mesh);
+}
+
+namespace
+{
+    // 对称4x4矩阵形式的二次误差 (Garland & Heckbert)
+    struct Quadric
+    {
+        float a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        float b0 = 0, b1 = 0, b2 = 0, c = 0;
+
+        void addPlane(glm::vec3 const &n, float d)
+        {
+            a00 += n.x * n.x;
+            a01 += n.x * n.y;
+            a02 += n.x * n.z;
+            a11 += n.y * n.y;
+            a12 += n.y * n.z;
+            a22 += n.z * n.z;
+            b0 += n.x * d;
+            b1 += n.y * d;
+            b2 += n.z * d;
+            c += d * d;
+        }
+        void add(Quadric const &q)
+        {
+            a00 += q.a00;
+            a01 += q.a01;
+            a02 += q.a02;
+            a11 += q.a11;
+            a12 += q.a12;
+            a22 += q.a22;
+            b0 += q.b0;
+            b1 += q.b1;
+            b2 += q.b2;
+            c += q.c;
+        }
+        // 点到所有平面距离的平方和
+        float error(glm::vec3 const &p) const
+        {
+            float rx = a00 * p.x + a01 * p.y + a02 * p.z + b0;
+            float ry = a01 * p.x + a11 * p.y + a12 * p.z + b1;
+            float rz = a02 * p.x + a12 * p.y + a22 * p.z + b2;
+            float e = rx * p.x + ry * p.y + rz * p.z + b0 * p.x + b1 * p.y + b2 * p.z + c;
+            return e > 0.0f ? e : 0.0f;
+        }
+    };
+
+    struct PositionHash
+    {
+        std::size_t operator()(glm::vec3 const &p) const noexcept
+        {
+            std::uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return static_cast<std::size_t>((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+        }
+    };
+
+    struct Collapse
+    {
+        unsigned int source; // vertex index
+        unsigned int target;
+        float cost;
+    };
+
+    glm::vec3 triangleNormal(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c)
+    {
+        return glm::cross(b - a, c - a);
+    }
+}
+
+std::vector<unsigned int> MeshOptimizer::Simplify(std::vector<unsigned int> const &indices, std::vector<Vertex> const &vertices,
+                                                  std::size_t targetIndexCount, float *resultError)
+{
+    std::vector<unsigned int> result(indices);
+    float maxError = 0.0f;
+    if (resultError)
+        *resultError = 0.0f;
+    if (indices.size() <= targetIndexCount)
+        return result;
+
+    // 1. 同一位置的顶点(纹理接缝两侧)归为一个位置
+    std::size_t vertexCount = vertices.size();
+    std::vector<unsigned int> positionOf(vertexCount);
+    std::vector<unsigned int> wedges; // 每个位置有几个不同的顶点
+    {
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> lookup;
+        lookup.reserve(vertexCount);
+        for (std::size_t v = 0; v < vertexCount; v++)
+        {
+            auto [it, inserted] = lookup.try_emplace(vertices[v].Position, static_cast<unsigned int>(wedges.size()));
+            if (inserted)
+                wedges.push_back(0);
+            positionOf[v] = it->second;
+        }
+        std::vector<bool> used(vertexCount, false);
+        for (unsigned int index : indices)
+            if (!used[index])
+            {
+                used[index] = true;
+                wedges[positionOf[index]]++;
+            }
+    }
+    std::size_t positionCount = wedges.size();
+
+    // 2. 边界边(只属于一个三角形)和非流形边上的位置, 以及接缝位置都锁定
+    std::vector<bool> locked(positionCount, false);
+    {
+        std::unordered_map<std::uint64_t, unsigned int> edgeUse;
+        edgeUse.reserve(indices.size());
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                std::uint64_t a = positionOf[indices[i + k]], b = positionOf[indices[i + (k + 1) % 3]];
+                edgeUse[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+            }
+        for (auto const &[edge, count] : edgeUse)
+            if (count != 2)
+            {
+                locked[edge >> 32] = true;
+                locked[edge & 0xFFFFFFFFu] = true;
+            }
+        for (std::size_t p = 0; p < positionCount; p++)
+            if (wedges[p] > 1)
+                locked[p] = true;
+    }
+
+    // 3. 每个位置的二次误差
+    std::vector<Quadric> quadrics(positionCount);
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::vec3 const &a = vertices[indices[i]].Position;
+        glm::vec3 n = triangleNormal(a, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position);
+        float length = glm::length(n);
+        if (length == 0.0f)
+            continue;
+        n /= length;
+        Quadric q;
+        q.addPlane(n, -glm::dot(n, a));
+        for (int k = 0; k < 3; k++)
+            quadrics[positionOf[indices[i + k]]].add(q);
+    }
+
+    // 4. 分轮折叠: 每轮按代价从小到大选一批互不相邻的边
+    std::vector<unsigned int> collapseTo(positionCount);
+    std::vector<bool> touched(positionCount);
+    std::vector<unsigned int> triangleOffsets(positionCount + 1);
+    std::vector<unsigned int> triangleList;
+    std::vector<Collapse> candidates;
+    const unsigned int NONE = ~0u;
+    while (result.size() > targetIndexCount)
+    {
+        // 位置 -> 三角形邻接
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0u);
+        for (unsigned int index : result)
+            triangleOffsets[positionOf[index] + 1]++;
+        for (std::size_t p = 0; p < positionCount; p++)
+            triangleOffsets[p + 1] += triangleOffsets[p];
+        triangleList.resize(result.size());
+        {
+            std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (std::size_t i = 0; i < result.size(); i++)
+                triangleList[fill[positionOf[result[i]]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        candidates.clear();
+        for (std::size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v0 = result[i + k], v1 = result[i + (k + 1) % 3];
+                unsigned int p0 = positionOf[v0], p1 = positionOf[v1];
+                if (!locked[p0])
+                    candidates.push_back(Collapse{v0, v1, quadrics[p0].error(vertices[v1].Position)});
+                if (!locked[p1])
+                    candidates.push_back(Collapse{v1, v0, quadrics[p1].error(vertices[v0].Position)});
+            }
+        if (candidates.empty())
+            break;
+        std::sort(candidates.begin(), candidates.end(), [](Collapse const &a, Collapse const &b) { return a.cost < b.cost; });
+
+        std::fill(collapseTo.begin(), collapseTo.end(), NONE);
+        std::fill(touched.begin(), touched.end(), false);
+        std::size_t trianglesNeeded = (result.size() - targetIndexCount) / 3;
+        std::size_t trianglesRemoved = 0;
+        // 每轮最多用掉一部分候选, 避免一轮里把代价高的边也折掉
+        std::size_t budget = std::max<std::size_t>(1, candidates.size() / 6);
+        for (std::size_t c = 0; c < candidates.size() && c < budget && trianglesRemoved < trianglesNeeded; c++)
+        {
+            Collapse const &collapse = candidates[c];
+            unsigned int p0 = positionOf[collapse.source], p1 = positionOf[collapse.target];
+            if (touched[p0] || touched[p1])
+                continue;
+
+            // 翻转检查: p0 周围不含 p1 的三角形在移动后法线不能反向
+            glm::vec3 const &target = vertices[collapse.target].Position;
+            bool flips = false;
+            for (unsigned int k = triangleOffsets[p0]; k < triangleOffsets[p0 + 1] && !flips; k++)
+            {
+                unsigned int t = triangleList[k];
+                glm::vec3 corners[3];
+                bool hasTarget = false;
+                int moved = -1;
+                for (int j = 0; j < 3; j++)
+                {
+                    unsigned int p = positionOf[result[t * 3 + j]];
+                    corners[j] = vertices[result[t * 3 + j]].Position;
+                    hasTarget |= p == p1;
+                    if (p == p0)
+                        moved = j;
+                }
+                if (hasTarget || moved < 0)
+                    continue;
+                glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+                corners[moved] = target;
+                glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+                if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+                    flips = true;
+            }
+            if (flips)
+                continue;
+
+            collapseTo[p0] = collapse.target;
+            quadrics[p1].add(quadrics[p0]);
+            maxError = std::max(maxError, collapse.cost);
+            // 一环邻域本轮内不再参与折叠, 保证上面的翻转检查仍然成立
+            for (unsigned int k = triangleOffsets[p0]; k < triangleOffsets[p0 + 1]; k++)
+                for (int j = 0; j < 3; j++)
+                    touched[positionOf[result[triangleList[k] * 3 + j]]] = true;
+            touched[p1] = true;
+            trianglesRemoved += 2;
+        }
+        if (trianglesRemoved == 0)
+            break;
+
+        // 应用折叠并去掉退化三角形
+        std::size_t write = 0;
+        for (std::size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int tri[3];
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = result[i + k];
+                unsigned int to = collapseTo[positionOf[v]];
+                tri[k] = to == NONE ? v : to;
+            }
+            unsigned int a = positionOf[tri[0]], b = positionOf[tri[1]], c = positionOf[tri[2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = tri[0];
+            result[write++] = tri[1];
+            result[write++] = tri[2];
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+        *resultError = std::sqrt(maxError);
+    return result;
+}
+
+void MeshOptimizer::GenerateLods(MeshData &mesh)
+{
+    mesh.lods.clear();
+    unsigned int baseCount = static_cast<unsigned int>(mesh.indices.size());
+    mesh.lods.push_back(MeshLod{0, baseCount, 0.0f});
+
+    std::vector<unsigned int> previous(mesh.indices);
+    float previousError = 0.0f;
+    for (float ratio : LOD_RATIOS)
+    {
+        std::size_t target = static_cast<std::size_t>(baseCount / 3 * ratio) * 3;
+        if (target < 3 * 16)
+            break;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = Simplify(previous, mesh.vertices, target, &error);
+        // 简化不动了(都被锁定)就不再继续
+        if (lod.size() * 10 > previous.size() * 9)
+            break;
+        OptimizeVertexCache(lod, mesh.vertices.size());
+        // 每一级从上一级简化, 误差按累加估计
+        previousError += error;
+        mesh.lods.push_back(MeshLod{static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lod.size()), previousError});
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        previous = std::move(lod);
+    }
+}
+
+namespace
+{
+    void finishMeshlet(Meshlet &meshlet, std::vector<unsigned int> const &indices, std::vector<Vertex> const &vertices)
+    {
+        std::size_t begin = meshlet.indexOffset, end = begin + meshlet.triangleCount * 3;
+
+        // 包围球: AABB中心 + 最远顶点距离
+        glm::vec3 lo = vertices[indices[begin]].Position, hi = lo;
+        for (std::size_t i = begin; i < end; i++)
+        {
+            lo = glm::min(lo, vertices[indices[i]].Position);
+            hi = glm::max(hi, vertices[indices[i]].Position);
+        }
+        meshlet.center = (lo + hi) * 0.5f;
+        float radius2 = 0.0f;
+        for (std::size_t i = begin; i < end; i++)
+        {
+            glm::vec3 d = vertices[indices[i]].Position - meshlet.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        meshlet.radius = std::sqrt(radius2);
+
+        // 法线锥: 轴为单位面法线的平均, 半角由与轴夹角最大的面法线决定
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.triangleCount);
+        glm::vec3 axis(0.0f);
+        for (std::size_t i = begin; i < end; i += 3)
+        {
+            glm::vec3 n = triangleNormal(vertices[indices[i]].Position, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position);
+            float length = glm::length(n);
+            if (length == 0.0f)
+                continue;
+            normals.push_back(n / length);
+            axis += normals.back();
+        }
+        meshlet.coneAxis = glm::vec3(0.0f);
+        meshlet.coneCutoff = 1.0f;
+        float axisLength = glm::length(axis);
+        if (axisLength == 0.0f)
+            return;
+        axis /= axisLength;
+        float minDot = 1.0f;
+        for (auto const &n : normals)
+            minDot = std::min(minDot, glm::dot(n, axis));
+        // 锥角超过约84度时几乎不可能整簇背面, 不做剔除
+        if (minDot <= 0.1f)
+            return;
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+void MeshOptimizer::BuildMeshlets(MeshData &mesh)
+{
+    mesh.meshlets.clear();
+    std::size_t indexCount = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+    std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+    std::vector<unsigned int> const &indices = mesh.indices;
+    std::vector<Vertex> const &vertices = mesh.vertices;
+
+    // 顶点 -> 三角形邻接, 以及每个三角形的单位法线和重心
+    std::vector<unsigned int> offsets(vertices.size() + 1, 0);
+    for (std::size_t i = 0; i < indexCount; i++)
+        offsets[indices[i] + 1]++;
+    for (std::size_t v = 0; v < vertices.size(); v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adjacency(indexCount);
+    {
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < indexCount; i++)
+            adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+    std::vector<glm::vec3> normals(triangleCount), centroids(triangleCount);
+    glm::vec3 lo = vertices[indices[0]].Position, hi = lo;
+    for (std::size_t t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 const &a = vertices[indices[t * 3]].Position;
+        glm::vec3 const &b = vertices[indices[t * 3 + 1]].Position;
+        glm::vec3 const &c = vertices[indices[t * 3 + 2]].Position;
+        glm::vec3 n = triangleNormal(a, b, c);
+        float length = glm::length(n);
+        normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        centroids[t] = (a + b + c) / 3.0f;
+        lo = glm::min(lo, centroids[t]);
+        hi = glm::max(hi, centroids[t]);
+    }
+    float meshScale = std::max(glm::length(hi - lo), 1e-6f);
+
+    // 贪心生长: 每次加入与当前簇共享顶点的三角形中, 法线最接近簇的平均法线、离簇中心最近的一个
+    // (新增顶点只做小的惩罚, 否则簇会沿着网格铺开, 法线锥太宽). 候选用完(孤岛)时从后续未用的三角形里找离簇最近的继续
+    const unsigned int NONE = ~0u;
+    std::vector<unsigned int> usedBy(vertices.size(), NONE); // 顶点所在的簇
+    std::vector<unsigned int> candidateOf(triangleCount, NONE);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> order; // 新的三角形顺序
+    order.reserve(triangleCount);
+    std::vector<unsigned int> candidates;
+    std::size_t cursor = 0; // 第一个可能未用的三角形
+
+    Meshlet current{0, 0, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f};
+    unsigned int id = 0, vertexCount = 0;
+    glm::vec3 axisSum(0.0f), centroidSum(0.0f);
+    auto extraVertices = [&](unsigned int t) {
+        unsigned int extra = 0;
+        for (int k = 0; k < 3; k++)
+            extra += usedBy[indices[t * 3 + k]] != id;
+        return extra;
+    };
+
+    while (order.size() < triangleCount)
+    {
+        // 从候选中选最好的
+        unsigned int best = NONE, bestExtra = 4;
+        float bestScore = 0.0f;
+        glm::vec3 axis = glm::length(axisSum) > 0.0f ? glm::normalize(axisSum) : glm::vec3(0.0f);
+        glm::vec3 center = current.triangleCount ? centroidSum / float(current.triangleCount) : glm::vec3(0.0f);
+        std::size_t write = 0;
+        for (unsigned int t : candidates)
+        {
+            if (emitted[t])
+                continue;
+            candidates[write++] = t;
+            unsigned int extra = extraVertices(t);
+            float score = (1.0f - glm::dot(normals[t], axis)) + glm::length(centroids[t] - center) / meshScale + extra * 0.1f;
+            if (best == NONE || score < bestScore)
+            {
+                best = t;
+                bestExtra = extra;
+                bestScore = score;
+            }
+        }
+        candidates.resize(write);
+
+        if (best == NONE)
+        {
+            while (emitted[cursor])
+                cursor++;
+            best = static_cast<unsigned int>(cursor);
+            if (current.triangleCount)
+            {
+                float bestDistance = glm::length(centroids[best] - center);
+                for (std::size_t t = cursor, scanned = 0; t < triangleCount && scanned < 256; t++)
+                {
+                    if (emitted[t])
+                        continue;
+                    scanned++;
+                    float distance = glm::length(centroids[t] - center);
+                    if (distance < bestDistance)
+                    {
+                        best = static_cast<unsigned int>(t);
+                        bestDistance = distance;
+                    }
+                }
+            }
+            bestExtra = extraVertices(best);
+        }
+
+        if (current.triangleCount == MESHLET_MAX_TRIANGLES || vertexCount + bestExtra > MESHLET_MAX_VERTICES)
+        {
+            mesh.meshlets.push_back(current);
+            current = Meshlet{static_cast<unsigned int>(order.size() * 3), 0, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f};
+            id++;
+            vertexCount = 0;
+            axisSum = centroidSum = glm::vec3(0.0f);
+            candidates.clear();
+            bestExtra = 3;
+        }
+
+        emitted[best] = true;
+        order.push_back(best);
+        current.triangleCount++;
+        vertexCount += bestExtra;
+        axisSum += normals[best];
+        centroidSum += centroids[best];
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[best * 3 + k];
+            usedBy[v] = id;
+            for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+            {
+                unsigned int t = adjacency[a];
+                if (!emitted[t] && candidateOf[t] != id)
+                {
+                    candidateOf[t] = id;
+                    candidates.push_back(t);
+                }
+            }
+        }
+    }
+    mesh.meshlets.push_back(current);
+
+    // 按簇的顺序重写LOD0的索引, 每个簇在索引缓冲中连续
+    std::vector<unsigned int> reordered(indexCount);
+    for (std::size_t i = 0; i < order.size(); i++)
+        for (int k = 0; k < 3; k++)
+            reordered[i * 3 + k] = indices[order[i] * 3 + k];
+
+    // 生长顺序不考虑顶点缓存, 每个簇内部换成局部顶点编号 (不超过 MESHLET_MAX_VERTICES 个) 重新做一遍 Tipsify
+    std::vector<unsigned int> localOf(vertices.size(), NONE), local, globalOf;
+    for (auto const &meshlet : mesh.meshlets)
+    {
+        std::size_t begin = meshlet.indexOffset, end = begin + meshlet.triangleCount * 3;
+        local.clear();
+        globalOf.clear();
+        for (std::size_t i = begin; i < end; i++)
+        {
+            unsigned int v = reordered[i];
+            if (localOf[v] >= globalOf.size() || globalOf[localOf[v]] != v)
+            {
+                localOf[v] = static_cast<unsigned int>(globalOf.size());
+                globalOf.push_back(v);
+            }
+            local.push_back(localOf[v]);
+        }
+        OptimizeVertexCache(local, globalOf.size());
+        for (std::size_t i = begin; i < end; i++)
+            reordered[i] = globalOf[local[i - begin]];
+    }
+
+    // 簇的先后按 OptimizeOverdraw 的遮挡潜力重排, 由外向内
+    std::vector<unsigned int> splits(mesh.meshlets.size()), clusterOrder;
+    for (std::size_t c = 0; c < mesh.meshlets.size(); c++)
+        splits[c] = mesh.meshlets[c].indexOffset / 3;
+    reordered = sortClusters(reordered, vertices, splits, &clusterOrder);
+    std::vector<Meshlet> sorted;
+    sorted.reserve(mesh.meshlets.size());
+    unsigned int offset = 0;
+    for (unsigned int c : clusterOrder)
+    {
+        sorted.push_back(mesh.meshlets[c]);
+        sorted.back().indexOffset = offset;
+        offset += sorted.back().triangleCount * 3;
+    }
+    mesh.meshlets = std::move(sorted);
+    std::copy(reordered.begin(), reordered.end(), mesh.indices.begin());
+
+    for (auto &meshlet : mesh.meshlets)
+        finishMeshlet(meshlet, mesh.indices, mesh.vertices);
+}
@@ -0,0 +1,186 @@
+// MeshOptimizer 的测试: 优化只改变三角形顺序和顶点编号, 不改变网格; LOD逐级变少; 网格簇不超过上限、覆盖LOD0,
+// 包围球和法线锥是保守的. 只用CPU, 不调用GL
+#include <MeshOptimizer.h>
+#include <TestCheck.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+    TestCheck check("MESHOPTIMIZER_TEST");
+
+    using Triangle = std::array<std::tuple<float, float, float>, 3>;
+
+    // 按顶点位置表示的三角形集合, 每个三角形旋转到最小的顶点在前 (保持绕向)
+    std::vector<Triangle> trianglesOf(std::vector<unsigned int> const &indices, std::size_t begin, std::size_t end,
+                                      std::vector<Vertex> const &vertices)
+    {
+        std::vector<Triangle> triangles;
+        for (std::size_t i = begin; i + 2 < end; i += 3)
+        {
+            Triangle t;
+            for (int k = 0; k < 3; k++)
+            {
+                glm::vec3 const &p = vertices[indices[i + k]].Position;
+                t[k] = std::make_tuple(p.x, p.y, p.z);
+            }
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    // 闭合的经纬球, 顶点共享, 纹理坐标为0 (没有接缝), 三角形从外面看逆时针
+    MeshData makeSphere(int rings, int segments)
+    {
+        MeshData mesh;
+        mesh.materialIndex = 0;
+        auto addVertex = [&](glm::vec3 const &p) {
+            Vertex vertex{};
+            vertex.Position = p;
+            vertex.Normal = glm::normalize(p);
+            mesh.vertices.push_back(vertex);
+            return static_cast<unsigned int>(mesh.vertices.size() - 1);
+        };
+        unsigned int top = addVertex(glm::vec3(0.0f, 1.0f, 0.0f));
+        for (int ring = 1; ring < rings; ring++)
+        {
+            float theta = 3.14159265f * ring / rings;
+            for (int segment = 0; segment < segments; segment++)
+            {
+                float phi = 6.2831853f * segment / segments;
+                addVertex(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi)));
+            }
+        }
+        unsigned int bottom = addVertex(glm::vec3(0.0f, -1.0f, 0.0f));
+        auto at = [&](int ring, int segment) { return 1u + static_cast<unsigned int>((ring - 1) * segments + segment % segments); };
+        for (int segment = 0; segment < segments; segment++)
+        {
+            mesh.indices.insert(mesh.indices.end(), {top, at(1, segment), at(1, segment + 1)});
+            mesh.indices.insert(mesh.indices.end(), {bottom, at(rings - 1, segment + 1), at(rings - 1, segment)});
+            for (int ring = 1; ring + 1 < rings; ring++)
+            {
+                mesh.indices.insert(mesh.indices.end(), {at(ring, segment), at(ring + 1, segment), at(ring + 1, segment + 1)});
+                mesh.indices.insert(mesh.indices.end(), {at(ring, segment), at(ring + 1, segment + 1), at(ring, segment + 1)});
+            }
+        }
+        return mesh;
+    }
+}
+
+int main()
+{
+    std::mt19937 random(9);
+    MeshData sphere = makeSphere(40, 64);
+    std::size_t uniqueVertices = sphere.vertices.size();
+    std::vector<Triangle> original = trianglesOf(sphere.indices, 0, sphere.indices.size(), sphere.vertices);
+
+    // 展开成每个三角形3个独立顶点并打乱三角形顺序, 模拟没有优化过的导入结果
+    MeshData mesh;
+    mesh.materialIndex = 0;
+    std::vector<std::size_t> order(sphere.indices.size() / 3);
+    for (std::size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), random);
+    for (std::size_t t : order)
+        for (int k = 0; k < 3; k++)
+        {
+            mesh.vertices.push_back(sphere.vertices[sphere.indices[t * 3 + k]]);
+            mesh.indices.push_back(static_cast<unsigned int>(mesh.vertices.size() - 1));
+        }
+    MeshOptimizer::CacheStats before = MeshOptimizer::AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    MeshOptimizer::Optimize(mesh);
+    MeshOptimizer::CacheStats after = MeshOptimizer::AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    check(mesh.vertices.size() == uniqueVertices, "DeduplicateVertices left duplicate vertices");
+    check(trianglesOf(mesh.indices, 0, mesh.indices.size(), mesh.vertices) == original, "Optimize changed the set of triangles");
+    check(after.acmr < before.acmr && after.acmr < 0.8f, "Optimize did not bring the ACMR below 0.8");
+    // 顶点读取顺序: 顶点按第一次被引用的顺序编号
+    unsigned int next = 0;
+    bool fetchOrdered = true;
+    for (unsigned int index : mesh.indices)
+    {
+        fetchOrdered = fetchOrdered && index <= next;
+        next = std::max(next, index + 1);
+    }
+    check(fetchOrdered, "OptimizeVertexFetch did not number vertices by first use");
+
+    // LOD: 第0级是原网格, 之后每级更少、误差不减, 下标都在顶点范围内
+    MeshOptimizer::GenerateLods(mesh);
+    check(!mesh.lods.empty() && mesh.lods[0].indexOffset == 0 && mesh.lods[0].indexCount == original.size() * 3,
+          "LOD0 is not the original mesh");
+    check(mesh.lods.size() > 1, "GenerateLods produced no coarser level for a closed sphere");
+    bool lodsOk = true;
+    unsigned int expectedOffset = 0;
+    for (std::size_t level = 0; level < mesh.lods.size(); level++)
+    {
+        MeshLod const &lod = mesh.lods[level];
+        lodsOk = lodsOk && lod.indexOffset == expectedOffset && lod.indexCount % 3 == 0 && lod.indexCount > 0;
+        if (level > 0)
+            lodsOk = lodsOk && lod.indexCount < mesh.lods[level - 1].indexCount && lod.error >= mesh.lods[level - 1].error;
+        expectedOffset += lod.indexCount;
+    }
+    lodsOk = lodsOk && expectedOffset == mesh.indices.size();
+    for (unsigned int index : mesh.indices)
+        lodsOk = lodsOk && index < mesh.vertices.size();
+    check(lodsOk, "LOD ranges are not contiguous, shrinking and in range");
+
+    // 网格簇: 按顺序连续覆盖LOD0, 不超过顶点和三角形上限, LOD0仍是同样的三角形, 其余LOD不变
+    std::vector<unsigned int> coarser(mesh.indices.begin() + mesh.lods[0].indexCount, mesh.indices.end());
+    MeshOptimizer::BuildMeshlets(mesh);
+    check(!mesh.meshlets.empty(), "BuildMeshlets produced no meshlets");
+    check(trianglesOf(mesh.indices, 0, mesh.lods[0].indexCount, mesh.vertices) == original, "BuildMeshlets changed the LOD0 triangles");
+    check(std::equal(coarser.begin(), coarser.end(), mesh.indices.begin() + mesh.lods[0].indexCount), "BuildMeshlets changed coarser LODs");
+    bool meshletsOk = true, spheresOk = true;
+    unsigned int offset = 0;
+    for (Meshlet const &meshlet : mesh.meshlets)
+    {
+        std::set<unsigned int> used(mesh.indices.begin() + meshlet.indexOffset,
+                                    mesh.indices.begin() + meshlet.indexOffset + meshlet.triangleCount * 3);
+        meshletsOk = meshletsOk && meshlet.indexOffset == offset && meshlet.triangleCount > 0 &&
+                     meshlet.triangleCount <= MeshOptimizer::MESHLET_MAX_TRIANGLES && used.size() <= MeshOptimizer::MESHLET_MAX_VERTICES;
+        for (unsigned int index : used)
+            spheresOk = spheresOk && glm::length(mesh.vertices[index].Position - meshlet.center) <= meshlet.radius * 1.0001f + 1e-6f;
+        offset += meshlet.triangleCount * 3;
+    }
+    check(meshletsOk && offset == mesh.lods[0].indexCount, "meshlets do not tile LOD0 within the size limits");
+    check(spheresOk, "a meshlet bounding sphere does not contain its vertices");
+
+    // 法线锥: 按 Mesh::DrawClusters 的判断整簇剔除时, 簇里每个三角形都背对相机
+    std::uniform_real_distribution<float> coordinate(-5.0f, 5.0f);
+    bool conesOk = true;
+    std::size_t culled = 0;
+    for (int camera = 0; camera < 200; camera++)
+    {
+        glm::vec3 eye(coordinate(random), coordinate(random), coordinate(random));
+        if (glm::length(eye) < 1.5f)
+            continue;
+        for (Meshlet const &meshlet : mesh.meshlets)
+        {
+            glm::vec3 view = meshlet.center - eye;
+            if (!(glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius))
+                continue;
+            culled++;
+            for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+            {
+                glm::vec3 const &a = mesh.vertices[mesh.indices[meshlet.indexOffset + t * 3]].Position;
+                glm::vec3 const &b = mesh.vertices[mesh.indices[meshlet.indexOffset + t * 3 + 1]].Position;
+                glm::vec3 const &c = mesh.vertices[mesh.indices[meshlet.indexOffset + t * 3 + 2]].Position;
+                conesOk = conesOk && glm::dot(glm::cross(b - a, c - a), a - eye) >= 0.0f;
+            }
+        }
+    }
+    check(conesOk, "a meshlet was cone-culled while one of its triangles faces the camera");
+    check(culled > 0, "no meshlet was ever cone-culled, the test checks nothing");
+
+    return check.Finish("MeshOptimizer", " (ACMR ", before.acmr, " -> ", after.acmr, ", ", mesh.lods.size(), " LODs, ", mesh.meshlets.size(),
+                        " meshlets)");
+}
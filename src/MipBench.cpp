@@ -0,0 +1,128 @@
+// mip链生成的基准: glGenerateMipmap 与 MipGenerator (CPU) 对比.
+// 在软件GL上测: LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe ./mipbench [image.png]
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <MipGenerator.h>
+#include <Stopwatch.h>
+#include <ThreadPool.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const int REPEATS = 5;
+
+    // 带高频细节的测试图, 避免驱动对纯色图走捷径
+    std::vector<unsigned char> makePattern(int size)
+    {
+        std::vector<unsigned char> pixels(static_cast<std::size_t>(size) * size * 4);
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++)
+            {
+                unsigned char *p = pixels.data() + (static_cast<std::size_t>(y) * size + x) * 4;
+                p[0] = static_cast<unsigned char>((x ^ y) & 0xFF);
+                p[1] = static_cast<unsigned char>(127.5f + 127.5f * std::sin(x * 0.37f) * std::cos(y * 0.21f));
+                p[2] = static_cast<unsigned char>((x * 7 + y * 13) & 0xFF);
+                p[3] = 255;
+            }
+        return pixels;
+    }
+
+    void benchmark(const unsigned char *pixels, int width, int height)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glFinish();
+
+        double gpu = Stopwatch::BestOfMs(REPEATS, []() {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glFinish();
+        });
+        std::cout << width << "x" << height << "  glGenerateMipmap " << gpu << " ms" << std::endl;
+
+        struct Variant
+        {
+            const char *name;
+            MipFilter filter;
+            bool srgb;
+        } variants[] = {{"box linear", MipFilter::Box, false},
+                        {"box sRGB", MipFilter::Box, true},
+                        {"kaiser sRGB", MipFilter::Kaiser, true}};
+        for (Variant const &variant : variants)
+        {
+            MipOptions options;
+            options.filter = variant.filter;
+            options.srgb = variant.srgb;
+            std::vector<MipLevel> levels;
+            double cpu = Stopwatch::BestOfMs(REPEATS, [&]() { levels = MipGenerator::Generate(pixels, width, height, 4, options); });
+            // GL线程上实际要付出的代价: 逐级上传
+            double upload = Stopwatch::BestOfMs(REPEATS, [&]() {
+                for (std::size_t i = 0; i < levels.size(); i++)
+                    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), GL_RGBA, levels[i].width, levels[i].height, 0,
+                                 GL_RGBA, GL_UNSIGNED_BYTE, levels[i].data.data());
+                glFinish();
+            });
+            std::cout << "    MipGenerator " << variant.name << ": " << cpu << " ms on workers, upload " << upload
+                      << " ms on GL thread" << std::endl;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glDeleteTextures(1, &texture);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow *window = glfwCreateWindow(64, 64, "mipbench", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << ", " << ThreadPool::Global().Size() + 1
+              << " threads for MipGenerator" << std::endl;
+    if (argc > 1)
+    {
+        int width, height, nrComponents;
+        unsigned char *data = stbi_load(argv[1], &width, &height, &nrComponents, 4);
+        if (!data)
+        {
+            std::cout << "ERROR::MIPBENCH::could not load " << argv[1] << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        benchmark(data, width, height);
+        stbi_image_free(data);
+    }
+    else
+    {
+        for (int size : {512, 1024, 2048})
+        {
+            std::vector<unsigned char> pixels = makePattern(size);
+            benchmark(pixels.data(), size, size);
+        }
+    }
+
+    glfwTerminate();
+    return 0;
+}
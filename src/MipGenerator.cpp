@@ -0,0 +1,424 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_USE_SSE2 1
+#endif
+
+namespace
+{
+    struct alignas(16) Pixel
+    {
+        float v[4];
+    };
+
+    // 一个像素的4个通道一起运算
+#ifdef MIP_USE_SSE2
+    using Vec4 = __m128;
+    inline Vec4 load(Pixel const &p) { return _mm_load_ps(p.v); }
+    inline void store(Pixel &p, Vec4 v) { _mm_store_ps(p.v, v); }
+    inline Vec4 splat(float s) { return _mm_set1_ps(s); }
+    inline Vec4 add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+    inline Vec4 mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+    inline Vec4 clamp01(Vec4 a) { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+#else
+    struct Vec4
+    {
+        float v[4];
+    };
+    inline Vec4 load(Pixel const &p) { return Vec4{{p.v[0], p.v[1], p.v[2], p.v[3]}}; }
+    inline void store(Pixel &p, Vec4 v) { std::copy(v.v, v.v + 4, p.v); }
+    inline Vec4 splat(float s) { return Vec4{{s, s, s, s}}; }
+    inline Vec4 add(Vec4 a, Vec4 b) { return Vec4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+    inline Vec4 mul(Vec4 a, Vec4 b) { return Vec4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+    inline Vec4 clamp01(Vec4 a)
+    {
+        for (float &c : a.v)
+            c = std::clamp(c, 0.0f, 1.0f);
+        return a;
+    }
+#endif
+
+    struct Plane
+    {
+        int width = 0, height = 0;
+        std::vector<Pixel> pixels;
+
+        Plane() = default;
+        Plane(int width, int height) : width(width), height(height), pixels(static_cast<std::size_t>(width) * height) {}
+        Pixel *Row(int y) { return pixels.data() + static_cast<std::size_t>(y) * width; }
+        Pixel const *Row(int y) const { return pixels.data() + static_cast<std::size_t>(y) * width; }
+    };
+
+    // 按行分块并行, 小图直接在当前线程上做
+    template <class F>
+    void forRows(int rows, int rowPixels, F &&fn)
+    {
+        constexpr std::size_t MIN_PIXELS_PER_TASK = 16384;
+        std::size_t total = static_cast<std::size_t>(rows) * rowPixels;
+        std::size_t tasks = std::min<std::size_t>(rows, total / MIN_PIXELS_PER_TASK);
+        tasks = std::min<std::size_t>(tasks, (ThreadPool::Global().Size() + 1) * 4);
+        if (tasks <= 1)
+        {
+            fn(0, rows);
+            return;
+        }
+        ThreadPool::Global().ParallelFor(tasks, [&](std::size_t task) {
+            fn(static_cast<int>(rows * task / tasks), static_cast<int>(rows * (task + 1) / tasks));
+        });
+    }
+
+    float srgbToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    // 线性值按 1/4096 分桶, 每个桶里最多有一个sRGB编码的分界点 (分界点的最小间距约 1/3300)
+    constexpr int ENCODE_BUCKETS = 4096;
+
+    struct SrgbTables
+    {
+        float linear[256];   // i / 255
+        float toLinear[256]; // sRGB 解码
+        float thresholds[256]; // 线性值不小于 thresholds[i] 时编码至少为 i + 1, 即在sRGB空间四舍五入; 最后一个为哨兵
+        unsigned char bucketCode[ENCODE_BUCKETS + 1];
+    };
+
+    SrgbTables const &srgbTables()
+    {
+        static const SrgbTables tables = []() {
+            SrgbTables t;
+            for (int i = 0; i < 256; i++)
+            {
+                t.linear[i] = i / 255.0f;
+                t.toLinear[i] = srgbToLinear(i / 255.0f);
+            }
+            for (int i = 0; i < 255; i++)
+                t.thresholds[i] = srgbToLinear((i + 0.5f) / 255.0f);
+            t.thresholds[255] = 2.0f;
+            for (int b = 0; b <= ENCODE_BUCKETS; b++)
+            {
+                float value = static_cast<float>(b) / ENCODE_BUCKETS;
+                t.bucketCode[b] = static_cast<unsigned char>(std::upper_bound(t.thresholds, t.thresholds + 255, value) - t.thresholds);
+            }
+            return t;
+        }();
+        return tables;
+    }
+
+    inline unsigned char encodeSrgb(SrgbTables const &tables, float value)
+    {
+        value = std::clamp(value, 0.0f, 1.0f);
+        unsigned char code = tables.bucketCode[static_cast<int>(value * ENCODE_BUCKETS)];
+        return value >= tables.thresholds[code] ? code + 1 : code;
+    }
+
+    inline unsigned char encodeLinear(float value)
+    {
+        return static_cast<unsigned char>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    // 参与sRGB转换的通道数: 灰度+alpha 的第二个通道和 RGBA 的第四个通道是alpha
+    int colorChannels(int channels) { return channels == 2 ? 1 : std::min(channels, 3); }
+
+    // 8位输入, 每个通道查表解码到线性的 [0,1]
+    struct ByteImage
+    {
+        const unsigned char *pixels;
+        int width, height, channels;
+        float const *decode[4];
+
+        ByteImage(const unsigned char *pixels, int width, int height, int channels, bool srgb)
+            : pixels(pixels), width(width), height(height), channels(channels)
+        {
+            SrgbTables const &tables = srgbTables();
+            int colors = srgb ? colorChannels(channels) : 0;
+            for (int c = 0; c < 4; c++)
+                decode[c] = c < colors ? tables.toLinear : tables.linear;
+        }
+
+        const unsigned char *Row(int y) const { return pixels + static_cast<std::size_t>(y) * width * channels; }
+
+        Pixel Decode(const unsigned char *src) const
+        {
+            if (channels == 4)
+                return Pixel{{decode[0][src[0]], decode[1][src[1]], decode[2][src[2]], decode[3][src[3]]}};
+            Pixel p{{0.0f, 0.0f, 0.0f, 1.0f}};
+            for (int c = 0; c < channels; c++)
+                p.v[c] = decode[c][src[c]];
+            return p;
+        }
+    };
+
+    Plane toPlane(ByteImage const &image)
+    {
+        Plane plane(image.width, image.height);
+        forRows(image.height, image.width, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+            {
+                const unsigned char *src = image.Row(y);
+                Pixel *dst = plane.Row(y);
+                for (int x = 0; x < image.width; x++, src += image.channels)
+                    dst[x] = image.Decode(src);
+            }
+        });
+        return plane;
+    }
+
+    MipLevel toLevel(Plane const &plane, int channels, bool srgb)
+    {
+        MipLevel level;
+        level.width = plane.width;
+        level.height = plane.height;
+        level.data.resize(static_cast<std::size_t>(plane.width) * plane.height * channels);
+        SrgbTables const &tables = srgbTables();
+        int colors = srgb ? colorChannels(channels) : 0;
+        forRows(plane.height, plane.width, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+            {
+                Pixel const *src = plane.Row(y);
+                unsigned char *dst = level.data.data() + static_cast<std::size_t>(y) * plane.width * channels;
+#ifdef MIP_USE_SSE2
+                if (channels == 4 && colors == 0)
+                {
+                    // 线性RGBA: 4个通道一起转换, 饱和打包到字节
+                    __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+                    for (int x = 0; x < plane.width; x++, dst += 4)
+                    {
+                        __m128i value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(load(src[x]), scale), half));
+                        value = _mm_packs_epi32(value, value);
+                        int packed = _mm_cvtsi128_si32(_mm_packus_epi16(value, value));
+                        std::memcpy(dst, &packed, 4);
+                    }
+                    continue;
+                }
+#endif
+                for (int x = 0; x < plane.width; x++, dst += channels)
+                    for (int c = 0; c < channels; c++)
+                        dst[c] = c < colors ? encodeSrgb(tables, src[x].v[c]) : encodeLinear(src[x].v[c]);
+            }
+        });
+        return level;
+    }
+
+    void renormalize(Pixel *row, int width)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float n[3];
+            for (int k = 0; k < 3; k++)
+                n[k] = row[x].v[k] * 2.0f - 1.0f;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 1e-4f)
+                for (int k = 0; k < 3; k++)
+                    row[x].v[k] = n[k] / length * 0.5f + 0.5f;
+        }
+    }
+
+    // 2x2 平均; 奇数尺寸时最后一行/列重复采样. 第1级直接从8位输入解码, 不必先把整幅第0级转成浮点
+    void boxDownsample(ByteImage const &src, Plane &dst, bool normalMap)
+    {
+        forRows(dst.height, dst.width, [&](int begin, int end) {
+            Vec4 quarter = splat(0.25f);
+            int stride = src.channels;
+            for (int y = begin; y < end; y++)
+            {
+                const unsigned char *r0 = src.Row(std::min(y * 2, src.height - 1));
+                const unsigned char *r1 = src.Row(std::min(y * 2 + 1, src.height - 1));
+                Pixel *out = dst.Row(y);
+                for (int x = 0; x < dst.width; x++)
+                {
+                    int x0 = std::min(x * 2, src.width - 1) * stride, x1 = std::min(x * 2 + 1, src.width - 1) * stride;
+                    Vec4 sum = add(add(load(src.Decode(r0 + x0)), load(src.Decode(r0 + x1))),
+                                   add(load(src.Decode(r1 + x0)), load(src.Decode(r1 + x1))));
+                    store(out[x], mul(sum, quarter));
+                }
+                if (normalMap)
+                    renormalize(out, dst.width);
+            }
+        });
+    }
+
+    void boxDownsample(Plane const &src, Plane &dst, bool normalMap)
+    {
+        forRows(dst.height, dst.width, [&](int begin, int end) {
+            Vec4 quarter = splat(0.25f);
+            for (int y = begin; y < end; y++)
+            {
+                Pixel const *r0 = src.Row(std::min(y * 2, src.height - 1));
+                Pixel const *r1 = src.Row(std::min(y * 2 + 1, src.height - 1));
+                Pixel *out = dst.Row(y);
+                for (int x = 0; x < dst.width; x++)
+                {
+                    int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+                    Vec4 sum = add(add(load(r0[x0]), load(r0[x1])), add(load(r1[x0]), load(r1[x1])));
+                    store(out[x], mul(sum, quarter));
+                }
+                if (normalMap)
+                    renormalize(out, dst.width);
+            }
+        });
+    }
+
+    // 一维重采样核: 第i个输出像素 = sum(weights[i * taps + k] * 输入[indices[i * taps + k]])
+    struct Kernel
+    {
+        int taps = 0;
+        std::vector<int> indices;
+        std::vector<float> weights;
+    };
+
+    float besselI0(float x)
+    {
+        // 级数展开, 对 alpha = 4 足够收敛
+        float sum = 1.0f, term = 1.0f, q = x * x / 4.0f;
+        for (int k = 1; k < 20; k++)
+        {
+            term *= q / static_cast<float>(k * k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    Kernel kaiserKernel(int srcSize, int dstSize)
+    {
+        constexpr float RADIUS = 3.0f; // 以输出像素为单位
+        constexpr float ALPHA = 4.0f;
+        constexpr float PI = 3.14159265358979f;
+        float scale = static_cast<float>(srcSize) / dstSize;
+        float support = RADIUS * scale;
+
+        Kernel kernel;
+        kernel.taps = static_cast<int>(std::ceil(support * 2.0f)) + 1;
+        kernel.indices.resize(static_cast<std::size_t>(dstSize) * kernel.taps);
+        kernel.weights.resize(kernel.indices.size());
+        float i0Alpha = besselI0(ALPHA);
+        for (int i = 0; i < dstSize; i++)
+        {
+            float center = (i + 0.5f) * scale;
+            int first = static_cast<int>(std::floor(center - support));
+            float total = 0.0f;
+            for (int k = 0; k < kernel.taps; k++)
+            {
+                float t = (first + k + 0.5f - center) / scale;
+                float weight = 0.0f;
+                if (std::abs(t) < RADIUS)
+                {
+                    float sinc = t == 0.0f ? 1.0f : std::sin(PI * t) / (PI * t);
+                    float r = t / RADIUS;
+                    weight = sinc * besselI0(ALPHA * std::sqrt(1.0f - r * r)) / i0Alpha;
+                }
+                // 边缘之外的像素取最近的边缘像素
+                kernel.indices[i * kernel.taps + k] = std::clamp(first + k, 0, srcSize - 1);
+                kernel.weights[i * kernel.taps + k] = weight;
+                total += weight;
+            }
+            for (int k = 0; k < kernel.taps; k++)
+                kernel.weights[i * kernel.taps + k] /= total;
+        }
+        return kernel;
+    }
+
+    // 可分离的两遍滤波: 先水平缩到 dst.width x src.height, 再垂直缩到 dst.height
+    void kaiserDownsample(Plane const &src, Plane &dst, bool normalMap)
+    {
+        Plane horizontal;
+        Plane const *rows = &src;
+        if (dst.width != src.width)
+        {
+            Kernel kernel = kaiserKernel(src.width, dst.width);
+            horizontal = Plane(dst.width, src.height);
+            forRows(src.height, kernel.taps * dst.width, [&](int begin, int end) {
+                for (int y = begin; y < end; y++)
+                {
+                    Pixel const *in = src.Row(y);
+                    Pixel *out = horizontal.Row(y);
+                    for (int x = 0; x < dst.width; x++)
+                    {
+                        int const *indices = kernel.indices.data() + static_cast<std::size_t>(x) * kernel.taps;
+                        float const *weights = kernel.weights.data() + static_cast<std::size_t>(x) * kernel.taps;
+                        Vec4 sum = splat(0.0f);
+                        for (int k = 0; k < kernel.taps; k++)
+                            sum = add(sum, mul(load(in[indices[k]]), splat(weights[k])));
+                        store(out[x], sum);
+                    }
+                }
+            });
+            rows = &horizontal;
+        }
+
+        Kernel kernel = kaiserKernel(src.height, dst.height);
+        forRows(dst.height, kernel.taps * dst.width, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+            {
+                Pixel *out = dst.Row(y);
+                int const *indices = kernel.indices.data() + static_cast<std::size_t>(y) * kernel.taps;
+                float const *weights = kernel.weights.data() + static_cast<std::size_t>(y) * kernel.taps;
+                // 整行累加, 每次读一整行输入, 对缓存友好
+                std::fill(out, out + dst.width, Pixel{});
+                for (int k = 0; k < kernel.taps; k++)
+                {
+                    if (weights[k] == 0.0f)
+                        continue;
+                    Pixel const *in = rows->Row(indices[k]);
+                    Vec4 weight = splat(weights[k]);
+                    for (int x = 0; x < dst.width; x++)
+                        store(out[x], add(load(out[x]), mul(load(in[x]), weight)));
+                }
+                // 负瓣会越界, 截断后再作为下一级的输入
+                for (int x = 0; x < dst.width; x++)
+                    store(out[x], clamp01(load(out[x])));
+                if (normalMap)
+                    renormalize(out, dst.width);
+            }
+        });
+    }
+}
+
+int MipGenerator::LevelCount(int width, int height) noexcept
+{
+    int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<MipLevel> MipGenerator::Generate(const unsigned char *pixels, int width, int height, int channels,
+                                             MipOptions const &options)
+{
+    std::vector<MipLevel> levels;
+    if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+        return levels;
+    // 法线贴图不做sRGB转换
+    bool srgb = options.srgb && !options.normalMap;
+    levels.reserve(LevelCount(width, height) - 1);
+
+    ByteImage source(pixels, width, height, channels, srgb);
+    Plane current;
+    if (options.filter == MipFilter::Kaiser)
+        current = toPlane(source);
+    while (width > 1 || height > 1)
+    {
+        Plane next(std::max(1, width / 2), std::max(1, height / 2));
+        if (options.filter == MipFilter::Box && levels.empty())
+            boxDownsample(source, next, options.normalMap);
+        else if (options.filter == MipFilter::Box)
+            boxDownsample(current, next, options.normalMap);
+        else
+            kaiserDownsample(current, next, options.normalMap);
+        levels.push_back(toLevel(next, channels, srgb));
+        width = next.width;
+        height = next.height;
+        current = std::move(next);
+    }
+    return levels;
+}
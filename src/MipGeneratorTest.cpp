@@ -0,0 +1,111 @@
+// MipGenerator 的测试: 各级大小到 1x1 为止, 纯色图每级不变, 盒式滤波是 2x2 平均, 法线贴图每级仍是单位向量. 只用CPU
+#include <MipGenerator.h>
+#include <TestCheck.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    TestCheck check("MIPGENERATOR_TEST");
+
+    // 每级宽高是上一级的一半 (向下取整, 至少为1), 数据大小与通道数相符, 最后一级是 1x1
+    bool levelsHaveTheRightSize(std::vector<MipLevel> const &levels, int width, int height, int channels)
+    {
+        if (static_cast<int>(levels.size()) != MipGenerator::LevelCount(width, height) - 1)
+            return false;
+        for (MipLevel const &level : levels)
+        {
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            if (level.width != width || level.height != height ||
+                level.data.size() != static_cast<std::size_t>(width) * height * channels)
+                return false;
+        }
+        return levels.empty() || (levels.back().width == 1 && levels.back().height == 1);
+    }
+}
+
+int main()
+{
+    check(MipGenerator::LevelCount(1, 1) == 1, "LevelCount(1, 1) is not 1");
+    check(MipGenerator::LevelCount(256, 256) == 9, "LevelCount(256, 256) is not 9");
+    check(MipGenerator::LevelCount(256, 64) == 9, "LevelCount(256, 64) is not 9");
+    check(MipGenerator::LevelCount(5, 3) == 3, "LevelCount(5, 3) is not 3");
+
+    // 各种通道数、非2的幂和长条形的大小; 纯色图滤波后每级仍是同一颜色 (sRGB 往返最多差1)
+    const unsigned char COLOR[4] = {200, 60, 17, 128};
+    for (MipFilter filter : {MipFilter::Box, MipFilter::Kaiser})
+        for (bool srgb : {false, true})
+            for (int channels = 1; channels <= 4; channels++)
+                for (auto [width, height] : {std::pair{64, 64}, std::pair{37, 19}, std::pair{300, 1}, std::pair{1, 7}})
+                {
+                    std::vector<unsigned char> pixels(static_cast<std::size_t>(width) * height * channels);
+                    for (std::size_t i = 0; i < pixels.size(); i++)
+                        pixels[i] = COLOR[i % channels];
+                    MipOptions options;
+                    options.filter = filter;
+                    options.srgb = srgb;
+                    std::vector<MipLevel> levels = MipGenerator::Generate(pixels.data(), width, height, channels, options);
+                    check(levelsHaveTheRightSize(levels, width, height, channels), "mip levels have the wrong size");
+                    bool constant = true;
+                    for (MipLevel const &level : levels)
+                        for (std::size_t i = 0; i < level.data.size(); i++)
+                            constant = constant && std::abs(level.data[i] - COLOR[i % channels]) <= 1;
+                    check(constant, "a constant image does not stay constant");
+                }
+
+    // 盒式滤波 (线性) 的第1级是每 2x2 的平均
+    const int SIZE = 16;
+    std::vector<unsigned char> gradient(SIZE * SIZE);
+    for (int y = 0; y < SIZE; y++)
+        for (int x = 0; x < SIZE; x++)
+            gradient[y * SIZE + x] = static_cast<unsigned char>(x * 8 + y * 4);
+    MipOptions box;
+    box.filter = MipFilter::Box;
+    std::vector<MipLevel> levels = MipGenerator::Generate(gradient.data(), SIZE, SIZE, 1, box);
+    bool averaged = !levels.empty();
+    for (int y = 0; averaged && y < SIZE / 2; y++)
+        for (int x = 0; x < SIZE / 2; x++)
+        {
+            int sum = gradient[2 * y * SIZE + 2 * x] + gradient[2 * y * SIZE + 2 * x + 1] + gradient[(2 * y + 1) * SIZE + 2 * x] +
+                      gradient[(2 * y + 1) * SIZE + 2 * x + 1];
+            averaged = averaged && std::abs(levels[0].data[y * (SIZE / 2) + x] - sum / 4.0f) <= 0.5f;
+        }
+    check(averaged, "box filter level 1 is not the 2x2 average");
+
+    // 法线贴图: 相邻像素的法线方向不同, 滤波后每级重新归一化
+    std::vector<unsigned char> normals(SIZE * SIZE * 4);
+    for (int y = 0; y < SIZE; y++)
+        for (int x = 0; x < SIZE; x++)
+        {
+            float nx = (x + y) % 2 ? 0.6f : -0.6f, ny = 0.0f, nz = 0.8f;
+            unsigned char *p = &normals[(y * SIZE + x) * 4];
+            p[0] = static_cast<unsigned char>((nx * 0.5f + 0.5f) * 255.0f + 0.5f);
+            p[1] = static_cast<unsigned char>((ny * 0.5f + 0.5f) * 255.0f + 0.5f);
+            p[2] = static_cast<unsigned char>((nz * 0.5f + 0.5f) * 255.0f + 0.5f);
+            p[3] = 255;
+        }
+    for (MipFilter filter : {MipFilter::Box, MipFilter::Kaiser})
+    {
+        MipOptions options;
+        options.filter = filter;
+        options.normalMap = true;
+        std::vector<MipLevel> normalLevels = MipGenerator::Generate(normals.data(), SIZE, SIZE, 4, options);
+        bool unit = levelsHaveTheRightSize(normalLevels, SIZE, SIZE, 4);
+        for (MipLevel const &level : normalLevels)
+            for (std::size_t i = 0; i < level.data.size(); i += 4)
+            {
+                float n[3];
+                for (int k = 0; k < 3; k++)
+                    n[k] = level.data[i + k] / 255.0f * 2.0f - 1.0f;
+                unit = unit && std::abs(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) - 1.0f) < 0.02f;
+            }
+        check(unit, "normal map levels are not unit length");
+    }
+
+    return check.Finish("MipGenerator");
+}
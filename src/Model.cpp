@@ -1,50 +1,661 @@
 #include "Model.h"
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+#include "TextureManager.h"
 
-unsigned int TextureFromFile(const char *path, const std::string &directory);
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+TextureHandle TextureFromFile(const char *path, const std::string &directory,
+                              TextureCompression compression = TextureCompression::None,
+                              TextureUsage usage = TextureUsage::Color);
+
+// 进程内纹理缓存的累计统计
+static void reportTextures()
+{
+    TextureManager::Stats stats = TextureManager::Instance().GetStats();
+    std::cout << "TextureManager: " << stats.resident << " resident (" << stats.residentBytes / (1024.0 * 1024.0)
+              << " MB), " << stats.decodes << " PNG decodes, " << stats.cooked << " compressed, "
+              << stats.cookedCacheHits << " from texture cache (" << stats.decodeMs << " ms on workers), " << stats.uploads << " uploads (" << stats.uploadMs
+              << " ms on GL thread, PBO stalls " << stats.ring.stallMs << " ms, worst " << stats.ring.maxStallMs
+              << " ms), " << stats.hits << " hits" << std::endl;
+}
+
+// 异步加载时工作线程与GL线程之间共享的状态
+struct Model::PendingLoad
+{
+    std::mutex mutex;
+    bool geometryReady = false;
+    bool failed = false;
+    std::unordered_map<std::string, std::shared_ptr<DecodedImage>> images; // 按材质中的相对路径, 已驻留的纹理为空
+    std::size_t textureFiles = 0; // 需要解码的纹理文件数, 打包纹理数组要等全部解码完
+
+    // 以下在 geometryReady 之后只由GL线程访问
+    std::vector<MeshData> meshData;
+    std::vector<MaterialData> materials;
+    std::size_t nextMesh = 0;
+    std::string path;
+    const char *source = "";
+    std::chrono::steady_clock::time_point start;
+    double updateMs = 0.0;    // Update 在GL线程上的累计时间
+    double maxUpdateMs = 0.0; // 单帧最长
+};
+
+Model::~Model()
+{
+    for (Mesh &mesh : meshes)
+        mesh.ReleaseGeometry();
+}
 
 void Model::Draw(ShaderProgram &shader)
 {
+    // 没有相机信息, 纹理按最清晰的一级请求
     for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        meshes[i].RequestTextureMips(0.0f);
         meshes[i].Draw(shader);
+    }
+}
+
+void Model::DrawInstanced(ShaderProgram &shader, InstanceBatch const &batch, unsigned int lod)
+{
+    // 实例分布在整个场景中, 纹理按最清晰的一级请求
+    for (Mesh &mesh : meshes)
+    {
+        mesh.RequestTextureMips(0.0f);
+        mesh.DrawInstanced(shader, batch, lod);
+    }
+}
+
+void Model::DrawInstanced(ShaderProgram &shader, InstanceBatch const &batch, std::vector<InstanceData> const &instances,
+                          Camera const &camera, float viewportHeight)
+{
+    float projScale = projectionScale(camera, viewportHeight);
+    std::size_t count = std::min(instances.size(), batch.Count());
+    if (count == 0)
+        return;
+    instanceLods.resize(count);
+    for (Mesh &mesh : meshes)
+    {
+        // 与 Draw 相同的逐网格LOD选择; 纹理按最近的实例请求, 相机在某个实例的包围球内时请求最清晰的一级
+        float nearestPixels = 0.0f;
+        bool inside = false;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            MeshExtent extent = measureMesh(mesh, instances[i].model, camera.GetPosition(), projScale);
+            inside = inside || extent.pixelsPerUnit <= 0.0f;
+            nearestPixels = std::max(nearestPixels, extent.pixelsPerUnit);
+            instanceLods[i] = selectLod(mesh, extent.pixelsPerUnit);
+        }
+        mesh.RequestTextureMips(inside ? 0.0f : nearestPixels);
+        std::size_t first = 0;
+        for (std::size_t i = 1; i <= count; i++)
+        {
+            if (i == count || instanceLods[i] != instanceLods[first])
+            {
+                mesh.DrawInstanced(shader, batch, instanceLods[first], first, i - first);
+                first = i;
+            }
+        }
+    }
+}
+
+void Model::Draw(ShaderProgram &shader, Camera const &camera, glm::mat4 const &projection, glm::mat4 const &model,
+                 float viewportHeight)
+{
+    float projScale = projectionScale(camera, viewportHeight);
+    // 网格簇剔除在物体空间进行, 省去逐簇变换包围球
+    Frustum frustum(projection * camera.GetViewMatrix() * model);
+    glm::vec3 localEye = glm::vec3(glm::inverse(model) * glm::vec4(camera.GetPosition(), 1.0f));
+    // 视锥外的网格不绘制, 也不请求纹理, 看不到的纹理过一段时间后被淘汰
+    cullMeshes(frustum, model);
+    for (std::uint32_t i : visibleMeshes)
+    {
+        Mesh &mesh = meshes[i];
+        MeshExtent extent = measureMesh(mesh, model, camera.GetPosition(), projScale);
+        mesh.RequestTextureMips(extent.pixelsPerUnit);
+        unsigned int lod = selectLod(mesh, extent.pixelsPerUnit);
+        if (lod == 0 && clusterCulling && mesh.HasMeshlets())
+            mesh.DrawClusters(shader, frustum, localEye);
+        else
+            mesh.Draw(shader, lod);
+    }
+}
+
+void Model::Enqueue(RenderQueue &queue, ShaderProgram &shader, Camera const &camera, glm::mat4 const &projection,
+                    glm::mat4 const &model, float viewportHeight)
+{
+    float projScale = projectionScale(camera, viewportHeight);
+    Frustum frustum(projection * camera.GetViewMatrix() * model);
+    cullMeshes(frustum, model);
+    for (std::uint32_t i : visibleMeshes)
+    {
+        Mesh &mesh = meshes[i];
+        MeshExtent extent = measureMesh(mesh, model, camera.GetPosition(), projScale);
+        mesh.RequestTextureMips(extent.pixelsPerUnit);
+        unsigned int lod = selectLod(mesh, extent.pixelsPerUnit);
+        bool clusters = lod == 0 && clusterCulling && mesh.HasMeshlets();
+        queue.Push(RenderQueue::Layer::Opaque, shader, mesh, lod, model, extent.distance, clusters);
+    }
+}
+
+void Model::AddDrawCommands(DrawCommandBuffer &commands, Camera const &camera, glm::mat4 const &projection, glm::mat4 const &model,
+                            float viewportHeight, std::uint32_t material)
+{
+    float projScale = projectionScale(camera, viewportHeight);
+    Frustum frustum(projection * camera.GetViewMatrix() * model);
+    cullMeshes(frustum, model);
+    for (std::uint32_t i : visibleMeshes)
+    {
+        Mesh &mesh = meshes[i];
+        MeshExtent extent = measureMesh(mesh, model, camera.GetPosition(), projScale);
+        mesh.RequestTextureMips(extent.pixelsPerUnit);
+        commands.Add(mesh, selectLod(mesh, extent.pixelsPerUnit), model, material);
+    }
+}
+
+void Model::cullMeshes(Frustum const &frustum, glm::mat4 const &model)
+{
+    // 网格只有几个到几十个, 不值得分给工作线程
+    if (frustumCulling)
+        meshBounds.Cull(frustum, visibleMeshes, false);
+    else
+    {
+        visibleMeshes.resize(meshes.size());
+        for (std::size_t i = 0; i < meshes.size(); i++)
+            visibleMeshes[i] = static_cast<std::uint32_t>(i);
+    }
+    if (occlusionCuller)
+        visibleMeshes.erase(std::remove_if(visibleMeshes.begin(), visibleMeshes.end(),
+                                           [&](std::uint32_t i) {
+                                               return occlusionCuller->IsOccluded(meshes[i].GetBoundsMin(), meshes[i].GetBoundsMax(), model);
+                                           }),
+                            visibleMeshes.end());
+}
+
+void Model::AddOccluders(OcclusionCuller &occlusion, glm::mat4 const &model, unsigned int lod) const
+{
+    for (Mesh const &mesh : meshes)
+    {
+        // 空网格没有可取地址的顶点
+        MeshLod const &range = mesh.GetLod(std::min<std::size_t>(lod, mesh.LodCount() - 1));
+        if (mesh.GetVertices().empty() || range.indexCount == 0)
+            continue;
+        occlusion.AddOccluder(&mesh.GetVertices()[0].Position, sizeof(Vertex), mesh.GetIndices().data() + range.indexOffset,
+                              range.indexCount, model);
+    }
+}
+
+void Model::AddOccluders(OcclusionCuller &occlusion, glm::mat4 const &model, Camera const &camera) const
+{
+    // 与 Draw 相同的投影误差估计, 只是换成遮挡缓冲的分辨率
+    float projScale = projectionScale(camera, static_cast<float>(occlusion.GetHeight()));
+    for (Mesh const &mesh : meshes)
+    {
+        MeshExtent extent = measureMesh(mesh, model, camera.GetPosition(), projScale);
+        MeshLod const &range = mesh.GetLod(coarsestLod(mesh, extent.pixelsPerUnit, 1.0f));
+        if (mesh.GetVertices().empty() || range.indexCount == 0)
+            continue;
+        occlusion.AddOccluder(&mesh.GetVertices()[0].Position, sizeof(Vertex), mesh.GetIndices().data() + range.indexOffset,
+                              range.indexCount, model);
+    }
+}
+
+float Model::projectionScale(Camera const &camera, float viewportHeight) noexcept
+{
+    return viewportHeight * 0.5f / std::tan(glm::radians(camera.GetZoom()) * 0.5f);
+}
+
+Model::MeshExtent Model::measureMesh(Mesh const &mesh, glm::mat4 const &model, glm::vec3 const &eye, float projScale) noexcept
+{
+    // 物体空间误差 e 在距离 d 处投影为 e * scale / d * projScale 像素, scale 取模型矩阵最大的轴缩放
+    float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+    glm::vec3 center = glm::vec3(model * glm::vec4(mesh.GetBoundsCenter(), 1.0f));
+    float distance = glm::length(center - eye) - mesh.GetBoundsRadius() * scale;
+    return MeshExtent{distance, distance > 0.0f ? scale / distance * projScale : 0.0f};
+}
+
+unsigned int Model::selectLod(Mesh const &mesh, float pixelsPerUnit) const noexcept
+{
+    if (!lodEnabled)
+        return 0;
+    return coarsestLod(mesh, pixelsPerUnit, lodErrorPixels);
+}
+
+unsigned int Model::coarsestLod(Mesh const &mesh, float pixelsPerUnit, float maxErrorPixels) noexcept
+{
+    if (pixelsPerUnit <= 0.0f)
+        return 0;
+    for (std::size_t l = mesh.LodCount(); l-- > 1;)
+    {
+        if (mesh.GetLod(l).error * pixelsPerUnit <= maxErrorPixels)
+            return static_cast<unsigned int>(l);
+    }
+    return 0;
 }
 
 void Model::loadModel(std::string const &path)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<MeshData> meshData;
+    std::vector<MaterialData> materials;
+    const char *source;
+    if (!importGeometry(path, options, meshData, materials, source))
+        return;
+    auto imported = std::chrono::steady_clock::now();
+
+    directory = path.substr(0, path.find_last_of('\\'));
+
+    // 所有纹理先在线程池上并行解码, GL线程只做上传
+    std::vector<Texture> files = collectTextureFiles(materials);
+    std::vector<std::shared_ptr<DecodedImage>> decoded(files.size());
+    auto decode = [&](std::size_t i) {
+        std::string file = directory + '\\' + files[i].path;
+        TextureCompression compression = textureCompression(files[i], options);
+        TextureUsage usage = textureUsage(files[i]);
+        decoded[i] = options.textureArrays && packsIntoArray(files[i])
+                         ? TextureManager::Instance().DecodeLayer(file, compression, usage)
+                         : TextureManager::Instance().Decode(file, SamplerParams(), compression, usage);
+    };
+    if (options.parallelImport && files.size() > 1)
+        ThreadPool::Global().ParallelFor(files.size(), decode);
+    else
+        for (std::size_t i = 0; i < files.size(); i++)
+            decode(i);
+    std::unordered_map<std::string, std::shared_ptr<DecodedImage>> images;
+    for (std::size_t i = 0; i < files.size(); i++)
+        images[files[i].path] = std::move(decoded[i]);
+    auto texturesDecoded = std::chrono::steady_clock::now();
+    if (options.textureArrays)
+        buildTextureArrays(files, images);
+
+    meshes.reserve(meshData.size());
+    for (auto &data : meshData)
+    {
+        MaterialData const &material = materials[data.materialIndex];
+        std::vector<std::shared_ptr<DecodedImage>> materialImages;
+        for (auto const &texture : material.textures)
+            materialImages.push_back(images[texture.path]);
+        addMesh(data, loadMaterialTextures(material, &materialImages));
+    }
+    auto finished = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::milli> importTime = imported - start;
+    std::chrono::duration<double, std::milli> decodeTime = texturesDecoded - imported;
+    std::chrono::duration<double, std::milli> uploadTime = finished - texturesDecoded;
+    std::chrono::duration<double, std::milli> totalTime = finished - start;
+    std::cout << "Model: " << path << " [" << source << "] geometry " << importTime.count()
+              << " ms, texture decode " << decodeTime.count() << " ms (" << files.size() << " files, "
+              << (options.parallelImport ? ThreadPool::Global().Size() : 1u) << " threads), upload "
+              << uploadTime.count() << " ms, total " << totalTime.count() << " ms" << std::endl;
+    reportVertexMemory(path);
+    reportTextures();
+}
+
+void Model::addMesh(MeshData &data, std::vector<Texture> textures)
+{
+    VertexFormat format = VertexFormat::Float;
+    if (options.packVertices)
+        format = data.skinned ? VertexFormat::PackedSkinned : VertexFormat::Packed;
+    meshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(textures), format,
+                        std::move(data.lods), std::move(data.meshlets), options.geometryPool, options.closedMeshes);
+    Mesh const &mesh = meshes.back();
+    meshBounds.Add(mesh.GetBoundsMin(), mesh.GetBoundsMax());
+    boundsMin = meshes.size() == 1 ? mesh.GetBoundsMin() : glm::min(boundsMin, mesh.GetBoundsMin());
+    boundsMax = meshes.size() == 1 ? mesh.GetBoundsMax() : glm::max(boundsMax, mesh.GetBoundsMax());
+}
+
+void Model::reportVertexMemory(std::string const &path) const
+{
+    std::size_t vertexCount = 0, floatBytes = 0, uploadedBytes = 0;
+    for (auto const &mesh : meshes)
+    {
+        vertexCount += mesh.VertexCount();
+        floatBytes += mesh.VertexCount() * sizeof(Vertex);
+        uploadedBytes += mesh.VertexBufferBytes();
+    }
+    std::cout << "Model: " << path << " vertex memory " << floatBytes / 1024.0 << " KB (Vertex) -> "
+              << uploadedBytes / 1024.0 << " KB (" << (options.packVertices ? "packed" : "float") << "), "
+              << vertexCount << " vertices" << std::endl;
+}
+
+bool Model::importGeometry(std::string const &path, ModelLoadOptions const &options,
+                           std::vector<MeshData> &meshData, std::vector<MaterialData> &materials, const char *&source)
+{
+    bool objFastPath = useObjFastPath(path, options);
+    unsigned int optimizedKey = (options.optimizeMeshes ? OPTIMIZED_KEY : 0u) | (options.generateLods ? LOD_KEY : 0u) |
+                                (options.buildMeshlets ? MESHLET_KEY : 0u);
+    unsigned int cacheKey = IMPORT_FLAGS | optimizedKey | (objFastPath ? OBJ_FAST_PATH_KEY : 0u);
+    // 先尝试二进制缓存, 未命中时才解析源文件
+    if (MeshCache::Load(path, cacheKey, meshData, materials))
+    {
+        source = "warm, mesh cache";
+        return true;
+    }
+    if (objFastPath && !ObjLoader::Load(path, meshData, materials, options.parallelImport))
+    {
+        std::cout << "WARNING::OBJLOADER::falling back to Assimp for " << path << std::endl;
+        // 仍按查找时的键保存, 下次启动直接命中, 不再重复解析
+        objFastPath = false;
+    }
+    if (!objFastPath && !importScene(path, options, meshData, materials))
+        return false;
+    if (options.optimizeMeshes)
+        optimizeMeshes(path, options, meshData);
+    if (options.generateLods)
+        generateLods(path, options, meshData);
+    if (options.buildMeshlets)
+        buildMeshlets(path, options, meshData);
+    if (!MeshCache::Save(path, cacheKey, meshData, materials))
+        std::cout << "WARNING::MESHCACHE::could not write " << MeshCache::CachePath(path) << std::endl;
+    source = objFastPath ? "cold, OBJ fast path" : "cold, Assimp";
+    return true;
+}
+
+std::shared_ptr<Model> Model::LoadAsync(std::string const &path, ModelLoadOptions const &options)
+{
+    std::shared_ptr<Model> model(new Model(AsyncTag{}, options));
+    model->directory = path.substr(0, path.find_last_of('\\'));
+    auto pending = std::make_shared<PendingLoad>();
+    pending->path = path;
+    pending->start = std::chrono::steady_clock::now();
+    model->pending = pending;
+
+    // 工作线程只持有共享状态, 模型句柄提前销毁也不会悬空
+    std::string directory = model->directory;
+    ThreadPool::Global().Submit([pending, path, options, directory]() {
+        std::vector<MeshData> meshData;
+        std::vector<MaterialData> materials;
+        const char *source;
+        if (!importGeometry(path, options, meshData, materials, source))
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            pending->failed = true;
+            return;
+        }
+
+        std::vector<Texture> files = collectTextureFiles(materials);
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            pending->meshData = std::move(meshData);
+            pending->materials = std::move(materials);
+            pending->source = source;
+            pending->textureFiles = files.size();
+            pending->geometryReady = true;
+        }
+
+        // 每个纹理一个解码任务, 其他模型已经载入或正在解码的纹理不会重复解码
+        for (auto const &file : files)
+        {
+            TextureCompression compression = textureCompression(file, options);
+            TextureUsage usage = textureUsage(file);
+            bool arrays = options.textureArrays && packsIntoArray(file);
+            ThreadPool::Global().Submit([pending, file, directory, compression, usage, arrays]() {
+                std::string path = directory + '\\' + file.path;
+                std::shared_ptr<DecodedImage> image = arrays ? TextureManager::Instance().DecodeLayer(path, compression, usage)
+                                                             : TextureManager::Instance().Decode(path, SamplerParams(), compression, usage);
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                pending->images[file.path] = std::move(image);
+            });
+        }
+    });
+    return model;
+}
+
+std::vector<Texture> Model::collectTextureFiles(std::vector<MaterialData> const &materials)
+{
+    std::vector<Texture> files;
+    for (auto const &material : materials)
+        for (auto const &texture : material.textures)
+            if (std::none_of(files.begin(), files.end(), [&](Texture const &file) { return file.path == texture.path; }))
+                files.push_back(texture);
+    return files;
+}
+
+TextureCompression Model::textureCompression(Texture const &texture, ModelLoadOptions const &options)
+{
+    if (!options.compressTextures)
+        return TextureCompression::None;
+    return texture.type == "texture_normal" ? TextureCompression::NormalMap : TextureCompression::Color;
+}
+
+bool Model::packsIntoArray(Texture const &texture)
+{
+    return texture.type == "texture_diffuse";
+}
+
+TextureUsage Model::textureUsage(Texture const &texture)
+{
+    if (texture.type == "texture_diffuse")
+        return TextureUsage::Color;
+    return texture.type == "texture_normal" ? TextureUsage::NormalMap : TextureUsage::Data;
+}
+
+bool Model::Update(double budgetMs)
+{
+    if (!pending)
+        return true;
+    auto frameStart = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        if (pending->failed)
+        {
+            pending.reset();
+            return true;
+        }
+        if (!pending->geometryReady)
+            return false;
+    }
+    // 纹理数组要知道所有同尺寸的纹理, 等全部解码完后一次打包
+    if (options.textureArrays && pending->nextMesh == 0 && arrayLayers.empty())
+    {
+        std::unordered_map<std::string, std::shared_ptr<DecodedImage>> images;
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            if (pending->images.size() < pending->textureFiles)
+                return false;
+            images = pending->images;
+        }
+        buildTextureArrays(collectTextureFiles(pending->materials), images);
+    }
+
+    // 按顺序上传, 网格的纹理全部解码完才能上传; 每上传一个网格检查一次预算
+    while (pending->nextMesh < pending->meshData.size())
+    {
+        MeshData &data = pending->meshData[pending->nextMesh];
+        MaterialData const &material = pending->materials[data.materialIndex];
+        std::vector<std::shared_ptr<DecodedImage>> images;
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            for (auto const &texture : material.textures)
+            {
+                auto it = pending->images.find(texture.path);
+                if (it == pending->images.end())
+                    return false;
+                images.push_back(it->second);
+            }
+        }
+        addMesh(data, loadMaterialTextures(material, &images));
+        pending->nextMesh++;
+
+        std::chrono::duration<double, std::milli> spent = std::chrono::steady_clock::now() - frameStart;
+        if (spent.count() >= budgetMs)
+            break;
+    }
+    // 这一帧在GL线程上花掉的时间, 即加载给渲染线程带来的卡顿
+    std::chrono::duration<double, std::milli> spent = std::chrono::steady_clock::now() - frameStart;
+    pending->updateMs += spent.count();
+    pending->maxUpdateMs = std::max(pending->maxUpdateMs, spent.count());
+    if (pending->nextMesh < pending->meshData.size())
+        return false;
+
+    std::chrono::duration<double, std::milli> totalTime = std::chrono::steady_clock::now() - pending->start;
+    std::cout << "Model: " << pending->path << " [" << pending->source << ", async] resident after "
+              << totalTime.count() << " ms, GL thread " << pending->updateMs << " ms in Update, worst frame "
+              << pending->maxUpdateMs << " ms" << std::endl;
+    reportVertexMemory(pending->path);
+    reportTextures();
+    pending.reset();
+    return true;
+}
+
+void Model::optimizeMeshes(std::string const &path, ModelLoadOptions const &options, std::vector<MeshData> &meshData)
+{
+    std::vector<MeshOptimizer::CacheStats> before(meshData.size()), after(meshData.size());
+    auto optimize = [&](std::size_t i) {
+        before[i] = MeshOptimizer::AnalyzeVertexCache(meshData[i].indices, meshData[i].vertices.size());
+        MeshOptimizer::Optimize(meshData[i]);
+        after[i] = MeshOptimizer::AnalyzeVertexCache(meshData[i].indices, meshData[i].vertices.size());
+    };
+    if (options.parallelImport && meshData.size() > 1)
+        ThreadPool::Global().ParallelFor(meshData.size(), optimize);
+    else
+        for (std::size_t i = 0; i < meshData.size(); i++)
+            optimize(i);
+
+    // 整个模型的 ACMR/ATVR (FIFO, 缓存大小 MeshOptimizer::CACHE_SIZE)
+    auto total = [](std::vector<MeshOptimizer::CacheStats> const &stats) {
+        std::size_t misses = 0, triangles = 0, vertices = 0;
+        for (auto const &s : stats)
+        {
+            misses += s.misses;
+            triangles += s.triangles;
+            vertices += s.vertices;
+        }
+        return std::make_pair(triangles ? float(misses) / float(triangles) : 0.0f, vertices ? float(misses) / float(vertices) : 0.0f);
+    };
+    auto [acmrBefore, atvrBefore] = total(before);
+    auto [acmrAfter, atvrAfter] = total(after);
+    std::cout << "MeshOptimizer: " << path << " ACMR " << acmrBefore << " -> " << acmrAfter
+              << ", ATVR " << atvrBefore << " -> " << atvrAfter << std::endl;
+}
+
+void Model::generateLods(std::string const &path, ModelLoadOptions const &options, std::vector<MeshData> &meshData)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (options.parallelImport && meshData.size() > 1)
+        ThreadPool::Global().ParallelFor(meshData.size(), [&](std::size_t i) { MeshOptimizer::GenerateLods(meshData[i]); });
+    else
+        for (auto &mesh : meshData)
+            MeshOptimizer::GenerateLods(mesh);
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+
+    // 每一级的三角形总数, 网格LOD级数不足时按它最粗的一级计; 没有LOD的网格按整个索引缓冲计
+    std::size_t levels = std::size(MeshOptimizer::LOD_RATIOS) + 1;
+    std::vector<std::size_t> triangles(levels, 0);
+    for (auto const &mesh : meshData)
+        for (std::size_t l = 0; l < levels; l++)
+            triangles[l] += (mesh.lods.empty() ? mesh.indices.size() : mesh.lods[std::min(l, mesh.lods.size() - 1)].indexCount) / 3;
+    std::cout << "LOD: " << path << " triangles";
+    for (std::size_t l = 0; l < levels; l++)
+        std::cout << (l ? " / " : " ") << triangles[l];
+    std::cout << " (" << time.count() << " ms)" << std::endl;
+}
+
+void Model::buildMeshlets(std::string const &path, ModelLoadOptions const &options, std::vector<MeshData> &meshData)
+{
+    // 按簇重排后LOD0的顶点缓存未命中数, 与重排前对比
+    std::vector<std::size_t> missesBefore(meshData.size()), missesAfter(meshData.size());
+    auto lod0Misses = [](MeshData const &mesh) {
+        std::size_t count = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+        std::vector<unsigned int> lod0(mesh.indices.begin(), mesh.indices.begin() + count);
+        return MeshOptimizer::AnalyzeVertexCache(lod0, mesh.vertices.size()).misses;
+    };
+    auto build = [&](std::size_t i) {
+        missesBefore[i] = lod0Misses(meshData[i]);
+        MeshOptimizer::BuildMeshlets(meshData[i]);
+        missesAfter[i] = lod0Misses(meshData[i]);
+    };
+    if (options.parallelImport && meshData.size() > 1)
+        ThreadPool::Global().ParallelFor(meshData.size(), build);
+    else
+        for (std::size_t i = 0; i < meshData.size(); i++)
+            build(i);
+
+    std::size_t meshlets = 0, triangles = 0, before = 0, after = 0;
+    for (std::size_t i = 0; i < meshData.size(); i++)
+    {
+        meshlets += meshData[i].meshlets.size();
+        for (auto const &meshlet : meshData[i].meshlets)
+            triangles += meshlet.triangleCount;
+        before += missesBefore[i];
+        after += missesAfter[i];
+    }
+    std::cout << "Meshlets: " << path << " " << meshlets << " clusters, "
+              << (meshlets ? float(triangles) / float(meshlets) : 0.0f) << " triangles/cluster, LOD0 ACMR "
+              << (triangles ? float(before) / float(triangles) : 0.0f) << " -> " << (triangles ? float(after) / float(triangles) : 0.0f)
+              << std::endl;
+}
+
+bool Model::useObjFastPath(std::string const &path, ModelLoadOptions const &options)
+{
+    if (!options.objFastPath || path.size() < 4)
+        return false;
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".obj";
+}
+
+bool Model::importScene(std::string const &path, ModelLoadOptions const &options,
+                        std::vector<MeshData> &meshData, std::vector<MaterialData> &materials)
 {
     Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    const aiScene *scene = importer.ReadFile(path, IMPORT_FLAGS);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-        return;
+        return false;
     }
-    directory = path.substr(0, path.find_last_of('\\'));
 
-    processNode(scene->mRootNode, scene);
+    // 先遍历一次场景得到网格工作列表, 顺序与串行递归一致
+    std::vector<aiMesh *> work;
+    processNode(scene->mRootNode, scene, work);
+
+    // 每个网格的顶点/索引转换互相独立, 按下标写回保证结果确定
+    meshData.resize(work.size());
+    if (options.parallelImport && work.size() > 1)
+        ThreadPool::Global().ParallelFor(work.size(), [&](std::size_t i) { meshData[i] = processMesh(work[i]); });
+    else
+        for (std::size_t i = 0; i < work.size(); i++)
+            meshData[i] = processMesh(work[i]);
+
+    materials.reserve(scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        materials.push_back(processMaterial(scene->mMaterials[i]));
+    return true;
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene)
+void Model::processNode(aiNode *node, const aiScene *scene, std::vector<aiMesh *> &work)
 {
-    // 获取并处理节点所有的网格（如果有的话）
+    // 获取节点所有的网格（如果有的话）
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        work.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
     // 接下来对它的子节点重复这一过程
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, work);
     }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+MeshData Model::processMesh(aiMesh *mesh)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
+        Vertex vertex{}; // 值初始化, 没有骨骼的网格写入缓存时也是确定的字节
         // 处理顶点位置、法线和纹理坐标
         // position
         glm::vec3 vector;
@@ -91,95 +702,133 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
-    // 处理材质
-    aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+    // 骨骼权重: 每个顶点最多 MAX_BONE_INFLUENCE 个, 骨骼ID为在该网格中的序号
+    bool skinned = mesh->HasBones();
+    for (unsigned int b = 0; b < mesh->mNumBones; b++)
+    {
+        aiBone *bone = mesh->mBones[b];
+        for (unsigned int w = 0; w < bone->mNumWeights; w++)
+        {
+            Vertex &vertex = vertices[bone->mWeights[w].mVertexId];
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            {
+                if (vertex.m_Weights[k] == 0.0f)
+                {
+                    vertex.m_BoneIDs[k] = static_cast<int>(b);
+                    vertex.m_Weights[k] = bone->mWeights[w].mWeight;
+                    break;
+                }
+            }
+        }
+    }
+    // 材质在 processMaterial 中统一处理, 这里只记录索引
+    return MeshData{std::move(vertices), std::move(indices), mesh->mMaterialIndex, skinned, {}, {}};
+}
+
+// 处理材质: 只记录纹理类型和路径, 真正的加载在 loadMaterialTextures 中完成
+MaterialData Model::processMaterial(aiMaterial *material)
+{
+    MaterialData data;
     // diffuse: texture_diffuseN
     // specular: texture_specularN
     // normal: texture_normalN
     // 1. diffuse maps
-    std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
     // 2. specular maps
-    std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
     // 3. normal maps
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
     // 4. height maps
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-    return Mesh(vertices, indices, textures);
+    collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
+    return data;
 }
 
-//遍历给定纹理类型的所有纹理位置，获取纹理的文件位置，并加载并生成了纹理
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName)
+//遍历给定纹理类型的所有纹理位置，获取纹理的文件位置
+void Model::collectMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, std::vector<Texture> &textures)
 {
-    std::vector<Texture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        Texture texture{};
+        texture.type = typeName;
+        texture.path = str.C_Str();
+        textures.push_back(texture);
+    }
+}
+
+//加载材质引用的纹理并生成纹理对象, 去重由 TextureManager 负责
+std::vector<Texture> Model::loadMaterialTextures(MaterialData const &material,
+                                                 std::vector<std::shared_ptr<DecodedImage>> const *images)
+{
+    std::vector<Texture> textures;
+    for (std::size_t i = 0; i < material.textures.size(); i++)
+    {
+        Texture texture = material.textures[i];
+        auto layer = arrayLayers.find(texture.path);
+        if (layer != arrayLayers.end())
         {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
+            texture.handle = layer->second.array;
+            texture.layer = layer->second.layer;
         }
-        if (!skip)
-        { // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture); // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        else if (images)
+            texture.handle = TextureManager::Instance().Upload(directory + '\\' + texture.path, (*images)[i], SamplerParams(),
+                                                               textureCompression(texture, options), textureUsage(texture));
+        else
+            texture.handle = TextureFromFile(texture.path.c_str(), this->directory, textureCompression(texture, options),
+                                             textureUsage(texture));
+        if (!texture.handle)
+        {
+            std::cout << "ERROR::MODEL::no texture for " << texture.path << ", skipping it" << std::endl;
+            continue;
         }
+        texture.id = texture.handle->id;
+        textures.push_back(std::move(texture));
     }
     return textures;
 }
 
-unsigned int TextureFromFile(const char *path, const std::string &directory)
+void Model::buildTextureArrays(std::vector<Texture> const &files,
+                               std::unordered_map<std::string, std::shared_ptr<DecodedImage>> const &images)
 {
-    std::string filename = std::string(path);
-    filename = directory + '\\' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // GL 3.3 保证的最少层数
+    const std::size_t MAX_LAYERS = 256;
+    struct Group
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        std::vector<std::string> paths;
+        std::vector<std::shared_ptr<DecodedImage>> layers;
+    };
+    std::vector<Group> groups;
+    for (auto const &file : files)
+    {
+        if (!packsIntoArray(file))
+            continue;
+        auto it = images.find(file.path);
+        if (it == images.end() || !it->second || (!it->second->data && !it->second->compressed.format))
+            continue; // 解码失败, 留给 loadMaterialTextures 报错
+        std::shared_ptr<DecodedImage> const &image = it->second;
+        auto group = std::find_if(groups.begin(), groups.end(), [&](Group const &group) {
+            return group.layers.size() < MAX_LAYERS && TextureManager::CanShareArray(*group.layers[0], *image);
+        });
+        if (group == groups.end())
+            group = groups.insert(groups.end(), Group());
+        group->paths.push_back(file.path);
+        group->layers.push_back(image);
     }
-    else
+    for (auto const &group : groups)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        TextureHandle array = TextureManager::Instance().UploadArray(group.layers, SamplerParams(), group.layers[0]->compression,
+                                                                     group.layers[0]->usage);
+        if (!array)
+            continue;
+        for (std::size_t i = 0; i < group.paths.size(); i++)
+            arrayLayers[group.paths[i]] = ArrayLayer{array, static_cast<int>(i)};
     }
+}
 
-    return textureID;
-}
\ No newline at end of file
+TextureHandle TextureFromFile(const char *path, const std::string &directory, TextureCompression compression, TextureUsage usage)
+{
+    std::string filename = std::string(path);
+    filename = directory + '\\' + filename;
+    return TextureManager::Instance().Load(filename, SamplerParams(), compression, usage);
+}
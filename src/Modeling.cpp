@@ -3,12 +3,22 @@
 #include <iostream>
 #include <Shader.h>
 #include <Camera.h>
+#include <GLState.h>
+#include <DrawCommandBuffer.h>
+#include <FrustumCuller.h>
+#include <InstanceBatch.h>
 #include <Model.h>
+#include <OcclusionCuller.h>
+#include <RenderQueue.h>
+#include <RenderStats.h>
 #include <stb_image.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow *window, double xposIn, double yposIn);
@@ -28,8 +38,51 @@ float lastY = SCR_HEIGHT / 2.0f;
 float deltaTime = 0.0f; // 当前帧与上一帧的时间差
 float lastFrame = 0.0f; // 上一帧的时间
 
-int main()
+// 调试模式 (命令行参数 --debug): 每秒打印一次平均每帧的统计, 并可以用下面各项注释里的按键切换优化.
+// 默认关闭, 示例只响应移动和鼠标
+bool debugMode = false;
+
+// LOD: 按 L 键切换, 对比每帧三角形数; 网格簇剔除: 按 C 键切换; 网格和实例的视锥剔除: 按 F 键切换
+bool useLod = true;
+bool useClusterCulling = true;
+bool useFrustumCulling = true;
+// 沿 -z 方向排列的模型副本 GRID_SIZE x GRID_SIZE, 第一个仍在原点
+const int GRID_SIZE = 5;
+const float GRID_SPACING = 10.0f;
+// 实例化模式: 按 I 键切换, 画 INSTANCED_GRID_SIZE x INSTANCED_GRID_SIZE 个带颜色的副本, 每个网格一次绘制
+bool useInstancing = false;
+const int INSTANCED_GRID_SIZE = 32;
+// 合并绘制: 按 M 键切换, 同样的 GRID_SIZE x GRID_SIZE 场景由 DrawCommandBuffer 按材质分组提交
+bool useMultiDraw = false;
+// 排序的渲染队列: 按 Q 键切换, 关掉时按模型和网格的原始顺序直接绘制
+bool useRenderQueue = true;
+// CPU遮挡剔除: 按 O 键打开, 视锥内各副本的最粗一级LOD作遮挡物, 在视锥剔除之后再去掉被挡住的网格或实例.
+// 这个场景里被挡住的不多, 光栅化遮挡物的时间比省下的绘制多, 所以默认关闭
+bool useOcclusionCulling = false;
+
+// 调试模式下累加的每帧统计, 每秒打印一次平均值后清零
+struct FrameReport
+{
+    std::size_t frames = 0, triangles = 0;
+    std::size_t tested = 0, frustumCulled = 0, backfaceCulled = 0;
+    std::size_t binds = 0, uniforms = 0, lookups = 0;
+    std::size_t stateCalls = 0, stateFiltered = 0;
+    std::size_t drawCalls = 0, queued = 0;
+    std::size_t boundsTested = 0, boundsVisible = 0;
+    std::size_t occlusionTested = 0, occluded = 0, occluderTriangles = 0;
+    double sortMs = 0.0, cullMs = 0.0, occlusionMs = 0.0;
+    double cpuMs = 0.0;
+
+    void Add(RenderStats const &stats, OcclusionCuller::Stats const *occlusion);
+    void Print() const;
+};
+
+int main(int argc, char **argv)
 {
+    for (int i = 1; i < argc; i++)
+        if (std::strcmp(argv[i], "--debug") == 0)
+            debugMode = true;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -55,11 +108,44 @@ int main()
         return -1;
     }
     stbi_set_flip_vertically_on_load(false);
-    glEnable(GL_DEPTH_TEST);
+    GLState::Instance().Enable(GL_DEPTH_TEST);
+
+    // 着色器和模型都异步构建: 驱动在后台编译的同时加载模型, 两者都好了才画出东西
+    ShaderProgram ourShader("..\\..\\shaders\\modeling.vs", "..\\..\\shaders\\modeling.fs", ShaderProgram::BuildMode::Async);
+    ShaderProgram instancedShader("..\\..\\shaders\\modeling.vs", "..\\..\\shaders\\modeling.fs", ShaderDefines{{"INSTANCED", "1"}},
+                                  ShaderProgram::BuildMode::Async);
+    // 句柄在程序构建完成后再解析, 以免等待编译
+    UniformHandle viewUniform, projectionUniform, modelUniform;
+    UniformHandle instancedViewUniform, instancedProjectionUniform;
+    bool shaderReady = false, instancedShaderReady = false;
 
-    ShaderProgram ourShader("..\\..\\shaders\\modeling.vs", "..\\..\\shaders\\modeling.fs");
+    // 实例化模式的副本位置和颜色不变; 每帧只上传视锥内的副本
+    std::vector<InstanceData> instances, visibleInstances;
+    instances.reserve(INSTANCED_GRID_SIZE * INSTANCED_GRID_SIZE);
+    for (int row = 0; row < INSTANCED_GRID_SIZE; row++)
+        for (int column = 0; column < INSTANCED_GRID_SIZE; column++)
+        {
+            InstanceData instance;
+            instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(column * GRID_SPACING, 0.0f, -row * GRID_SPACING));
+            instance.material = static_cast<std::uint32_t>(row + column) % 8;
+            instances.push_back(instance);
+        }
+    auto instanceBatch = std::make_unique<InstanceBatch>();
+    // 副本的世界空间包围盒, 模型的网格变化 (异步加载) 时重建
+    FrustumCuller instanceBounds;
+    std::vector<std::uint32_t> visibleIndices;
+    std::size_t instanceBoundsMeshes = 0;
+    OcclusionCuller occlusion(256, 192);
+    auto drawCommands = std::make_unique<DrawCommandBuffer>();
+    RenderQueue renderQueue;
+    std::cout << "multi-draw: " << (DrawCommandBuffer::MultiDrawIndirectSupported() ? "glMultiDrawElementsIndirect" : "one draw per command")
+              << std::endl;
 
-    Model ourModel("..\\..\\models\\nanosuit\\nanosuit.obj");
+    // 异步加载, 渲染循环照常运行, 网格上传完一个就画一个
+    std::shared_ptr<Model> ourModel = Model::LoadAsync("..\\..\\models\\nanosuit\\nanosuit.obj");
+    bool firstFrame = true;
+    double lastReport = 0.0;
+    FrameReport report;
 
     while (!glfwWindowShouldClose(window)) // GLFW退出前一直运行
     {
@@ -70,34 +156,220 @@ int main()
 
         processInput(window); //输入控制
 
+        renderStats.Reset();
+        double frameStart = glfwGetTime();
+
         //渲染指令
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        ourShader.use();
+        if (!shaderReady && ourShader.is_ready())
+        {
+            viewUniform = ourShader.get_uniform("view");
+            projectionUniform = ourShader.get_uniform("projection");
+            modelUniform = ourShader.get_uniform("model");
+            ShaderProgram::Stats shaders = ShaderProgram::get_stats();
+            std::cout << "shader ready after " << glfwGetTime() * 1000.0 << " ms; ShaderProgram: " << shaders.compiled << " compiled ("
+                      << shaders.compileMs << " ms), " << shaders.cacheHits << " from program cache (" << shaders.cacheMs << " ms)" << std::endl;
+            shaderReady = true;
+        }
+        if (!instancedShaderReady && instancedShader.is_ready())
+        {
+            instancedViewUniform = instancedShader.get_uniform("view");
+            instancedProjectionUniform = instancedShader.get_uniform("projection");
+            instancedShaderReady = true;
+        }
 
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.GetZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.set_uniform("view", 1, GL_FALSE, glm::value_ptr(view));
-        ourShader.set_uniform("projection", 1, GL_FALSE, glm::value_ptr(projection));
 
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));     // it's a bit too big for our scene, so scale it down
-        ourShader.set_uniform("model", 1, GL_FALSE, glm::value_ptr(model));
+        ourModel->Update(2.0); // 每帧最多花约2ms上传
+        ourModel->SetLodEnabled(useLod);
+        ourModel->SetClusterCulling(useClusterCulling);
+        ourModel->SetFrustumCulling(useFrustumCulling);
+        ourModel->SetOcclusionCuller(nullptr);
+        if (useOcclusionCulling)
+            occlusion.Begin(projection * view);
+        if (useOcclusionCulling && !useInstancing)
+        {
+            // 只有视锥内的副本作遮挡物
+            Frustum frustum(projection * view);
+            for (int row = 0; row < GRID_SIZE; row++)
+                for (int column = 0; column < GRID_SIZE; column++)
+                {
+                    glm::vec3 offset(column * GRID_SPACING, 0.0f, -row * GRID_SPACING);
+                    if (frustum.IntersectsBox(ourModel->GetBoundsMin() + offset, ourModel->GetBoundsMax() + offset))
+                        ourModel->AddOccluders(occlusion, glm::translate(glm::mat4(1.0f), offset), camera);
+                }
+            occlusion.Rasterize();
+            ourModel->SetOcclusionCuller(&occlusion);
+        }
+        if (useInstancing)
+        {
+            if (instanceBoundsMeshes != ourModel->MeshCount())
+            {
+                instanceBoundsMeshes = ourModel->MeshCount();
+                instanceBounds.Clear();
+                instanceBounds.Reserve(instances.size());
+                for (InstanceData const &instance : instances)
+                    instanceBounds.Add(ourModel->GetBoundsMin(), ourModel->GetBoundsMax(), instance.model);
+            }
+            if (useFrustumCulling)
+                instanceBounds.Cull(Frustum(projection * view), visibleIndices);
+            else
+            {
+                visibleIndices.resize(instances.size());
+                for (std::size_t i = 0; i < instances.size(); i++)
+                    visibleIndices[i] = static_cast<std::uint32_t>(i);
+            }
+            if (useOcclusionCulling)
+            {
+                for (std::uint32_t i : visibleIndices)
+                    ourModel->AddOccluders(occlusion, instances[i].model, camera);
+                occlusion.Rasterize();
+                occlusion.Filter(instanceBounds, visibleIndices);
+            }
+            // 从近到远排列, 逐实例选出的LOD连成几段, 每个网格每级只画一次
+            glm::vec3 eye = camera.GetPosition();
+            std::sort(visibleIndices.begin(), visibleIndices.end(), [&](std::uint32_t a, std::uint32_t b) {
+                return glm::length(glm::vec3(instances[a].model[3]) - eye) < glm::length(glm::vec3(instances[b].model[3]) - eye);
+            });
+            visibleInstances.clear();
+            for (std::uint32_t i : visibleIndices)
+                visibleInstances.push_back(instances[i]);
+            instanceBatch->Update(visibleInstances);
+            instancedShader.use();
+            instancedShader.set_uniform(instancedViewUniform, 1, GL_FALSE, glm::value_ptr(view));
+            instancedShader.set_uniform(instancedProjectionUniform, 1, GL_FALSE, glm::value_ptr(projection));
+            ourModel->DrawInstanced(instancedShader, *instanceBatch, visibleInstances, camera, static_cast<float>(SCR_HEIGHT));
+        }
+        else if (useMultiDraw)
+        {
+            instancedShader.use();
+            instancedShader.set_uniform(instancedViewUniform, 1, GL_FALSE, glm::value_ptr(view));
+            instancedShader.set_uniform(instancedProjectionUniform, 1, GL_FALSE, glm::value_ptr(projection));
+            for (int row = 0; row < GRID_SIZE; row++)
+            {
+                for (int column = 0; column < GRID_SIZE; column++)
+                {
+                    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(column * GRID_SPACING, 0.0f, -row * GRID_SPACING));
+                    ourModel->AddDrawCommands(*drawCommands, camera, projection, model, static_cast<float>(SCR_HEIGHT));
+                }
+            }
+            drawCommands->Submit(instancedShader);
+        }
+        else
+        {
+            ourShader.use();
+            ourShader.set_uniform(viewUniform, 1, GL_FALSE, glm::value_ptr(view));
+            ourShader.set_uniform(projectionUniform, 1, GL_FALSE, glm::value_ptr(projection));
+            renderQueue.SetCamera(projection * view, camera.GetPosition());
+            for (int row = 0; row < GRID_SIZE; row++)
+            {
+                for (int column = 0; column < GRID_SIZE; column++)
+                {
+                    // world transformation
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, glm::vec3(column * GRID_SPACING, 0.0f, -row * GRID_SPACING));
+                    if (useRenderQueue)
+                    {
+                        ourModel->Enqueue(renderQueue, ourShader, camera, projection, model, static_cast<float>(SCR_HEIGHT));
+                        continue;
+                    }
+                    ourShader.set_uniform(modelUniform, 1, GL_FALSE, glm::value_ptr(model));
+                    ourModel->Draw(ourShader, camera, projection, model, static_cast<float>(SCR_HEIGHT));
+                }
+            }
+            report.queued += renderQueue.Size();
+            renderQueue.Submit();
+            report.sortMs += renderQueue.GetSortMs();
+        }
 
-        ourModel.Draw(ourShader);
+        // 本帧的纹理请求已收集完
+        TextureManager::Instance().UpdateStreaming();
+        report.cpuMs += (glfwGetTime() - frameStart) * 1000.0; // 提交绘制的CPU时间, 不含交换缓冲
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame)
+        {
+            std::cout << "first frame after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+            firstFrame = false;
+        }
+        if (debugMode)
+        {
+            report.Add(renderStats, useOcclusionCulling ? &occlusion.GetStats() : nullptr);
+            if (currentFrame - lastReport >= 1.0)
+            {
+                report.Print();
+                report = FrameReport();
+                lastReport = currentFrame;
+            }
+        }
     }
 
+    // 纹理句柄在析构时调用GL, 要在销毁上下文之前释放
+    ourModel.reset();
+    instanceBatch.reset();
+    drawCommands.reset();
+
     //释放/删除之前的分配的所有资源
     glfwTerminate();
     return 0;
 }
 
+void FrameReport::Add(RenderStats const &stats, OcclusionCuller::Stats const *occlusion)
+{
+    frames++;
+    triangles += stats.triangles;
+    tested += stats.clustersTested;
+    frustumCulled += stats.clustersFrustumCulled;
+    backfaceCulled += stats.clustersBackfaceCulled;
+    binds += stats.textureBinds;
+    uniforms += stats.uniformSets;
+    lookups += stats.uniformLookups;
+    stateCalls += stats.stateCalls;
+    stateFiltered += stats.stateCallsFiltered;
+    drawCalls += stats.drawCalls;
+    boundsTested += stats.boundsTested;
+    boundsVisible += stats.boundsVisible;
+    cullMs += stats.cullMs;
+    if (occlusion)
+    {
+        occlusionTested += occlusion->tested;
+        occluded += occlusion->occluded;
+        occluderTriangles += occlusion->occluderTriangles;
+        occlusionMs += occlusion->rasterMs + occlusion->testMs;
+    }
+}
+
+void FrameReport::Print() const
+{
+    if (frames == 0)
+        return;
+    std::cout << (useInstancing ? "instanced " : useMultiDraw ? "multi-draw " : "") << "LOD " << (useLod ? "on" : "off") << ": "
+              << triangles / frames << " triangles/frame, " << drawCalls / frames << " draws/frame, CPU " << cpuMs / frames << " ms/frame"
+              << ", " << binds / frames << " texture binds/frame, " << uniforms / frames << " uniforms/frame (" << lookups / frames
+              << " by name), GL state calls " << stateCalls / frames << "/frame (" << stateFiltered / frames << " filtered)";
+    if (boundsTested)
+        std::cout << ", frustum culling " << boundsVisible / frames << "/" << boundsTested / frames << " bounds visible in "
+                  << cullMs / frames << " ms";
+    if (occlusionTested)
+        std::cout << ", occlusion culling " << occluded / frames << "/" << occlusionTested / frames << " occluded in "
+                  << occlusionMs / frames << " ms (" << occluderTriangles / frames << " occluder triangles)";
+    if (queued)
+        std::cout << ", render queue " << queued / frames << " draws sorted in " << sortMs / frames << " ms";
+    if (tested)
+        std::cout << ", clusters " << tested / frames << "/frame, culled " << 100.0 * frustumCulled / tested << "% frustum + "
+                  << 100.0 * backfaceCulled / tested << "% backface";
+    TextureManager::Stats textures = TextureManager::Instance().GetStats();
+    std::cout << ", textures " << textures.streamingBytes / (1024.0 * 1024.0) << "/" << textures.streamingBudget / (1024.0 * 1024.0)
+              << " MB streamed in, " << textures.pendingStreams << " pending, " << textures.streamedLevels << " levels loaded, "
+              << textures.evictedLevels << " evicted";
+    std::cout << std::endl;
+}
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
     //设置窗口维度
@@ -116,6 +388,44 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (!debugMode)
+        return;
+    // 只在按下的那一帧切换
+    static bool lodKeyDown = false;
+    bool lodKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (lodKey && !lodKeyDown)
+        useLod = !useLod;
+    lodKeyDown = lodKey;
+    static bool cullKeyDown = false;
+    bool cullKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cullKey && !cullKeyDown)
+        useClusterCulling = !useClusterCulling;
+    cullKeyDown = cullKey;
+    static bool frustumKeyDown = false;
+    bool frustumKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (frustumKey && !frustumKeyDown)
+        useFrustumCulling = !useFrustumCulling;
+    frustumKeyDown = frustumKey;
+    static bool instanceKeyDown = false;
+    bool instanceKey = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    if (instanceKey && !instanceKeyDown)
+        useInstancing = !useInstancing;
+    instanceKeyDown = instanceKey;
+    static bool multiDrawKeyDown = false;
+    bool multiDrawKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (multiDrawKey && !multiDrawKeyDown)
+        useMultiDraw = !useMultiDraw;
+    multiDrawKeyDown = multiDrawKey;
+    static bool queueKeyDown = false;
+    bool queueKey = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+    if (queueKey && !queueKeyDown)
+        useRenderQueue = !useRenderQueue;
+    queueKeyDown = queueKey;
+    static bool occlusionKeyDown = false;
+    bool occlusionKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKey && !occlusionKeyDown)
+        useOcclusionCulling = !useOcclusionCulling;
+    occlusionKeyDown = occlusionKey;
 }
 
 //监听鼠标移动事件
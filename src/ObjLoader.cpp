@@ -0,0 +1,635 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJ_USE_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+    // 每块至少这么大, 太小的块合并开销比解析还高
+    constexpr std::size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+    struct Corner
+    {
+        int v, vt, vn; // 0-based, -1 = missing
+    };
+
+    enum class EventType
+    {
+        Object,
+        Material,
+        MaterialLib
+    };
+
+    struct Event
+    {
+        EventType type;
+        std::size_t triangle; // first triangle the statement applies to
+        std::string name;
+    };
+
+    struct Chunk
+    {
+        const char *begin;
+        const char *end;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners; // 3 per triangle
+        std::vector<Corner> polygon; // 当前面的原始角点, 跨面复用
+        std::vector<Event> events;
+        // 负索引相对于当前已读数量, 跨块时需要加上前面块的数量
+        std::vector<std::size_t> relativeV, relativeVt, relativeVn;
+    };
+
+    // ---------------------------------------------------------------------------------------
+    // 扫描与数值解析
+    // ---------------------------------------------------------------------------------------
+    inline unsigned countTrailingZeros(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    // 16字节一组查找换行符
+    const char *findLineEnd(const char *p, const char *end)
+    {
+#ifdef OBJ_USE_SSE2
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (end - p >= 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+            if (mask)
+                return p + countTrailingZeros(static_cast<unsigned>(mask));
+            p += 16;
+        }
+#endif
+        while (p < end && *p != '\n')
+            p++;
+        return p;
+    }
+
+    inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline bool isDigit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+    inline const char *skipSpaces(const char *p, const char *end)
+    {
+        while (p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    // SWAR: 一次判断并转换8个十进制数字
+    inline bool isEightDigits(std::uint64_t val)
+    {
+        return (((val & 0xF0F0F0F0F0F0F0F0ull) | (((val + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+                0x3333333333333333ull);
+    }
+
+    inline std::uint32_t parseEightDigits(std::uint64_t val)
+    {
+        const std::uint64_t mask = 0x000000FF000000FFull;
+        const std::uint64_t mul1 = 0x000F424000000064ull; // 100 + (1000000ULL << 32)
+        const std::uint64_t mul2 = 0x0000271000000001ull; // 1 + (10000ULL << 32)
+        val -= 0x3030303030303030ull;
+        val = (val * 10) + (val >> 8);
+        val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+        return static_cast<std::uint32_t>(val);
+    }
+
+    // 解析一串数字到 value, 返回读到的位数
+    inline int parseDigits(const char *&p, const char *end, std::uint64_t &value)
+    {
+        int count = 0;
+        while (end - p >= 8)
+        {
+            std::uint64_t chunk;
+            std::memcpy(&chunk, p, sizeof(chunk));
+            if (!isEightDigits(chunk))
+                break;
+            value = value * 100000000ull + parseEightDigits(chunk);
+            p += 8;
+            count += 8;
+        }
+        while (p < end && isDigit(*p))
+        {
+            value = value * 10 + static_cast<std::uint64_t>(*p - '0');
+            p++;
+            count++;
+        }
+        return count;
+    }
+
+    const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    inline double pow10(int exponent)
+    {
+        if (exponent >= 0 && exponent <= 22)
+            return POW10[exponent];
+        if (exponent < 0 && exponent >= -22)
+            return 1.0 / POW10[-exponent];
+        double result = 1.0;
+        double base = exponent < 0 ? 0.1 : 10.0;
+        for (int i = 0, n = exponent < 0 ? -exponent : exponent; i < n; i++)
+            result *= base;
+        return result;
+    }
+
+    float parseFloat(const char *&p, const char *end)
+    {
+        p = skipSpaces(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        std::uint64_t mantissa = 0;
+        int exponent = 0;
+        const char *intStart = p;
+        int intDigits = parseDigits(p, end, mantissa);
+        const char *fracStart = p;
+        int fracDigits = 0;
+        if (p < end && *p == '.')
+        {
+            fracStart = ++p;
+            fracDigits = parseDigits(p, end, mantissa);
+        }
+        // 超过19位有效数字时uint64会溢出, 只保留前19位(远超float精度)
+        if (intDigits + fracDigits > 19)
+        {
+            mantissa = 0;
+            int keepInt = std::min(intDigits, 19);
+            const char *q = intStart;
+            parseDigits(q, intStart + keepInt, mantissa);
+            exponent += intDigits - keepInt;
+            int keepFrac = std::min(fracDigits, 19 - keepInt);
+            q = fracStart;
+            parseDigits(q, fracStart + keepFrac, mantissa);
+            fracDigits = keepFrac;
+        }
+        exponent -= fracDigits;
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            bool expNegative = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                expNegative = *p++ == '-';
+            std::uint64_t expValue = 0;
+            parseDigits(p, end, expValue);
+            exponent += expNegative ? -static_cast<int>(expValue) : static_cast<int>(expValue);
+        }
+        double value = static_cast<double>(mantissa) * pow10(exponent);
+        return static_cast<float>(negative ? -value : value);
+    }
+
+    inline bool parseInt(const char *&p, const char *end, long long &value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        std::uint64_t magnitude = 0;
+        if (parseDigits(p, end, magnitude) == 0)
+            return false;
+        value = negative ? -static_cast<long long>(magnitude) : static_cast<long long>(magnitude);
+        return true;
+    }
+
+    std::string restOfLine(const char *p, const char *end)
+    {
+        p = skipSpaces(p, end);
+        const char *last = end;
+        while (last > p && isSpace(last[-1]))
+            last--;
+        return std::string(p, last);
+    }
+
+    inline bool startsWith(const char *p, const char *end, const char *word)
+    {
+        std::size_t n = std::strlen(word);
+        return static_cast<std::size_t>(end - p) > n && std::memcmp(p, word, n) == 0 && isSpace(p[n]);
+    }
+
+    // ---------------------------------------------------------------------------------------
+    // 块解析
+    // ---------------------------------------------------------------------------------------
+    // OBJ 索引: 正数从1开始, 负数相对于当前数量
+    inline int resolveIndex(long long index, std::size_t count, std::size_t slot, std::vector<std::size_t> &relative)
+    {
+        if (index > 0)
+            return static_cast<int>(index - 1);
+        relative.push_back(slot);
+        return static_cast<int>(static_cast<long long>(count) + index);
+    }
+
+    void parseFace(Chunk &chunk, const char *p, const char *end)
+    {
+        std::vector<Corner> &polygon = chunk.polygon;
+        polygon.clear();
+        for (;;)
+        {
+            p = skipSpaces(p, end);
+            if (p >= end)
+                break;
+            long long v = 0, vt = 0, vn = 0;
+            if (!parseInt(p, end, v))
+                break;
+            if (p < end && *p == '/')
+            {
+                p++;
+                if (p < end && *p != '/')
+                    parseInt(p, end, vt);
+                if (p < end && *p == '/')
+                {
+                    p++;
+                    parseInt(p, end, vn);
+                }
+            }
+            // 先记下原始值, 三角化时再解析
+            polygon.push_back(Corner{static_cast<int>(v), static_cast<int>(vt), static_cast<int>(vn)});
+        }
+        // 扇形三角化 (Triangulate)
+        for (std::size_t i = 1; i + 1 < polygon.size(); i++)
+        {
+            const Corner *tri[3] = {&polygon[0], &polygon[i], &polygon[i + 1]};
+            for (const Corner *c : tri)
+            {
+                std::size_t slot = chunk.corners.size();
+                Corner resolved;
+                resolved.v = resolveIndex(c->v, chunk.positions.size(), slot, chunk.relativeV);
+                resolved.vt = c->vt == 0 ? -1 : resolveIndex(c->vt, chunk.texCoords.size(), slot, chunk.relativeVt);
+                resolved.vn = c->vn == 0 ? -1 : resolveIndex(c->vn, chunk.normals.size(), slot, chunk.relativeVn);
+                chunk.corners.push_back(resolved);
+            }
+        }
+    }
+
+    void parseChunk(Chunk &chunk)
+    {
+        const char *p = chunk.begin;
+        while (p < chunk.end)
+        {
+            const char *lineEnd = findLineEnd(p, chunk.end);
+            const char *line = skipSpaces(p, lineEnd);
+            p = lineEnd + 1;
+            if (line >= lineEnd)
+                continue;
+
+            switch (*line)
+            {
+            case 'v':
+                if (lineEnd - line > 1 && isSpace(line[1]))
+                {
+                    const char *q = line + 1;
+                    glm::vec3 position;
+                    position.x = parseFloat(q, lineEnd);
+                    position.y = parseFloat(q, lineEnd);
+                    position.z = parseFloat(q, lineEnd);
+                    chunk.positions.push_back(position);
+                }
+                else if (startsWith(line, lineEnd, "vt"))
+                {
+                    const char *q = line + 2;
+                    glm::vec2 uv;
+                    uv.x = parseFloat(q, lineEnd);
+                    uv.y = 1.0f - parseFloat(q, lineEnd); // FlipUVs
+                    chunk.texCoords.push_back(uv);
+                }
+                else if (startsWith(line, lineEnd, "vn"))
+                {
+                    const char *q = line + 2;
+                    glm::vec3 normal;
+                    normal.x = parseFloat(q, lineEnd);
+                    normal.y = parseFloat(q, lineEnd);
+                    normal.z = parseFloat(q, lineEnd);
+                    chunk.normals.push_back(normal);
+                }
+                break;
+            case 'f':
+                if (lineEnd - line > 1 && isSpace(line[1]))
+                    parseFace(chunk, line + 1, lineEnd);
+                break;
+            case 'o':
+            case 'g':
+                if (lineEnd - line == 1 || isSpace(line[1]))
+                    chunk.events.push_back(Event{EventType::Object, chunk.corners.size() / 3, restOfLine(line + 1, lineEnd)});
+                break;
+            case 'u':
+                if (startsWith(line, lineEnd, "usemtl"))
+                    chunk.events.push_back(Event{EventType::Material, chunk.corners.size() / 3, restOfLine(line + 6, lineEnd)});
+                break;
+            case 'm':
+                if (startsWith(line, lineEnd, "mtllib"))
+                    chunk.events.push_back(Event{EventType::MaterialLib, chunk.corners.size() / 3, restOfLine(line + 6, lineEnd)});
+                break;
+            default: // 注释, s 平滑组 等
+                break;
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------
+    // MTL
+    // ---------------------------------------------------------------------------------------
+    std::string directoryOf(std::string const &path)
+    {
+        std::size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // 选项(-bm 1.0 等)之后的最后一个记号才是文件名
+    std::string mapFileName(std::string const &args)
+    {
+        std::size_t last = args.find_last_of(" \t");
+        return last == std::string::npos ? args : args.substr(last + 1);
+    }
+
+    void loadMaterialLibrary(std::string const &path, std::vector<MaterialData> &materials,
+                             std::unordered_map<std::string, unsigned int> &materialIndex)
+    {
+        MappedFile file(path);
+        if (!file.IsOpen())
+        {
+            std::cout << "ERROR::OBJLOADER::could not open material library " << path << std::endl;
+            return;
+        }
+        // 与 Model::processMaterial 相同的顺序: diffuse, specular, normal, height
+        struct Slots
+        {
+            std::vector<std::string> diffuse, specular, normal, height;
+        };
+        std::vector<Slots> slots;
+        std::vector<unsigned int> targets;
+
+        const char *p = reinterpret_cast<const char *>(file.Data());
+        const char *end = p + file.Size();
+        while (p < end)
+        {
+            const char *lineEnd = findLineEnd(p, end);
+            const char *line = skipSpaces(p, lineEnd);
+            p = lineEnd + 1;
+            if (line >= lineEnd || *line == '#')
+                continue;
+
+            if (startsWith(line, lineEnd, "newmtl"))
+            {
+                std::string name = restOfLine(line + 6, lineEnd);
+                auto it = materialIndex.find(name);
+                if (it == materialIndex.end())
+                {
+                    it = materialIndex.emplace(name, static_cast<unsigned int>(materials.size())).first;
+                    materials.emplace_back();
+                }
+                targets.push_back(it->second);
+                slots.emplace_back();
+            }
+            else if (!slots.empty())
+            {
+                Slots &slot = slots.back();
+                if (startsWith(line, lineEnd, "map_Kd"))
+                    slot.diffuse.push_back(mapFileName(restOfLine(line + 6, lineEnd)));
+                else if (startsWith(line, lineEnd, "map_Ks"))
+                    slot.specular.push_back(mapFileName(restOfLine(line + 6, lineEnd)));
+                else if (startsWith(line, lineEnd, "map_Bump") || startsWith(line, lineEnd, "map_bump"))
+                    slot.normal.push_back(mapFileName(restOfLine(line + 8, lineEnd))); // Assimp: aiTextureType_HEIGHT
+                else if (startsWith(line, lineEnd, "bump"))
+                    slot.normal.push_back(mapFileName(restOfLine(line + 4, lineEnd)));
+                else if (startsWith(line, lineEnd, "map_Ka"))
+                    slot.height.push_back(mapFileName(restOfLine(line + 6, lineEnd))); // Assimp: aiTextureType_AMBIENT
+            }
+        }
+
+        for (std::size_t i = 0; i < slots.size(); i++)
+        {
+            auto &textures = materials[targets[i]].textures;
+            textures.clear();
+            for (auto const &file : slots[i].diffuse)
+                textures.push_back(Texture{0, "texture_diffuse", file, TextureHandle(), 0});
+            for (auto const &file : slots[i].specular)
+                textures.push_back(Texture{0, "texture_specular", file, TextureHandle(), 0});
+            for (auto const &file : slots[i].normal)
+                textures.push_back(Texture{0, "texture_normal", file, TextureHandle(), 0});
+            for (auto const &file : slots[i].height)
+                textures.push_back(Texture{0, "texture_height", file, TextureHandle(), 0});
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------
+    // 合并
+    // ---------------------------------------------------------------------------------------
+    struct TriangleRange
+    {
+        const Chunk *chunk;
+        std::size_t begin, end; // triangles
+    };
+
+    struct MeshBuild
+    {
+        unsigned int materialIndex;
+        std::vector<TriangleRange> ranges;
+    };
+
+    struct CornerHash
+    {
+        std::size_t operator()(Corner const &c) const noexcept
+        {
+            std::uint64_t h = static_cast<std::uint32_t>(c.v);
+            h = h * 0x9E3779B97F4A7C15ull ^ static_cast<std::uint32_t>(c.vt);
+            h = h * 0x9E3779B97F4A7C15ull ^ static_cast<std::uint32_t>(c.vn);
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    struct CornerEqual
+    {
+        bool operator()(Corner const &a, Corner const &b) const noexcept
+        {
+            return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+        }
+    };
+
+    MeshData buildMesh(MeshBuild const &build, std::vector<glm::vec3> const &positions,
+                       std::vector<glm::vec2> const &texCoords, std::vector<glm::vec3> const &normals)
+    {
+        MeshData mesh;
+        mesh.materialIndex = build.materialIndex;
+        std::size_t triangles = 0;
+        for (auto const &range : build.ranges)
+            triangles += range.end - range.begin;
+        mesh.indices.reserve(triangles * 3);
+
+        std::unordered_map<Corner, unsigned int, CornerHash, CornerEqual> lookup;
+        lookup.reserve(triangles * 2);
+        for (auto const &range : build.ranges)
+        {
+            for (std::size_t i = range.begin * 3; i < range.end * 3; i++)
+            {
+                Corner const &corner = range.chunk->corners[i];
+                auto [it, inserted] = lookup.try_emplace(corner, static_cast<unsigned int>(mesh.vertices.size()));
+                if (inserted)
+                {
+                    Vertex vertex{};
+                    if (corner.v >= 0 && static_cast<std::size_t>(corner.v) < positions.size())
+                        vertex.Position = positions[corner.v];
+                    if (corner.vn >= 0 && static_cast<std::size_t>(corner.vn) < normals.size())
+                        vertex.Normal = normals[corner.vn];
+                    if (corner.vt >= 0 && static_cast<std::size_t>(corner.vt) < texCoords.size())
+                        vertex.TexCoords = texCoords[corner.vt];
+                    mesh.vertices.push_back(vertex);
+                }
+                mesh.indices.push_back(it->second);
+            }
+        }
+        return mesh;
+    }
+}
+
+bool ObjLoader::Load(std::string const &path, std::vector<MeshData> &meshes, std::vector<MaterialData> &materials,
+                     bool parallel)
+{
+    MappedFile file(path);
+    if (!file.IsOpen())
+    {
+        std::cout << "ERROR::OBJLOADER::could not open " << path << std::endl;
+        return false;
+    }
+
+    // 1. 在换行处把文件切成若干块
+    const char *data = reinterpret_cast<const char *>(file.Data());
+    const char *end = data + file.Size();
+    ThreadPool &pool = ThreadPool::Global();
+    std::size_t chunkCount = parallel ? std::max<std::size_t>(1, std::min<std::size_t>(file.Size() / MIN_CHUNK_SIZE, pool.Size() * 4)) : 1;
+    std::vector<Chunk> chunks(chunkCount);
+    const char *begin = data;
+    for (std::size_t i = 0; i < chunkCount; i++)
+    {
+        const char *split = i + 1 == chunkCount ? end : data + file.Size() * (i + 1) / chunkCount;
+        if (split < begin)
+            split = begin;
+        if (split < end)
+            split = std::min(end, findLineEnd(split, end) + 1);
+        chunks[i].begin = begin;
+        chunks[i].end = split;
+        begin = split;
+    }
+
+    // 2. 并行解析各块
+    if (chunkCount > 1)
+        pool.ParallelFor(chunkCount, [&](std::size_t i) { parseChunk(chunks[i]); });
+    else
+        parseChunk(chunks[0]);
+
+    // 3. 拼接顶点属性, 修正跨块的相对索引
+    std::size_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+    for (auto &chunk : chunks)
+    {
+        for (std::size_t slot : chunk.relativeV)
+            chunk.corners[slot].v += static_cast<int>(positionCount);
+        for (std::size_t slot : chunk.relativeVt)
+            chunk.corners[slot].vt += static_cast<int>(texCoordCount);
+        for (std::size_t slot : chunk.relativeVn)
+            chunk.corners[slot].vn += static_cast<int>(normalCount);
+        positionCount += chunk.positions.size();
+        texCoordCount += chunk.texCoords.size();
+        normalCount += chunk.normals.size();
+    }
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    positions.reserve(positionCount);
+    texCoords.reserve(texCoordCount);
+    normals.reserve(normalCount);
+    for (auto &chunk : chunks)
+    {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // 4. 按 o/g/usemtl 语句把三角形划分到网格
+    std::unordered_map<std::string, unsigned int> materialIndex;
+    std::vector<MaterialData> objMaterials;
+    std::string directory = directoryOf(path);
+    for (auto const &chunk : chunks)
+        for (auto const &event : chunk.events)
+            if (event.type == EventType::MaterialLib)
+                loadMaterialLibrary(directory + event.name, objMaterials, materialIndex);
+
+    const unsigned int NO_MATERIAL = ~0u;
+    std::vector<MeshBuild> builds;
+    unsigned int currentMaterial = NO_MATERIAL;
+    bool newMesh = true;
+    bool usesDefaultMaterial = false;
+    auto addRange = [&](const Chunk &chunk, std::size_t from, std::size_t to) {
+        if (from == to)
+            return;
+        if (newMesh)
+        {
+            builds.push_back(MeshBuild{currentMaterial, {}});
+            usesDefaultMaterial |= currentMaterial == NO_MATERIAL;
+            newMesh = false;
+        }
+        builds.back().ranges.push_back(TriangleRange{&chunk, from, to});
+    };
+    for (auto const &chunk : chunks)
+    {
+        std::size_t cursor = 0;
+        for (auto const &event : chunk.events)
+        {
+            addRange(chunk, cursor, event.triangle);
+            cursor = event.triangle;
+            if (event.type == EventType::Object)
+                newMesh = true;
+            else if (event.type == EventType::Material)
+            {
+                auto it = materialIndex.find(event.name);
+                unsigned int material = it == materialIndex.end() ? NO_MATERIAL : it->second;
+                if (material != currentMaterial)
+                    newMesh = true;
+                currentMaterial = material;
+            }
+        }
+        addRange(chunk, cursor, chunk.corners.size() / 3);
+    }
+    if (builds.empty())
+    {
+        std::cout << "ERROR::OBJLOADER::no faces in " << path << std::endl;
+        return false;
+    }
+    // 未指定材质的网格使用一个没有纹理的默认材质
+    if (usesDefaultMaterial)
+    {
+        for (auto &build : builds)
+            if (build.materialIndex == NO_MATERIAL)
+                build.materialIndex = static_cast<unsigned int>(objMaterials.size());
+        objMaterials.emplace_back();
+    }
+
+    // 5. 各网格独立去重并输出 Vertex
+    std::vector<MeshData> objMeshes(builds.size());
+    if (parallel && builds.size() > 1)
+        pool.ParallelFor(builds.size(), [&](std::size_t i) { objMeshes[i] = buildMesh(builds[i], positions, texCoords, normals); });
+    else
+        for (std::size_t i = 0; i < builds.size(); i++)
+            objMeshes[i] = buildMesh(builds[i], positions, texCoords, normals);
+
+    meshes = std::move(objMeshes);
+    materials = std::move(objMaterials);
+    return true;
+}
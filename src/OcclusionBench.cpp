@@ -0,0 +1,206 @@
+// 遮挡剔除的基准: 街区式的城市, 楼房作遮挡物, 楼房和街上的小物体都作被测物体. 只用CPU, 不需要GL.
+// 抽查的被剔除物体中只要有一个能被射线看到 (错误的遮挡) 就返回1
+#include <Frustum.h>
+#include <FrustumCuller.h>
+#include <OcclusionCuller.h>
+#include <Stopwatch.h>
+#include <ThreadPool.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const int BLOCKS = 24;            // BLOCKS x BLOCKS 个街区
+    const float BLOCK_SIZE = 40.0f;   // 每个街区 2x2 栋楼
+    const float STREET_WIDTH = 12.0f;
+    const int PROPS = 40000;          // 街上的小物体 (车辆大小)
+    const float NEAR_PLANE = 0.5f, FAR_PLANE = 1500.0f;
+    const int REPEATS = 5;
+    const std::size_t CHECKED_OCCLUSIONS = 500;
+
+    // 单位立方体, 三角形从外面看是逆时针
+    const glm::vec3 CUBE_VERTICES[8] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+    const unsigned int CUBE_INDICES[36] = {0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4,
+                                           2, 6, 7, 2, 7, 3, 0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6};
+
+    struct Box
+    {
+        glm::vec3 min, max;
+    };
+
+    struct View
+    {
+        glm::vec3 eye, target;
+    };
+
+    // 线段 eye + t * (point - eye), t in [0, limit) 进入 box 的 t; 不相交时返回 limit
+    float segmentEnter(glm::vec3 const &eye, glm::vec3 const &point, Box const &box, float limit)
+    {
+        glm::vec3 direction = point - eye;
+        float enter = 0.0f, leave = limit;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::abs(direction[axis]) < 1e-6f)
+            {
+                if (eye[axis] < box.min[axis] || eye[axis] > box.max[axis])
+                    return limit;
+                continue;
+            }
+            float t0 = (box.min[axis] - eye[axis]) / direction[axis], t1 = (box.max[axis] - eye[axis]) / direction[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            leave = std::min(leave, std::max(t0, t1));
+        }
+        return enter < leave ? enter : limit;
+    }
+
+    struct Result
+    {
+        std::size_t objects = 0, inFrustum = 0, visible = 0, triangles = 0, suspicious = 0, checked = 0;
+        double frustumMs = 0.0, rasterMs = 0.0, testMs = 0.0;
+    };
+}
+
+int main()
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // 楼房: 每个街区4栋, 之间留1米; 被测物体的前 buildings.size() 个就是楼房自己
+    std::vector<Box> buildings;
+    float pitch = BLOCK_SIZE + STREET_WIDTH;
+    for (int row = 0; row < BLOCKS; row++)
+        for (int column = 0; column < BLOCKS; column++)
+            for (int lot = 0; lot < 4; lot++)
+            {
+                glm::vec3 min(column * pitch + (lot & 1) * BLOCK_SIZE * 0.5f + 0.5f, 0.0f, row * pitch + (lot >> 1) * BLOCK_SIZE * 0.5f + 0.5f);
+                float height = 12.0f + unit(random) * 48.0f;
+                buildings.push_back(Box{min, min + glm::vec3(BLOCK_SIZE * 0.5f - 1.0f, height, BLOCK_SIZE * 0.5f - 1.0f)});
+            }
+    std::vector<glm::mat4> buildingModels;
+    for (Box const &building : buildings)
+        buildingModels.push_back(glm::scale(glm::translate(glm::mat4(1.0f), building.min), building.max - building.min));
+
+    // 街上的物体: 随机一条街的随机位置
+    std::vector<Box> objects = buildings;
+    for (int i = 0; i < PROPS; i++)
+    {
+        float street = (static_cast<int>(unit(random) * BLOCKS) + 1) * pitch - STREET_WIDTH * (0.1f + 0.8f * unit(random));
+        float along = unit(random) * BLOCKS * pitch;
+        glm::vec3 min = i % 2 ? glm::vec3(street, 0.0f, along) : glm::vec3(along, 0.0f, street);
+        glm::vec3 size = i % 2 ? glm::vec3(2.0f, 1.5f, 4.5f) : glm::vec3(4.5f, 1.5f, 2.0f);
+        objects.push_back(Box{min, min + size});
+    }
+    FrustumCuller scene;
+    scene.Reserve(objects.size());
+    for (Box const &object : objects)
+        scene.Add(object.min, object.max);
+
+    // 行人高度的路口视角沿街或斜向看, 外加一个高处俯视
+    float street = BLOCK_SIZE + STREET_WIDTH * 0.5f;
+    float center = BLOCKS * pitch * 0.5f;
+    std::vector<View> views = {
+        {{street + pitch * 5, 1.7f, street + pitch * 5}, {street + pitch * 5, 1.7f, street + pitch * 20}},
+        {{street + pitch * 5, 1.7f, street + pitch * 5}, {street + pitch * 20, 1.7f, street + pitch * 20}},
+        {{street + pitch * 11, 1.7f, street + pitch * 11}, {street, 1.7f, street + pitch * 11}},
+        {{street + pitch * 11, 1.7f, street + pitch * 11}, {street + pitch * 3, 1.7f, street + pitch * 2}},
+        {{street + pitch * 2, 1.7f, street + pitch * 17}, {street + pitch * 22, 1.7f, street + pitch * 17}},
+        {{street + pitch * 17, 1.7f, street + pitch * 2}, {street + pitch * 9, 1.7f, street + pitch * 20}},
+        {{street + pitch * 8, 1.7f, street + pitch * 14}, {street + pitch * 8.3f, 1.7f, street}},
+        {{center, 120.0f, -50.0f}, {center, 0.0f, center}},
+    };
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, NEAR_PLANE, FAR_PLANE);
+
+    std::size_t falseOcclusions = 0;
+    std::cout << objects.size() << " objects (" << buildings.size() << " buildings as occluders, " << PROPS << " props), "
+              << views.size() << " views, worker threads: " << ThreadPool::Global().Size() << std::endl;
+    for (int resolution : {128, 256, 512})
+    {
+        for (bool parallel : {false, true})
+        {
+            OcclusionCuller occlusion(resolution, resolution * 3 / 4);
+            Result total;
+            std::vector<std::uint32_t> visible, inFrustum, occludedObjects;
+            for (View const &view : views)
+            {
+                glm::mat4 viewProjection = projection * glm::lookAt(view.eye, view.target, glm::vec3(0.0f, 1.0f, 0.0f));
+                Result best;
+                best.frustumMs = best.rasterMs = best.testMs = 1e30;
+                for (int repeat = 0; repeat < REPEATS; repeat++)
+                {
+                    Stopwatch watch;
+                    scene.Cull(Frustum(viewProjection), visible, parallel);
+                    best.frustumMs = std::min(best.frustumMs, watch.ElapsedMs());
+                    inFrustum = visible;
+
+                    // 视锥内的楼房作遮挡物
+                    occlusion.Begin(viewProjection);
+                    for (std::uint32_t i : visible)
+                        if (i < buildings.size())
+                            occlusion.AddOccluder(CUBE_VERTICES, sizeof(glm::vec3), CUBE_INDICES, 36, buildingModels[i], true);
+                    occlusion.Rasterize(parallel);
+                    occlusion.Filter(scene, visible, parallel);
+                    best.rasterMs = std::min(best.rasterMs, occlusion.GetStats().rasterMs);
+                    best.testMs = std::min(best.testMs, occlusion.GetStats().testMs);
+                }
+                total.objects += objects.size();
+                total.inFrustum += inFrustum.size();
+                total.visible += visible.size();
+                total.triangles += occlusion.GetStats().occluderTriangles;
+                total.frustumMs += best.frustumMs;
+                total.rasterMs += best.rasterMs;
+                total.testMs += best.testMs;
+
+                // 抽查被剔除的物体: 从眼睛到包围盒中心和略向内收的8个角点, 在进入物体自身之前都应穿过别的楼.
+                // 画面外的采样点本来就看不到, 不检查
+                occludedObjects.clear();
+                std::set_difference(inFrustum.begin(), inFrustum.end(), visible.begin(), visible.end(), std::back_inserter(occludedObjects));
+                std::size_t stride = std::max<std::size_t>(1, occludedObjects.size() / CHECKED_OCCLUSIONS);
+                for (std::size_t j = 0; j < occludedObjects.size(); j += stride)
+                {
+                    Box const &object = objects[occludedObjects[j]];
+                    glm::vec3 middle = (object.min + object.max) * 0.5f;
+                    bool seen = false;
+                    for (int corner = 0; corner < 9 && !seen; corner++)
+                    {
+                        glm::vec3 point = corner == 8 ? middle
+                                                      : glm::mix(middle, glm::vec3(corner & 1 ? object.max.x : object.min.x, corner & 2 ? object.max.y : object.min.y,
+                                                                                   corner & 4 ? object.max.z : object.min.z),
+                                                                 0.98f);
+                        glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+                        if (std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w)
+                            continue;
+                        float own = segmentEnter(view.eye, point, object, 1.0f);
+                        bool blocked = false;
+                        for (std::size_t b = 0; b < buildings.size() && !blocked; b++)
+                            blocked = b != occludedObjects[j] && segmentEnter(view.eye, point, buildings[b], own) < own;
+                        seen = !blocked;
+                    }
+                    total.checked++;
+                    total.suspicious += seen ? 1 : 0;
+                }
+            }
+            std::size_t occluded = total.inFrustum - total.visible;
+            std::cout << occlusion.GetWidth() << "x" << occlusion.GetHeight() << (parallel ? " parallel" : " single thread") << ": "
+                      << total.inFrustum / views.size() << "/" << total.objects / views.size() << " in frustum, "
+                      << 100.0 * occluded / total.inFrustum << "% of them occluded, " << total.visible / views.size()
+                      << " submitted; per view: frustum " << total.frustumMs / views.size() << " ms, raster "
+                      << total.rasterMs / views.size() << " ms (" << total.triangles / views.size() << " triangles), test "
+                      << total.testMs / views.size() << " ms; " << total.suspicious << "/" << total.checked
+                      << " checked occlusions have a clear sample ray" << std::endl;
+            falseOcclusions += total.suspicious;
+        }
+    }
+    if (falseOcclusions)
+    {
+        std::cout << "ERROR::OCCLUSION_BENCH::" << falseOcclusions << " visible objects were culled" << std::endl;
+        return 1;
+    }
+    return 0;
+}
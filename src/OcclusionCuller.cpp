@@ -0,0 +1,378 @@
+#include "OcclusionCuller.h"
+#include "Stopwatch.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE2 1
+#endif
+
+namespace
+{
+    // 三角形准备时每个任务至少这么多三角形, 包围盒测试时每个任务至少这么多个
+    constexpr std::size_t MIN_TRIANGLES_PER_TASK = 1024;
+    constexpr std::size_t MIN_TESTS_PER_TASK = 256;
+    // 光栅化时把像素当作边长 1 + 2 * PIXEL_MARGIN 的正方形, 远大于边函数在这个分辨率下的舍入误差
+    constexpr float PIXEL_MARGIN = 1.0f / 64.0f;
+}
+
+OcclusionCuller::OcclusionCuller(int width_, int height_)
+    : width((std::max(width_, 1) + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+      height((std::max(height_, 1) + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE)
+{
+    tilesX = width / TILE_SIZE;
+    tilesY = height / TILE_SIZE;
+    depth.assign(static_cast<std::size_t>(width) * height, 1.0f);
+    tileDepth.assign(static_cast<std::size_t>(tilesX) * tilesY, 1.0f);
+}
+
+void OcclusionCuller::Begin(glm::mat4 const &viewProjection_)
+{
+    viewProjection = viewProjection_;
+    occluders.clear();
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(tileDepth.begin(), tileDepth.end(), 1.0f);
+    stats = Stats();
+}
+
+void OcclusionCuller::AddOccluder(glm::vec3 const *positions, std::size_t stride, unsigned int const *indices, std::size_t indexCount,
+                                  glm::mat4 const &model, bool closed)
+{
+    occluders.push_back(Occluder{positions, stride, indices, indexCount - indexCount % 3, viewProjection * model, closed});
+}
+
+void OcclusionCuller::setupOccluder(Occluder const &occluder, std::vector<Triangle> &out) const
+{
+    // 变换过的顶点按下标直接映射缓存, 相邻三角形共享的顶点只变换一次 (网格导入时已按顶点缓存排序)
+    constexpr unsigned int CACHE_SIZE = 64;
+    unsigned int cachedIndex[CACHE_SIZE];
+    glm::vec4 cachedClip[CACHE_SIZE];
+    std::fill(cachedIndex, cachedIndex + CACHE_SIZE, ~0u);
+    glm::mat4 const &transform = occluder.transform;
+    unsigned char const *base = reinterpret_cast<unsigned char const *>(occluder.positions);
+    for (std::size_t i = 0; i < occluder.indexCount; i += 3)
+    {
+        glm::vec4 clip[3];
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int index = occluder.indices[i + k], slot = index % CACHE_SIZE;
+            if (cachedIndex[slot] != index)
+            {
+                glm::vec3 const &p = *reinterpret_cast<glm::vec3 const *>(base + index * occluder.stride);
+                cachedIndex[slot] = index;
+                cachedClip[slot] = transform[0] * p.x + transform[1] * p.y + transform[2] * p.z + transform[3];
+            }
+            clip[k] = cachedClip[slot];
+        }
+        setupTriangle(clip, occluder.closed, out);
+    }
+}
+
+void OcclusionCuller::setupTriangle(glm::vec4 const *clip, bool closed, std::vector<Triangle> &out) const
+{
+    // 三个顶点都在同一个侧面之外
+    if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+        (clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+        (clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+        (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w))
+        return;
+
+    // 对近平面 z + w >= 0 裁剪 (透视投影下此时 w >= near > 0), 三角形最多变成四边形
+    glm::vec4 polygon[4];
+    int count = 0;
+    if (clip[0].z >= -clip[0].w && clip[1].z >= -clip[1].w && clip[2].z >= -clip[2].w)
+    {
+        polygon[0] = clip[0];
+        polygon[1] = clip[1];
+        polygon[2] = clip[2];
+        count = 3;
+    }
+    else
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec4 const &a = clip[k], &b = clip[(k + 1) % 3];
+            float da = a.z + a.w, db = b.z + b.w;
+            if (da >= 0.0f)
+                polygon[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                polygon[count++] = a + (b - a) * (da / (da - db));
+        }
+        if (count < 3)
+            return;
+    }
+
+    // 屏幕边界落在边上一排像素的中心, 见 testBox
+    glm::vec3 screen[4];
+    for (int k = 0; k < count; k++)
+    {
+        float inverseW = 1.0f / polygon[k].w;
+        screen[k] = glm::vec3(polygon[k].x * inverseW * (width - 1) * 0.5f + width * 0.5f,
+                              polygon[k].y * inverseW * (height - 1) * 0.5f + height * 0.5f, polygon[k].z * inverseW * 0.5f + 0.5f);
+    }
+    for (int fan = 1; fan + 1 < count; fan++)
+    {
+        glm::vec3 v[3] = {screen[0], screen[fan], screen[fan + 1]};
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (!(std::abs(area) > 0.0f))
+            continue;
+        // 窗口坐标y向上, 逆时针为正面
+        if (area < 0.0f)
+        {
+            if (closed)
+                continue;
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+        // 整个在远平面之外的三角形不会改变深度
+        if (std::min({v[0].z, v[1].z, v[2].z}) >= 1.0f)
+            continue;
+
+        // 覆盖的像素中心 i + 0.5 落在包围矩形内
+        Triangle triangle;
+        triangle.minX = std::max(0, static_cast<int>(std::ceil(std::min({v[0].x, v[1].x, v[2].x}) - 0.5f)));
+        triangle.maxX = std::min(width - 1, static_cast<int>(std::floor(std::max({v[0].x, v[1].x, v[2].x}) - 0.5f)));
+        triangle.minY = std::max(0, static_cast<int>(std::ceil(std::min({v[0].y, v[1].y, v[2].y}) - 0.5f)));
+        triangle.maxY = std::min(height - 1, static_cast<int>(std::floor(std::max({v[0].y, v[1].y, v[2].y}) - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            continue;
+
+        // 第k条边从 v[k] 到 v[k+1], 边函数与对面顶点 v[k+2] 的重心坐标成正比, 三者之和为 area
+        triangle.zx = triangle.zy = triangle.z0 = 0.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 const &from = v[k], &to = v[(k + 1) % 3];
+            triangle.a[k] = from.y - to.y;
+            triangle.b[k] = to.x - from.x;
+            triangle.c[k] = -(triangle.a[k] * from.x + triangle.b[k] * from.y);
+            float z = v[(k + 2) % 3].z / area;
+            triangle.zx += triangle.a[k] * z;
+            triangle.zy += triangle.b[k] * z;
+            triangle.z0 += triangle.c[k] * z;
+        }
+        // 只写整个像素 (每边再放大 PIXEL_MARGIN, 抵消舍入) 都在三角形内的像素, 深度取像素内最远的一点.
+        // 这样缓冲里每个有深度的像素都被单个三角形完整盖住, 遮挡物之间的窄缝不会被当作挡住
+        const float half = 0.5f + PIXEL_MARGIN;
+        for (int k = 0; k < 3; k++)
+            triangle.c[k] -= half * (std::abs(triangle.a[k]) + std::abs(triangle.b[k]));
+        triangle.z0 += half * (std::abs(triangle.zx) + std::abs(triangle.zy));
+        out.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeRows(int tileRowBegin, int tileRowEnd)
+{
+    int rowBegin = tileRowBegin * TILE_SIZE, rowEnd = tileRowEnd * TILE_SIZE;
+    for (std::vector<Triangle> const &group : triangles)
+    {
+        for (Triangle const &triangle : group)
+        {
+            int y0 = std::max(triangle.minY, rowBegin), y1 = std::min(triangle.maxY, rowEnd - 1);
+            for (int y = y0; y <= y1; y++)
+            {
+                float *row = depth.data() + static_cast<std::size_t>(y) * width;
+                float py = y + 0.5f;
+                // 这一行上三条边函数都非负的区间, 两端各放宽一个像素, 边缘上的像素仍由边函数判断
+                float left = static_cast<float>(triangle.minX), right = static_cast<float>(triangle.maxX);
+                for (int k = 0; k < 3; k++)
+                {
+                    float rowValue = triangle.b[k] * py + triangle.c[k];
+                    if (triangle.a[k] > 0.0f)
+                        left = std::max(left, -rowValue / triangle.a[k] - 0.5f);
+                    else if (triangle.a[k] < 0.0f)
+                        right = std::min(right, -rowValue / triangle.a[k] - 0.5f);
+                    else if (rowValue < 0.0f)
+                        right = -1.0f;
+                }
+                if (left > right)
+                    continue;
+                int spanBegin = std::max(triangle.minX, static_cast<int>(left) - 1);
+                int spanEnd = std::min(triangle.maxX, static_cast<int>(right) + 1);
+                // 宽度是 TILE_SIZE 的倍数, 从4对齐的位置开始不会越过行尾
+                int x = spanBegin & ~3;
+#ifdef OCCLUSION_USE_SSE2
+                __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a[0]), px), _mm_set1_ps(triangle.b[0] * py + triangle.c[0]));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a[1]), px), _mm_set1_ps(triangle.b[1] * py + triangle.c[1]));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a[2]), px), _mm_set1_ps(triangle.b[2] * py + triangle.c[2]));
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.zx), px), _mm_set1_ps(triangle.zy * py + triangle.z0));
+                __m128 step0 = _mm_set1_ps(triangle.a[0] * 4.0f), step1 = _mm_set1_ps(triangle.a[1] * 4.0f);
+                __m128 step2 = _mm_set1_ps(triangle.a[2] * 4.0f), stepZ = _mm_set1_ps(triangle.zx * 4.0f);
+                __m128 zero = _mm_setzero_ps();
+                for (; x <= spanEnd; x += 4)
+                {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    if (_mm_movemask_ps(inside))
+                    {
+                        __m128 old = _mm_loadu_ps(row + x);
+                        __m128 nearer = _mm_min_ps(old, z);
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+                    }
+                    e0 = _mm_add_ps(e0, step0);
+                    e1 = _mm_add_ps(e1, step1);
+                    e2 = _mm_add_ps(e2, step2);
+                    z = _mm_add_ps(z, stepZ);
+                }
+#else
+                for (; x <= spanEnd; x++)
+                {
+                    float px = x + 0.5f;
+                    bool inside = true;
+                    for (int k = 0; k < 3; k++)
+                        inside = inside && triangle.a[k] * px + triangle.b[k] * py + triangle.c[k] >= 0.0f;
+                    if (inside)
+                        row[x] = std::min(row[x], triangle.zx * px + triangle.zy * py + triangle.z0);
+                }
+#endif
+            }
+        }
+    }
+
+    // 层次深度: 每块取最远的深度
+    for (int tileY = tileRowBegin; tileY < tileRowEnd; tileY++)
+        for (int tileX = 0; tileX < tilesX; tileX++)
+        {
+            float farthest = 0.0f;
+            for (int y = tileY * TILE_SIZE; y < (tileY + 1) * TILE_SIZE; y++)
+            {
+                float const *row = depth.data() + static_cast<std::size_t>(y) * width + tileX * TILE_SIZE;
+                for (int x = 0; x < TILE_SIZE; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            tileDepth[static_cast<std::size_t>(tileY) * tilesX + tileX] = farthest;
+        }
+}
+
+void OcclusionCuller::Rasterize(bool parallel)
+{
+    Stopwatch watch;
+    ThreadPool &pool = ThreadPool::Global();
+
+    // 按遮挡物分组准备三角形, 每组的结果放在自己的数组里
+    std::size_t totalTriangles = 0;
+    for (Occluder const &occluder : occluders)
+        totalTriangles += occluder.indexCount / 3;
+    std::size_t groups = parallel ? std::min<std::size_t>(totalTriangles / MIN_TRIANGLES_PER_TASK, (pool.Size() + 1) * 4) : 1;
+    groups = std::clamp<std::size_t>(groups, 1, std::max<std::size_t>(occluders.size(), 1));
+    if (triangles.size() < groups)
+        triangles.resize(groups);
+    for (std::vector<Triangle> &group : triangles)
+        group.clear();
+    auto setupGroup = [&](std::size_t group) {
+        std::size_t begin = occluders.size() * group / groups, end = occluders.size() * (group + 1) / groups;
+        for (std::size_t i = begin; i < end; i++)
+            setupOccluder(occluders[i], triangles[group]);
+    };
+    if (groups > 1)
+        pool.ParallelFor(groups, setupGroup);
+    else
+        setupGroup(0);
+
+    // 每个任务光栅化一带整块的行, 彼此不写同一个像素
+    std::size_t bands = parallel ? std::min<std::size_t>(tilesY, (pool.Size() + 1) * 2) : 1;
+    auto rasterizeBand = [&](std::size_t band) {
+        rasterizeRows(static_cast<int>(tilesY * band / bands), static_cast<int>(tilesY * (band + 1) / bands));
+    };
+    if (bands > 1)
+        pool.ParallelFor(bands, rasterizeBand);
+    else
+        rasterizeBand(0);
+
+    for (std::vector<Triangle> const &group : triangles)
+        stats.occluderTriangles += group.size();
+    stats.rasterMs += watch.ElapsedMs();
+}
+
+bool OcclusionCuller::testBox(glm::vec3 const &min, glm::vec3 const &max, glm::mat4 const &transform) const noexcept
+{
+    // 角点 = min 的变换 + 各轴边长乘对应的列
+    glm::vec4 base = transform * glm::vec4(min, 1.0f);
+    glm::vec3 size = max - min;
+    glm::vec4 edges[3] = {transform[0] * size.x, transform[1] * size.y, transform[2] * size.z};
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = base;
+        for (int axis = 0; axis < 3; axis++)
+            if (corner & (1 << axis))
+                clip += edges[axis];
+        // 跨过近平面的包围盒在相机附近, 按可见处理
+        if (clip.z < -clip.w)
+            return false;
+        float inverseW = 1.0f / clip.w;
+        float x = clip.x * inverseW * (width - 1) * 0.5f + width * 0.5f, y = clip.y * inverseW * (height - 1) * 0.5f + height * 0.5f;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+    }
+    // 有深度的像素整个被一个三角形盖住 (见 setupTriangle), 所以只需看与矩形相交的像素 [x, x + 1) x [y, y + 1)
+    int x0 = std::max(0, static_cast<int>(std::floor(minX))), x1 = std::min(width - 1, static_cast<int>(std::floor(maxX)));
+    int y0 = std::max(0, static_cast<int>(std::floor(minY))), y1 = std::min(height - 1, static_cast<int>(std::floor(maxY)));
+    if (x0 > x1 || y0 > y1 || nearest > 1.0f)
+        return false;
+
+    for (int tileY = y0 / TILE_SIZE; tileY <= y1 / TILE_SIZE; tileY++)
+        for (int tileX = x0 / TILE_SIZE; tileX <= x1 / TILE_SIZE; tileX++)
+        {
+            // 整块都比包围盒近, 不用看像素
+            if (tileDepth[static_cast<std::size_t>(tileY) * tilesX + tileX] < nearest)
+                continue;
+            int rowBegin = std::max(y0, tileY * TILE_SIZE), rowEnd = std::min(y1, tileY * TILE_SIZE + TILE_SIZE - 1);
+            int columnBegin = std::max(x0, tileX * TILE_SIZE), columnEnd = std::min(x1, tileX * TILE_SIZE + TILE_SIZE - 1);
+            for (int y = rowBegin; y <= rowEnd; y++)
+            {
+                float const *row = depth.data() + static_cast<std::size_t>(y) * width;
+                for (int x = columnBegin; x <= columnEnd; x++)
+                    if (row[x] >= nearest)
+                        return false;
+            }
+        }
+    return true;
+}
+
+bool OcclusionCuller::IsOccluded(glm::vec3 const &min, glm::vec3 const &max, glm::mat4 const &model)
+{
+    Stopwatch watch;
+    bool occluded = testBox(min, max, viewProjection * model);
+    stats.tested++;
+    stats.occluded += occluded ? 1 : 0;
+    stats.testMs += watch.ElapsedMs();
+    return occluded;
+}
+
+void OcclusionCuller::Filter(FrustumCuller const &bounds, std::vector<std::uint32_t> &indices, bool parallel)
+{
+    Stopwatch watch;
+    std::size_t count = indices.size();
+    std::size_t tasks = parallel ? std::min<std::size_t>(count / MIN_TESTS_PER_TASK, (ThreadPool::Global().Size() + 1) * 4) : 0;
+    if (tasks <= 1)
+    {
+        indices.erase(std::remove_if(indices.begin(), indices.end(),
+                                     [&](std::uint32_t i) { return testBox(bounds.GetMin(i), bounds.GetMax(i), viewProjection); }),
+                      indices.end());
+    }
+    else
+    {
+        // 每块的结果按顺序拼起来, 与单线程相同
+        if (chunks.size() < tasks)
+            chunks.resize(tasks);
+        ThreadPool::Global().ParallelFor(tasks, [&](std::size_t task) {
+            std::vector<std::uint32_t> &chunk = chunks[task];
+            chunk.clear();
+            for (std::size_t j = count * task / tasks; j < count * (task + 1) / tasks; j++)
+                if (!testBox(bounds.GetMin(indices[j]), bounds.GetMax(indices[j]), viewProjection))
+                    chunk.push_back(indices[j]);
+        });
+        indices.clear();
+        for (std::size_t task = 0; task < tasks; task++)
+            indices.insert(indices.end(), chunks[task].begin(), chunks[task].end());
+    }
+    stats.tested += count;
+    stats.occluded += count - indices.size();
+    stats.testMs += watch.ElapsedMs();
+}
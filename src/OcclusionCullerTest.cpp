@@ -0,0 +1,181 @@
+// OcclusionCuller 的测试: 遮挡物之间窄于一个像素的缝后面的物体不能被剔除; 随机的城市场景里, 被剔除的物体
+// 表面上每个画面内的采样点都要被别的遮挡物挡住. 只用CPU
+#include <Frustum.h>
+#include <FrustumCuller.h>
+#include <OcclusionCuller.h>
+#include <TestCheck.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+    TestCheck check("OCCLUSIONCULLER_TEST");
+
+    // 单位立方体, 三角形从外面看是逆时针
+    const glm::vec3 CUBE_VERTICES[8] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+    const unsigned int CUBE_INDICES[36] = {0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4,
+                                           2, 6, 7, 2, 7, 3, 0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6};
+
+    struct Box
+    {
+        glm::vec3 min, max;
+    };
+
+    glm::mat4 boxModel(Box const &box)
+    {
+        return glm::scale(glm::translate(glm::mat4(1.0f), box.min), box.max - box.min);
+    }
+
+    // 线段 eye + t * (point - eye), t in [0, limit) 进入 box 的 t; 不相交时返回 limit
+    float segmentEnter(glm::vec3 const &eye, glm::vec3 const &point, Box const &box, float limit)
+    {
+        glm::vec3 direction = point - eye;
+        float enter = 0.0f, leave = limit;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::abs(direction[axis]) < 1e-6f)
+            {
+                if (eye[axis] < box.min[axis] || eye[axis] > box.max[axis])
+                    return limit;
+                continue;
+            }
+            float t0 = (box.min[axis] - eye[axis]) / direction[axis], t1 = (box.max[axis] - eye[axis]) / direction[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            leave = std::min(leave, std::max(t0, t1));
+        }
+        return enter < leave ? enter : limit;
+    }
+
+    // 两面墙之间留 1/3 像素宽的缝, 缝不经过任何像素中心; 缝后面的细长物体看得见
+    void testSubPixelGap()
+    {
+        OcclusionCuller occlusion(256, 192);
+        glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+        // 距离10处一个像素宽 2 * 10 * tan(30°) * 4/3 / 256 ≈ 0.06
+        float pixel = 2.0f * 10.0f * std::tan(glm::radians(30.0f)) * 4.0f / 3.0f / 256.0f;
+        float gap = pixel / 3.0f;
+        Box left{glm::vec3(-20.0f, -20.0f, -11.0f), glm::vec3(-gap * 0.5f, 20.0f, -10.0f)};
+        Box right{glm::vec3(gap * 0.5f, -20.0f, -11.0f), glm::vec3(20.0f, 20.0f, -10.0f)};
+        occlusion.Begin(viewProjection);
+        occlusion.AddOccluder(CUBE_VERTICES, sizeof(glm::vec3), CUBE_INDICES, 36, boxModel(left), true);
+        occlusion.AddOccluder(CUBE_VERTICES, sizeof(glm::vec3), CUBE_INDICES, 36, boxModel(right), true);
+        occlusion.Rasterize(false);
+
+        Box behindGap{glm::vec3(-0.05f, -1.0f, -31.0f), glm::vec3(0.05f, 1.0f, -30.0f)};
+        check(!occlusion.IsOccluded(behindGap.min, behindGap.max), "object behind a sub-pixel gap was culled");
+        FrustumCuller bounds;
+        bounds.Add(behindGap.min, behindGap.max);
+        std::vector<std::uint32_t> visible = {0};
+        occlusion.Filter(bounds, visible, false);
+        check(visible.size() == 1, "Filter culled the object behind a sub-pixel gap");
+
+        // 同样远、完全在一面墙后面的物体仍要被剔除, 否则上面的结果没有意义
+        Box behindWall{glm::vec3(-4.0f, 2.0f, -31.0f), glm::vec3(-3.0f, 3.0f, -30.0f)};
+        check(occlusion.IsOccluded(behindWall.min, behindWall.max), "object fully behind a wall was not culled");
+        // 在墙前面的物体不被剔除
+        Box inFront{glm::vec3(-4.0f, 2.0f, -6.0f), glm::vec3(-3.0f, 3.0f, -5.0f)};
+        check(!occlusion.IsOccluded(inFront.min, inFront.max), "object in front of the wall was culled");
+    }
+
+    // 随机街区: 楼房之间的缝从几厘米到一米多, 行人高度的视角; 被剔除的物体每个面上 3x3 个采样点
+    // (略向内收, 只看画面内的) 与眼睛的连线在进入物体之前都要穿过别的楼
+    void testRandomCity()
+    {
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<Box> buildings;
+        const int ROWS = 10, LOTS = 12;
+        for (int row = 0; row < ROWS; row++)
+        {
+            float x = 0.0f;
+            for (int lot = 0; lot < LOTS; lot++)
+            {
+                float width = 4.0f + unit(random) * 10.0f, gap = 0.02f + unit(random) * 1.5f;
+                float z = row * 30.0f;
+                buildings.push_back(Box{glm::vec3(x, 0.0f, z), glm::vec3(x + width, 6.0f + unit(random) * 30.0f, z + 15.0f)});
+                x += width + gap;
+            }
+        }
+        std::vector<Box> objects = buildings;
+        for (int i = 0; i < 1500; i++)
+        {
+            glm::vec3 min(unit(random) * 150.0f, unit(random) * 3.0f, unit(random) * ROWS * 30.0f);
+            objects.push_back(Box{min, min + glm::vec3(0.3f + unit(random) * 3.0f, 0.3f + unit(random) * 2.0f, 0.3f + unit(random) * 3.0f)});
+        }
+        FrustumCuller scene;
+        for (Box const &object : objects)
+            scene.Add(object.min, object.max);
+
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.5f, 500.0f);
+        std::size_t occludedTotal = 0, checkedPoints = 0;
+        for (int view = 0; view < 8; view++)
+        {
+            // 眼睛在两排楼之间的街上
+            glm::vec3 eye(unit(random) * 150.0f, 1.7f + (view == 7 ? 40.0f : 0.0f), (view % ROWS) * 30.0f + 22.5f);
+            glm::vec3 target = eye + glm::vec3(std::cos(view * 0.9f), view == 7 ? -0.5f : 0.05f, std::sin(view * 0.9f));
+            glm::mat4 viewProjection = projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+            for (int resolution : {128, 256})
+            {
+                OcclusionCuller occlusion(resolution, resolution * 3 / 4);
+                std::vector<std::uint32_t> inFrustum;
+                scene.Cull(Frustum(viewProjection), inFrustum, false);
+                occlusion.Begin(viewProjection);
+                for (std::uint32_t i : inFrustum)
+                    if (i < buildings.size())
+                        occlusion.AddOccluder(CUBE_VERTICES, sizeof(glm::vec3), CUBE_INDICES, 36, boxModel(buildings[i]), true);
+                occlusion.Rasterize(false);
+                std::vector<std::uint32_t> visible = inFrustum, visibleParallel = inFrustum;
+                occlusion.Filter(scene, visible, false);
+                occlusion.Filter(scene, visibleParallel, true);
+                check(visible == visibleParallel, "parallel Filter differs from single-threaded Filter");
+
+                std::vector<std::uint32_t> occluded;
+                std::set_difference(inFrustum.begin(), inFrustum.end(), visible.begin(), visible.end(), std::back_inserter(occluded));
+                occludedTotal += occluded.size();
+                for (std::uint32_t index : occluded)
+                {
+                    Box const &object = objects[index];
+                    check(occlusion.IsOccluded(object.min, object.max), "IsOccluded differs from Filter");
+                    glm::vec3 middle = (object.min + object.max) * 0.5f;
+                    bool seen = false;
+                    for (int face = 0; face < 6 && !seen; face++)
+                        for (int u = 0; u < 3 && !seen; u++)
+                            for (int v = 0; v < 3 && !seen; v++)
+                            {
+                                int axis = face / 2, uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+                                glm::vec3 point;
+                                point[axis] = face % 2 ? object.max[axis] : object.min[axis];
+                                point[uAxis] = glm::mix(object.min[uAxis], object.max[uAxis], u * 0.5f);
+                                point[vAxis] = glm::mix(object.min[vAxis], object.max[vAxis], v * 0.5f);
+                                point = glm::mix(middle, point, 0.98f);
+                                glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+                                if (std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w)
+                                    continue;
+                                checkedPoints++;
+                                float own = segmentEnter(eye, point, object, 1.0f);
+                                bool blocked = false;
+                                for (std::size_t b = 0; b < buildings.size() && !blocked; b++)
+                                    blocked = b != index && segmentEnter(eye, point, buildings[b], own) < own;
+                                seen = !blocked;
+                            }
+                    check(!seen, "a culled object has a clear ray from the eye");
+                }
+            }
+        }
+        check(occludedTotal > 0 && checkedPoints > 0, "the random city culled nothing, the test checks nothing");
+    }
+}
+
+int main()
+{
+    testSubPixelGap();
+    testRandomCity();
+    return check.Finish("OcclusionCuller");
+}
@@ -0,0 +1,132 @@
+#include "PixelUploadRing.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+PixelUploadRing::PixelUploadRing()
+{
+#ifdef GL_ARB_buffer_storage
+    persistent = GLAD_GL_ARB_buffer_storage != 0;
+#endif
+    for (auto &slot : slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+        GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+#ifdef GL_ARB_buffer_storage
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SLOT_SIZE, nullptr, flags);
+            slot.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SLOT_SIZE, flags);
+            continue;
+        }
+#endif
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, SLOT_SIZE, nullptr, GL_STREAM_DRAW);
+    }
+    GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void PixelUploadRing::TexImage2D(GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format,
+                                 GLenum type, const void *pixels, std::size_t bytes)
+{
+    if (!stage(pixels, bytes))
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, type, pixels);
+        return;
+    }
+    glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, type, nullptr);
+    finish(bytes);
+}
+
+void PixelUploadRing::CompressedTexImage2D(GLint level, GLenum internalFormat, GLsizei width, GLsizei height,
+                                           const void *data, std::size_t bytes)
+{
+    if (!stage(data, bytes))
+    {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, static_cast<GLsizei>(bytes), data);
+        return;
+    }
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, static_cast<GLsizei>(bytes), nullptr);
+    finish(bytes);
+}
+
+void PixelUploadRing::TexImage3D(GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei layers,
+                                 GLenum format, GLenum type, const void *pixels, std::size_t bytes)
+{
+    if (!stage(pixels, bytes))
+    {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, layers, 0, format, type, pixels);
+        return;
+    }
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, layers, 0, format, type, nullptr);
+    finish(bytes);
+}
+
+void PixelUploadRing::CompressedTexImage3D(GLint level, GLenum internalFormat, GLsizei width, GLsizei height,
+                                           GLsizei layers, const void *data, std::size_t bytes)
+{
+    if (!stage(data, bytes))
+    {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, layers, 0,
+                               static_cast<GLsizei>(bytes), data);
+        return;
+    }
+    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, layers, 0,
+                           static_cast<GLsizei>(bytes), nullptr);
+    finish(bytes);
+}
+
+bool PixelUploadRing::stage(const void *pixels, std::size_t bytes)
+{
+    if (bytes > SLOT_SIZE)
+    {
+        stats.fallbacks++;
+        return false;
+    }
+
+    Slot &slot = slots[next];
+    // 这个缓冲上一次的传输还没完成时只能等待
+    if (slot.fence)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        std::chrono::duration<double, std::milli> stall = std::chrono::steady_clock::now() - start;
+        stats.stallMs += stall.count();
+        stats.maxStallMs = std::max(stats.maxStallMs, stall.count());
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (slot.mapped)
+    {
+        std::memcpy(slot.mapped, pixels, bytes);
+        return true;
+    }
+    // 已经用fence确认GPU读完, 不需要驱动再同步
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!mapped)
+    {
+        GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stats.fallbacks++;
+        return false;
+    }
+    std::memcpy(mapped, pixels, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return true;
+}
+
+void PixelUploadRing::finish(std::size_t bytes)
+{
+    Slot &slot = slots[next];
+    next = (next + 1) % SLOT_COUNT;
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    stats.uploads++;
+    stats.bytes += bytes;
+}
@@ -0,0 +1,106 @@
+#include "ProgramCache.h"
+#include "CacheFile.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    constexpr char MAGIC[4] = {'L', 'G', 'P', 'C'};
+
+    struct CacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t binaryFormat;
+        std::uint32_t binarySize;
+    };
+
+    std::string_view glString(GLenum name)
+    {
+        const GLubyte *value = glGetString(name);
+        return value ? std::string_view(reinterpret_cast<const char *>(value)) : std::string_view();
+    }
+}
+
+bool ProgramCache::Supported()
+{
+#ifdef GL_ARB_get_program_binary
+    if (!GLAD_GL_ARB_get_program_binary)
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+#else
+    return false;
+#endif
+}
+
+std::uint64_t ProgramCache::Key(std::string_view vertexSource, std::string_view fragmentSource, std::string_view defines)
+{
+    std::uint64_t h = CacheFile::HASH_SEED;
+    h = CacheFile::Hash(h, vertexSource);
+    h = CacheFile::Hash(h, fragmentSource);
+    h = CacheFile::Hash(h, defines);
+    h = CacheFile::Hash(h, glString(GL_VENDOR));
+    h = CacheFile::Hash(h, glString(GL_RENDERER));
+    return CacheFile::Hash(h, glString(GL_VERSION));
+}
+
+std::string ProgramCache::CachePath(std::string const &vertexPath, std::string const &fragmentPath, std::string_view defines)
+{
+    std::uint64_t h = CacheFile::Hash(CacheFile::Hash(CacheFile::HASH_SEED, fragmentPath), defines);
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+    return vertexPath + '.' + hex + ".progcache";
+}
+
+bool ProgramCache::Load(GLuint program, std::string const &cachePath, std::uint64_t key)
+{
+#ifdef GL_ARB_get_program_binary
+    MappedFile file(cachePath);
+    if (!CacheFile::CheckMagic(file.Data(), file.Size(), MAGIC, VERSION) || file.Size() < sizeof(CacheHeader))
+        return false;
+    CacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (header.key != key || header.binarySize > file.Size() - sizeof(header))
+        return false;
+    glProgramBinary(program, header.binaryFormat, file.Data() + sizeof(header), static_cast<GLsizei>(header.binarySize));
+    // 驱动可以拒绝任何二进制 (例如驱动内部版本变了), 此时链接状态为失败
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+#else
+    return false;
+#endif
+}
+
+bool ProgramCache::Save(GLuint program, std::string const &cachePath, std::uint64_t key)
+{
+#ifdef GL_ARB_get_program_binary
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    return CacheFile::Write(cachePath, "PROGRAMCACHE", [&](std::ofstream &out) {
+        CacheHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.key = key;
+        header.binaryFormat = format;
+        header.binarySize = static_cast<std::uint32_t>(length);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(binary.data(), length);
+    });
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,48 @@
+#include "RadixSort.h"
+
+#include <cstddef>
+
+namespace RadixSort
+{
+    void Sort(std::vector<std::uint64_t> &keys, std::vector<std::uint64_t> &scratch, int lowBit, int highBit)
+    {
+        const int DIGIT_BITS = 11;
+        const int BUCKETS = 1 << DIGIT_BITS;
+        const int MAX_PASSES = (64 + DIGIT_BITS - 1) / DIGIT_BITS;
+        std::size_t count = keys.size();
+        if (count < 2 || lowBit >= highBit)
+            return;
+        int passes = (highBit - lowBit + DIGIT_BITS - 1) / DIGIT_BITS;
+        // 48KB, 放在栈上以便多个线程同时排序; 计数用32位, 键数不超过 2^32
+        std::uint32_t histograms[MAX_PASSES][BUCKETS];
+        for (int pass = 0; pass < passes; pass++)
+            for (int bucket = 0; bucket < BUCKETS; bucket++)
+                histograms[pass][bucket] = 0;
+        for (std::uint64_t key : keys)
+        {
+            key >>= lowBit;
+            for (int pass = 0; pass < passes; pass++)
+                histograms[pass][(key >> (pass * DIGIT_BITS)) & (BUCKETS - 1)]++;
+        }
+
+        scratch.resize(count);
+        for (int pass = 0; pass < passes; pass++)
+        {
+            std::uint32_t *histogram = histograms[pass];
+            int shift = lowBit + pass * DIGIT_BITS;
+            // 这一段全部相同, 顺序不变
+            if (histogram[(keys[0] >> shift) & (BUCKETS - 1)] == count)
+                continue;
+            std::uint32_t offset = 0;
+            for (int bucket = 0; bucket < BUCKETS; bucket++)
+            {
+                std::uint32_t size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+            for (std::uint64_t key : keys)
+                scratch[histogram[(key >> shift) & (BUCKETS - 1)]++] = key;
+            keys.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+// RadixSort::Sort 和 SortKey 的测试: 与 std::stable_sort 的结果逐个相同, 相同的键保持加入的顺序. 只用CPU
+#include <RadixSort.h>
+#include <SortKey.h>
+#include <TestCheck.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+    TestCheck check("RADIXSORT_TEST");
+
+    // 只比较 [lowBit, highBit) 位的稳定排序作参照
+    std::vector<std::uint64_t> reference(std::vector<std::uint64_t> keys, int lowBit, int highBit)
+    {
+        std::uint64_t mask = (highBit == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << highBit) - 1) >> lowBit << lowBit;
+        std::stable_sort(keys.begin(), keys.end(), [mask](std::uint64_t a, std::uint64_t b) { return (a & mask) < (b & mask); });
+        return keys;
+    }
+
+    // 排序的位取 distinct 种不同的值, 低位放下标
+    std::vector<std::uint64_t> makeKeys(std::size_t count, int lowBit, int highBit, std::uint64_t distinct, std::mt19937_64 &random)
+    {
+        std::vector<std::uint64_t> values(distinct);
+        for (std::uint64_t &value : values)
+            value = (random() << lowBit) & ((highBit == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << highBit) - 1));
+        std::uniform_int_distribution<std::size_t> pick(0, distinct - 1);
+        std::vector<std::uint64_t> keys(count);
+        for (std::size_t i = 0; i < count; i++)
+            keys[i] = values[pick(random)] | (lowBit ? i & ((std::uint64_t(1) << lowBit) - 1) : 0);
+        return keys;
+    }
+}
+
+int main()
+{
+    std::mt19937_64 random(1);
+    std::vector<std::uint64_t> scratch;
+
+    // 各种位区间、键数和重复程度; 重复多的情况检验稳定性, 只有一种值时所有趟都跳过
+    struct Case
+    {
+        int lowBit, highBit;
+        std::size_t count;
+        std::uint64_t distinct;
+    };
+    Case const cases[] = {
+        {0, 64, 1000, 1000},       {0, 64, 5000, 7},
+        {20, 64, 100000, 300},     {SortKey::INDEX_BITS, SortKey::HIGH_BIT, 100000, 100000},
+        {SortKey::INDEX_BITS, SortKey::HIGH_BIT, 50000, 3}, {32, 64, 10000, 50},
+        {20, 53, 4096, 1},         {0, 11, 3000, 2048},
+        {0, 64, 1, 1},             {5, 40, 2, 2},
+    };
+    for (Case const &c : cases)
+    {
+        std::vector<std::uint64_t> keys = makeKeys(c.count, c.lowBit, c.highBit, c.distinct, random);
+        std::vector<std::uint64_t> expected = reference(keys, c.lowBit, c.highBit);
+        RadixSort::Sort(keys, scratch, c.lowBit, c.highBit);
+        check(keys == expected, "radix sort differs from std::stable_sort");
+    }
+
+    // 空输入和 lowBit >= highBit 时什么都不做
+    std::vector<std::uint64_t> empty;
+    RadixSort::Sort(empty, scratch);
+    check(empty.empty(), "empty input changed");
+    std::vector<std::uint64_t> unsorted = {3, 1, 2};
+    RadixSort::Sort(unsorted, scratch, 40, 40);
+    check(unsorted == std::vector<std::uint64_t>({3, 1, 2}), "empty bit range reordered keys");
+
+    // 排序键: 不透明在透明之前, 同一状态的不透明由近到远, 透明由远到近; 键不超出 HIGH_BIT
+    using SortKey::Layer;
+    std::uint64_t nearOpaque = SortKey::Make(Layer::Opaque, 63, 1023, 15, 1.0f);
+    std::uint64_t farOpaque = SortKey::Make(Layer::Opaque, 63, 1023, 15, 50.0f);
+    std::uint64_t nearTransparent = SortKey::Make(Layer::Transparent, 0, 0, 0, 1.0f);
+    std::uint64_t farTransparent = SortKey::Make(Layer::Transparent, 0, 0, 0, 50.0f);
+    check(nearOpaque < farOpaque, "opaque draws are not sorted near to far");
+    check(farTransparent < nearTransparent, "transparent draws are not sorted far to near");
+    check(farOpaque < farTransparent, "opaque draws do not come before transparent ones");
+    check(SortKey::Make(Layer::Opaque, 1, 0, 0, 99.0f) < SortKey::Make(Layer::Opaque, 2, 0, 0, 0.5f),
+          "program does not take precedence over depth for opaque draws");
+    check(SortKey::Make(Layer::Opaque, 0, 0, 0, -1.0f) == SortKey::Make(Layer::Opaque, 0, 0, 0, 0.0f), "negative depth is not clamped");
+    for (std::uint64_t key : {nearOpaque, farOpaque, nearTransparent, farTransparent})
+        check((key >> SortKey::HIGH_BIT) == 0 && (key & (SortKey::MAX_ITEMS - 1)) == 0, "key uses bits outside its sort field");
+
+    return check.Finish("RadixSort");
+}
@@ -0,0 +1,55 @@
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "Mesh.h"
+
+#include <chrono>
+#include <glm/gtc/type_ptr.hpp>
+
+void RenderQueue::SetCamera(glm::mat4 const &viewProjection_, glm::vec3 const &eye_) noexcept
+{
+    viewProjection = viewProjection_;
+    eye = eye_;
+}
+
+void RenderQueue::Push(Layer layer, ShaderProgram &shader, Mesh &mesh, unsigned int lod, glm::mat4 const &model, float depth,
+                       bool clusters)
+{
+    if (items.size() >= MAX_ITEMS)
+        return;
+    std::uint64_t key = SortKey::Make(layer, shader.get_id(), mesh.GetMaterialKey(), mesh.GetVertexArray(), depth);
+    keys.push_back(key | items.size());
+    items.push_back(Item{&shader, &mesh, model, lod, clusters});
+}
+
+void RenderQueue::Submit()
+{
+    auto start = std::chrono::steady_clock::now();
+    RadixSort::Sort(keys, scratch, INDEX_BITS, SortKey::HIGH_BIT);
+    sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    ShaderProgram *current = nullptr;
+    UniformHandle modelUniform;
+    for (std::uint64_t key : keys)
+    {
+        Item &item = items[key & (MAX_ITEMS - 1)];
+        if (item.shader != current)
+        {
+            current = item.shader;
+            current->use();
+            // 还在编译的程序画的是占位程序, 不在这里等它
+            modelUniform = current->is_ready() ? current->get_uniform("model") : UniformHandle();
+        }
+        current->set_uniform(modelUniform, 1, GL_FALSE, glm::value_ptr(item.model));
+        if (item.clusters)
+        {
+            // 网格簇剔除在物体空间进行
+            Frustum frustum(viewProjection * item.model);
+            glm::vec3 localEye = glm::vec3(glm::inverse(item.model) * glm::vec4(eye, 1.0f));
+            item.mesh->DrawClusters(*current, frustum, localEye);
+        }
+        else
+            item.mesh->Draw(*current, item.lod);
+    }
+    items.clear();
+    keys.clear();
+}
@@ -1,6 +1,13 @@
 #include "Shader.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <string_view>
+#include <unordered_set>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -10,7 +17,14 @@
 // 1. 从文件路径中获取顶点/片段着色器
 //---------------------------------------------------------------------------------------
 Shader::Shader(std::string_view file_path)
-:id_{0}{
+:id_{0}, source_{read_source(file_path)}{
+}
+
+Shader::Shader(from_source_t, std::string source)
+:id_{0}, source_{std::move(source)}{
+}
+
+std::string Shader::read_source(std::string_view file_path){
     std::ifstream fs{};
     // 保证ifstream对象可以抛出异常
     fs.exceptions(std::ifstream::failbit|std::ifstream::badbit);
@@ -24,11 +38,41 @@ Shader::Shader(std::string_view file_path)
         // 关闭文件处理器
         fs.close();
         // 转换数据流到string
-        source_ = ss.str();
+        return ss.str();
     }
     catch(std::ifstream::failure e){
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;        
     }
+    return std::string{};
+}
+
+std::string Shader::inject_defines(std::string source, ShaderDefines const &defines){
+    if(defines.empty())
+        return source;
+    std::string block;
+    for(auto const &[name, value] : defines)
+        block += "#define " + name + ' ' + value + '\n';
+    // #version 必须是第一条语句, 宏放在它后面; 没有 #version 时放在最前面
+    std::size_t insert = 0;
+    int line = 1;
+    std::size_t version = source.find("#version");
+    if(version != std::string::npos){
+        std::size_t end = source.find('\n', version);
+        insert = end == std::string::npos ? source.size() : end + 1;
+        line = 1 + static_cast<int>(std::count(source.begin(), source.begin() + static_cast<std::ptrdiff_t>(insert), '\n'));
+        if(end == std::string::npos)
+            block.insert(0, 1, '\n');
+    }
+    block += "#line " + std::to_string(line) + '\n';
+    source.insert(insert, block);
+    return source;
+}
+
+std::string Shader::defines_key(ShaderDefines const &defines){
+    std::string key;
+    for(auto const &[name, value] : defines)
+        key += name + '=' + value + ';';
+    return key;
 }
 
 Shader::~Shader(){
@@ -39,14 +83,17 @@ Shader::~Shader(){
 //---------------------------------------------------------------------------------------
 // 2. 编译着色器
 //---------------------------------------------------------------------------------------
-VertexShader::VertexShader(std::string_view file_path)
-:Shader{file_path}{
-    //创建一个ID引用的顶点着色器对象
-    id_ = glCreateShader(GL_VERTEX_SHADER);
+void Shader::compile(GLenum type, const char *stage){
+    stage_ = stage;
+    //创建一个ID引用的着色器对象
+    id_ = glCreateShader(type);
     auto source_str = source_.c_str();
     //把着色器源码附加到着色器对象上，然后编译
     glShaderSource(id_, 1, &source_str, NULL);//第二参数指定了传递的源码字符串数量，这里只有一个
     glCompileShader(id_);
+}
+
+bool Shader::compiled() const{
     //检测编译时错误
     int success;
     char infoLog[512];
@@ -54,75 +101,343 @@ VertexShader::VertexShader(std::string_view file_path)
     //获取错误消息
     if(!success){
         glGetShaderInfoLog(id_, 512, NULL, infoLog);
-        std::cout<<"ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"<<infoLog<<std::endl;
+        std::cout<<"ERROR::SHADER::"<<stage_<<"::COMPILATION_FAILED\n"<<infoLog<<std::endl;
     }
+    return success != 0;
+}
+
+VertexShader::VertexShader(std::string_view file_path)
+:Shader{file_path}{
+    compile(GL_VERTEX_SHADER, "VERTEX");
+    compiled();
+}
+
+VertexShader::VertexShader(from_source_t, std::string source)
+:Shader{from_source, std::move(source)}{
+    compile(GL_VERTEX_SHADER, "VERTEX");
 }
 
 FragmentShader::FragmentShader(std::string_view file_path)
 :Shader{file_path}{
-    //创建一个ID引用的片段着色器对象
-    id_ = glCreateShader(GL_FRAGMENT_SHADER);
-    auto source_str = source_.c_str();
-    glShaderSource(id_, 1, &source_str, NULL);
-    glCompileShader(id_);
-    //检测编译时错误
-    int success;
-    char infoLog[512];
-    glGetShaderiv(id_, GL_COMPILE_STATUS, &success);
-    //获取错误消息
-    if(!success){
-        glGetShaderInfoLog(id_, 512, NULL, infoLog);
-        std::cout<<"ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"<<infoLog<<std::endl;
-    }
+    compile(GL_FRAGMENT_SHADER, "FRAGMENT");
+    compiled();
+}
+
+FragmentShader::FragmentShader(from_source_t, std::string source)
+:Shader{from_source, std::move(source)}{
+    compile(GL_FRAGMENT_SHADER, "FRAGMENT");
 }
 //---------------------------------------------------------------------------------------
 // 3. 着色器程序
 //---------------------------------------------------------------------------------------
-ShaderProgram::ShaderProgram(std::string_view vertex_shader, std::string_view fragment_shader)
+ShaderProgram::Stats ShaderProgram::stats_;
+
+namespace{
+// 异步构建完成前 use() 绑定的程序: 所有顶点都在裁剪空间之外, 不产生任何片段.
+// 只有几行源码, 第一次需要时同步编译
+unsigned placeholder_program(){
+    static unsigned id = []{
+        VertexShader vertexShader{Shader::from_source,
+            "#version 330 core\nvoid main(){ gl_Position = vec4(0.0, 0.0, 2.0, 1.0); }\n"};
+        FragmentShader fragmentShader{Shader::from_source,
+            "#version 330 core\nout vec4 FragColor;\nvoid main(){ FragColor = vec4(0.0); }\n"};
+        unsigned program = glCreateProgram();
+        glAttachShader(program, vertexShader.get_id());
+        glAttachShader(program, fragmentShader.get_id());
+        glLinkProgram(program);
+        glDetachShader(program, vertexShader.get_id());
+        glDetachShader(program, fragmentShader.get_id());
+        return program;
+    }();
+    return id;
+}
+
+// 让驱动按自己的上限开后台编译线程, 进程内设置一次
+void enable_parallel_compile(){
+#ifdef GL_KHR_parallel_shader_compile
+    static bool enabled = false;
+    if(!enabled && GLAD_GL_KHR_parallel_shader_compile){
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        enabled = true;
+    }
+#endif
+}
+}
+
+ShaderProgram::ShaderProgram(std::string_view vertex_shader, std::string_view fragment_shader, BuildMode mode)
+:ShaderProgram{vertex_shader, fragment_shader, ShaderDefines{}, mode}{
+}
+
+ShaderProgram::ShaderProgram(std::string_view vertex_shader, std::string_view fragment_shader, ShaderDefines const &defines,
+                             BuildMode mode)
 :id_{0}{
-    VertexShader vertexShader{vertex_shader};
-    FragmentShader fragmentShader{fragment_shader};
+    auto start = std::chrono::steady_clock::now();
+    std::string vertexSource = Shader::inject_defines(Shader::read_source(vertex_shader), defines);
+    std::string fragmentSource = Shader::inject_defines(Shader::read_source(fragment_shader), defines);
+    std::string definesKey = Shader::defines_key(defines);
 
     id_ = glCreateProgram();
-    //把之前编译的着色器附加到程序对象上，然后链接它们
-    glAttachShader(id_, vertexShader.get_id());
-    glAttachShader(id_, fragmentShader.get_id());
+    auto build = std::make_unique<PendingBuild>();
+    build->useCache = ProgramCache::Supported();
+    if(build->useCache){
+        build->key = ProgramCache::Key(vertexSource, fragmentSource, definesKey);
+        build->cachePath = ProgramCache::CachePath(std::string{vertex_shader}, std::string{fragment_shader}, definesKey);
+        if(ProgramCache::Load(id_, build->cachePath, build->key)){
+            std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+            stats_.cacheHits++;
+            stats_.cacheMs += time.count();
+            reflect_uniforms();
+            return;
+        }
+        // 未命中或驱动拒绝了二进制, 换一个干净的程序对象重新编译
+        glDeleteProgram(id_);
+        id_ = glCreateProgram();
+#ifdef GL_ARB_get_program_binary
+        glProgramParameteri(id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    }
+
+    if(mode == BuildMode::Async){
+        enable_parallel_compile();
+        stats_.asyncBuilds++;
+    }
+    pending_ = std::move(build);
+    submit(std::move(vertexSource), std::move(fragmentSource));
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    pending_->submitMs = time.count();
+    if(mode == BuildMode::Sync)
+        finish();
+}
+
+void ShaderProgram::submit(std::string vertex_source, std::string fragment_source){
+    pending_->vertex = std::make_unique<VertexShader>(Shader::from_source, std::move(vertex_source));
+    pending_->fragment = std::make_unique<FragmentShader>(Shader::from_source, std::move(fragment_source));
+
+    //把之前编译的着色器附加到程序对象上，然后链接它们. 编译和链接的结果都留到 finish 再查询
+    glAttachShader(id_, pending_->vertex->get_id());
+    glAttachShader(id_, pending_->fragment->get_id());
     glLinkProgram(id_);
+}
+
+bool ShaderProgram::finish() const{
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<PendingBuild> build = std::move(pending_);
+    // 两个阶段的日志都要打印, 不短路
+    bool compiled = build->vertex->compiled();
+    compiled = build->fragment->compiled() && compiled;
     //检测链接时错误
     int success;
     char infoLog[512] = "\0";
     glGetProgramiv(id_, GL_LINK_STATUS, &success);
     //获取错误消息
-    if(!success){
-        glGetShaderInfoLog(id_, 512, NULL, infoLog);
+    if(!success && compiled){
+        glGetProgramInfoLog(id_, 512, NULL, infoLog);
         std::cout<<"ERROR::SHADER::PROGRAM::LINKING_FAILED\n"<<infoLog<<std::endl;
     }
+    // 链接后着色器对象不再需要, build 析构时删除
+    glDetachShader(id_, build->vertex->get_id());
+    glDetachShader(id_, build->fragment->get_id());
+    if(success && build->useCache && !ProgramCache::Save(id_, build->cachePath, build->key))
+        std::cout << "WARNING::PROGRAMCACHE::could not write " << build->cachePath << std::endl;
+    reflect_uniforms();
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    stats_.compiled++;
+    stats_.compileMs += build->submitMs + time.count();
+    return success != 0;
+}
+
+bool ShaderProgram::is_ready() const noexcept{
+    if(!pending_)
+        return true;
+#ifdef GL_KHR_parallel_shader_compile
+    if(GLAD_GL_KHR_parallel_shader_compile){
+        // 链接完成意味着两个着色器也编译完了
+        GLint done = GL_FALSE;
+        glGetProgramiv(id_, GL_COMPLETION_STATUS_KHR, &done);
+        if(!done)
+            return false;
+    }
+#endif
+    finish();
+    return true;
+}
+
+void ShaderProgram::wait() const noexcept{
+    if(pending_)
+        finish();
+}
+
+// 链接后一次性取出所有活动uniform的位置. 数组登记 name、name[0] 以及每个元素 name[i];
+// uniform块中的成员没有位置, 不登记
+void ShaderProgram::reflect_uniforms() const{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+    for(GLint i = 0; i < count; i++){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id_, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.data());
+        std::string uniform = name.substr(0, static_cast<std::size_t>(length));
+        GLint location = glGetUniformLocation(id_, uniform.c_str());
+        if(location < 0)
+            continue;
+        uniforms_[uniform] = location;
+        if(uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0){
+            std::string base = uniform.substr(0, uniform.size() - 3);
+            uniforms_[base] = location;
+            for(GLint element = 1; element < size; element++){
+                std::string elementName = base + '[' + std::to_string(element) + ']';
+                GLint elementLocation = glGetUniformLocation(id_, elementName.c_str());
+                if(elementLocation >= 0)
+                    uniforms_[elementName] = elementLocation;
+            }
+        }
+    }
 }
 
 ShaderProgram::~ShaderProgram(){
-    if(id_ != 0)
+    if(id_ != 0){
         glDeleteProgram(id_);
+        GLState::Instance().DeletedProgram(id_);
+    }
+}
+
+UniformHandle ShaderProgram::get_uniform(std::string_view name) const noexcept{
+    wait();
+    auto it = uniforms_.find(name);
+    return it == uniforms_.end() ? UniformHandle{} : UniformHandle{it->second};
+}
+
+std::size_t ShaderProgram::uniform_count() const noexcept{
+    wait();
+    return uniforms_.size();
+}
+
+void ShaderProgram::set_uniform(UniformHandle uniform, bool value) const noexcept{
+    if(placeholder_bound_)
+        return defer(uniform, [this, uniform, value]{ set_uniform(uniform, value); });
+    renderStats.uniformSets++;
+    glUniform1i(uniform.get_location(), static_cast<int>(value));
+}
+void ShaderProgram::set_uniform(UniformHandle uniform, int value) const noexcept{
+    if(placeholder_bound_)
+        return defer(uniform, [this, uniform, value]{ set_uniform(uniform, value); });
+    renderStats.uniformSets++;
+    glUniform1i(uniform.get_location(), value);
+}
+void ShaderProgram::set_uniform(UniformHandle uniform, float value) const noexcept{
+    if(placeholder_bound_)
+        return defer(uniform, [this, uniform, value]{ set_uniform(uniform, value); });
+    renderStats.uniformSets++;
+    glUniform1f(uniform.get_location(), value);
+}
+void ShaderProgram::set_uniform(UniformHandle uniform, float v0, float v1, float v2, float v3) const noexcept{
+    if(placeholder_bound_)
+        return defer(uniform, [this, uniform, v0, v1, v2, v3]{ set_uniform(uniform, v0, v1, v2, v3); });
+    renderStats.uniformSets++;
+    glUniform4f(uniform.get_location(), v0, v1, v2, v3);
+}
+void ShaderProgram::set_uniform(UniformHandle uniform, float v0, float v1, float v2) const noexcept{
+    if(placeholder_bound_)
+        return defer(uniform, [this, uniform, v0, v1, v2]{ set_uniform(uniform, v0, v1, v2); });
+    renderStats.uniformSets++;
+    glUniform3f(uniform.get_location(), v0, v1, v2);
+}
+void ShaderProgram::set_uniform(UniformHandle uniform, GLsizei count, GLboolean transpose, GLfloat* value) const noexcept{
+    if(placeholder_bound_){
+        std::vector<GLfloat> matrices(value, value + 16 * count);
+        return defer(uniform, [this, uniform, count, transpose, matrices]() mutable { set_uniform(uniform, count, transpose, matrices.data()); });
+    }
+    renderStats.uniformSets++;
+    glUniformMatrix4fv(uniform.get_location(), count, transpose, value);//第一个参数是uniform的位置值。第二个参数告诉OpenGL要发送多少个矩阵。第三个参数是否希望对矩阵进行转置。OpenGL通常使用列主序布局。GLM的默认布局就是列主序，所以并不需要转置矩阵。最后一个参数是真正的矩阵数据，但是GLM并不是把它们的矩阵储存为OpenGL所希望接受的那种，因此我们要先用GLM的自带的函数value_ptr来变换这些数据。
 }
 
 void ShaderProgram::set_uniform(std::string_view name, bool value) const noexcept{
-    glUniform1i(glGetUniformLocation(id_, name.data()), static_cast<int>(value));
+    renderStats.uniformLookups++;
+    if(!is_ready())
+        return defer(name, [this, name = std::string(name), value]{ set_uniform(get_uniform(name), value); });
+    set_uniform(get_uniform(name), value);
 }
 void ShaderProgram::set_uniform(std::string_view name, int value) const noexcept{
-    glUniform1i(glGetUniformLocation(id_, name.data()), value);
+    renderStats.uniformLookups++;
+    if(!is_ready())
+        return defer(name, [this, name = std::string(name), value]{ set_uniform(get_uniform(name), value); });
+    set_uniform(get_uniform(name), value);
 }
 void ShaderProgram::set_uniform(std::string_view name, float value) const noexcept{
-    glUniform1f(glGetUniformLocation(id_, name.data()), value);
+    renderStats.uniformLookups++;
+    if(!is_ready())
+        return defer(name, [this, name = std::string(name), value]{ set_uniform(get_uniform(name), value); });
+    set_uniform(get_uniform(name), value);
 }
-
 void ShaderProgram::set_uniform(std::string_view name, float v0, float v1, float v2, float v3) const noexcept{
-    glUniform4f(glGetUniformLocation(id_, name.data()), v0, v1, v2, v3);
+    renderStats.uniformLookups++;
+    if(!is_ready())
+        return defer(name, [this, name = std::string(name), v0, v1, v2, v3]{ set_uniform(get_uniform(name), v0, v1, v2, v3); });
+    set_uniform(get_uniform(name), v0, v1, v2, v3);
 }
 void ShaderProgram::set_uniform(std::string_view name, float v0, float v1, float v2) const noexcept{
-    glUniform3f(glGetUniformLocation(id_, name.data()), v0, v1, v2);
+    renderStats.uniformLookups++;
+    if(!is_ready())
+        return defer(name, [this, name = std::string(name), v0, v1, v2]{ set_uniform(get_uniform(name), v0, v1, v2); });
+    set_uniform(get_uniform(name), v0, v1, v2);
 }
 void ShaderProgram::set_uniform(std::string_view name, GLsizei count, GLboolean transpose, GLfloat* value) const noexcept{
-    glUniformMatrix4fv(glGetUniformLocation(id_, name.data()), count, transpose, value);//第一个参数是uniform的位置值。第二个参数告诉OpenGL要发送多少个矩阵。第三个参数是否希望对矩阵进行转置。OpenGL通常使用列主序布局。GLM的默认布局就是列主序，所以并不需要转置矩阵。最后一个参数是真正的矩阵数据，但是GLM并不是把它们的矩阵储存为OpenGL所希望接受的那种，因此我们要先用GLM的自带的函数value_ptr来变换这些数据。
+    renderStats.uniformLookups++;
+    if(!is_ready()){
+        std::vector<GLfloat> matrices(value, value + 16 * count);
+        return defer(name, [this, name = std::string(name), count, transpose, matrices]() mutable {
+            set_uniform(get_uniform(name), count, transpose, matrices.data());
+        });
+    }
+    set_uniform(get_uniform(name), count, transpose, value);
 }
 void ShaderProgram::use() const noexcept{
-    glUseProgram(id_);
+    placeholder_bound_ = !is_ready();
+    GLState::Instance().UseProgram(placeholder_bound_ ? placeholder_program() : id_);
+    // 链接好之后第一次绑定: 补设之前记下的uniform
+    if(!placeholder_bound_ && !deferred_.empty()){
+        auto deferred = std::move(deferred_);
+        deferred_.clear();
+        // 名字和句柄可能指向同一个位置: 先把名字解析成位置, 每个位置只保留最后一次调用, 再按调用顺序补设
+        for(auto &entry : deferred)
+            if(!entry.name.empty())
+                entry.location = get_uniform(entry.name).get_location();
+        std::unordered_set<GLint> seen;
+        std::vector<bool> latest(deferred.size(), false);
+        for(std::size_t i = deferred.size(); i-- > 0;)
+            latest[i] = deferred[i].location >= 0 && seen.insert(deferred[i].location).second;
+        for(std::size_t i = 0; i < deferred.size(); i++)
+            if(latest[i])
+                deferred[i].set();
+    }
+}
+
+void ShaderProgram::defer(UniformHandle uniform, std::function<void()> set) const{
+    // 无效句柄本来就会被忽略
+    if(!uniform.valid())
+        return;
+    std::erase_if(deferred_, [&](DeferredUniform const &entry){ return entry.name.empty() && entry.location == uniform.get_location(); });
+    deferred_.push_back(DeferredUniform{{}, uniform.get_location(), std::move(set)});
+}
+
+void ShaderProgram::defer(std::string_view name, std::function<void()> set) const{
+    std::erase_if(deferred_, [&](DeferredUniform const &entry){ return entry.name == name; });
+    deferred_.push_back(DeferredUniform{std::string(name), -1, std::move(set)});
+}
+//---------------------------------------------------------------------------------------
+// 4. 着色器排列
+//---------------------------------------------------------------------------------------
+ShaderPermutations::ShaderPermutations(std::string vertex_shader, std::string fragment_shader, ShaderProgram::BuildMode mode)
+:vertex_shader_{std::move(vertex_shader)}, fragment_shader_{std::move(fragment_shader)}, mode_{mode}{
+}
+
+ShaderProgram &ShaderPermutations::get(ShaderDefines const &defines){
+    std::string key = Shader::defines_key(defines);
+    auto it = programs_.find(key);
+    if(it == programs_.end())
+        it = programs_.emplace(std::move(key), std::make_unique<ShaderProgram>(vertex_shader_, fragment_shader_, defines, mode_)).first;
+    return *it->second;
 }
@@ -0,0 +1,196 @@
+// 片段着色器按灯光排列特化的基准: materials.fs 在不同宏组合下每个像素的代价.
+// 在软件GL上测: LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe ./shaderbench
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <LightBuffer.h>
+#include <Shader.h>
+#include <Stopwatch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+    const int SIZE = 1024;  // 离屏目标的宽高
+    const int DRAWS = 8;    // 每次计时画满屏的次数
+    const int REPEATS = 5;
+
+    GLuint makeTexture(int size, unsigned char seed)
+    {
+        std::vector<unsigned char> pixels(static_cast<std::size_t>(size) * size * 4);
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++)
+            {
+                unsigned char *p = pixels.data() + (static_cast<std::size_t>(y) * size + x) * 4;
+                p[0] = static_cast<unsigned char>((x ^ y ^ seed) & 0xFF);
+                p[1] = static_cast<unsigned char>(127.5f + 127.5f * std::sin(x * 0.37f) * std::cos(y * 0.21f));
+                p[2] = static_cast<unsigned char>((x * 7 + y * 13 + seed) & 0xFF);
+                p[3] = 255;
+            }
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    // 与 Lighting 相同的灯光, 点光源放在屏幕前方, 让每个像素都受到所有灯光的影响
+    void setupLights(LightBuffer &lights)
+    {
+        DirLight dirLight;
+        dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+        dirLight.ambient = glm::vec3(0.05f);
+        dirLight.diffuse = glm::vec3(0.4f);
+        dirLight.specular = glm::vec3(0.5f);
+        lights.SetDirLight(dirLight);
+        for (int i = 0; i < LightBuffer::MAX_POINT_LIGHTS; i++)
+        {
+            PointLight light;
+            light.position = glm::vec3(-0.6f + 0.4f * i, 0.3f * (i % 2), 1.0f);
+            light.ambient = glm::vec3(0.05f);
+            light.diffuse = glm::vec3(0.8f);
+            light.specular = glm::vec3(1.0f);
+            light.linear = 0.09f;
+            light.quadratic = 0.032f;
+            lights.SetPointLight(i, light);
+        }
+        SpotLight spotLight;
+        spotLight.position = glm::vec3(0.0f, 0.0f, 3.0f);
+        spotLight.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        spotLight.diffuse = glm::vec3(1.0f);
+        spotLight.specular = glm::vec3(1.0f);
+        spotLight.linear = 0.09f;
+        spotLight.quadratic = 0.032f;
+        spotLight.cutOff = glm::cos(glm::radians(12.5f));
+        spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+        lights.SetSpotLight(spotLight);
+        lights.Upload();
+    }
+
+    // 用 program 画 DRAWS 次满屏四边形, 返回 REPEATS 次中最快的一次的每像素纳秒数
+    double measure(ShaderProgram &program, GLuint quadVAO)
+    {
+        glm::mat4 identity(1.0f);
+        program.use();
+        program.set_uniform("material.diffuse", 0);
+        program.set_uniform("material.specular", 1);
+        program.set_uniform("material.shininess", 32.0f);
+        program.set_uniform("viewPos", 0.0f, 0.0f, 3.0f);
+        program.set_uniform("model", 1, GL_FALSE, glm::value_ptr(identity));
+        program.set_uniform("view", 1, GL_FALSE, glm::value_ptr(identity));
+        program.set_uniform("projection", 1, GL_FALSE, glm::value_ptr(identity));
+        LightBuffer::Attach(program);
+        glBindVertexArray(quadVAO);
+        // 第一次绘制包含驱动生成着色器变体的时间, 不计入
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glFinish();
+
+        double best = Stopwatch::BestOfMs(REPEATS, []() {
+            for (int i = 0; i < DRAWS; i++)
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            glFinish();
+        });
+        return best * 1e6 / (static_cast<double>(SIZE) * SIZE * DRAWS);
+    }
+}
+
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow *window = glfwCreateWindow(64, 64, "shaderbench", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << ", " << SIZE << "x" << SIZE << " x " << DRAWS << " full-screen draws"
+              << std::endl;
+
+    // 离屏绘制, 不受窗口大小和交换链的影响
+    GLuint framebuffer, colorBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SIZE, SIZE);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glViewport(0, 0, SIZE, SIZE);
+
+    // 位置, 法线, 纹理坐标; 法线朝向观察者
+    float quad[] = {
+        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+         1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 4.0f, 0.0f,
+         1.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 4.0f, 4.0f,
+         1.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 4.0f, 4.0f,
+        -1.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 4.0f,
+        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    };
+    GLuint quadVAO, quadVBO;
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    GLuint textures[2] = {makeTexture(512, 0), makeTexture(512, 91)};
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[0]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, textures[1]);
+
+    {
+        LightBuffer lights;
+        setupLights(lights);
+        ShaderPermutations permutations("..\\..\\shaders\\materials.vs", "..\\..\\shaders\\materials.fs");
+
+        // 未特化的版本: 四个点光源 + 平行光 + 聚光
+        double full = measure(permutations.get({}), quadVAO);
+        std::cout << "unspecialized (dir + 4 point + spot): " << full << " ns/pixel" << std::endl;
+        for (int spot = 1; spot >= 0; spot--)
+            for (int pointLights = LightBuffer::MAX_POINT_LIGHTS; pointLights >= 0; pointLights--)
+            {
+                ShaderDefines defines{{"NR_POINT_LIGHTS", std::to_string(pointLights)}, {"SPOT_LIGHT", std::to_string(spot)}};
+                double cost = measure(permutations.get(defines), quadVAO);
+                std::cout << "    dir + " << pointLights << " point" << (spot ? " + spot" : "") << ": " << cost << " ns/pixel ("
+                          << 100.0 * cost / full << "%)" << std::endl;
+            }
+        ShaderProgram::Stats stats = ShaderProgram::get_stats();
+        std::cout << permutations.size() << " permutations: " << stats.compiled << " compiled (" << stats.compileMs << " ms), "
+                  << stats.cacheHits << " from program cache (" << stats.cacheMs << " ms)" << std::endl;
+    }
+
+    glDeleteTextures(2, textures);
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glfwTerminate();
+    return 0;
+}
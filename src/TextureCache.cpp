@@ -0,0 +1,140 @@
+#include "TextureCache.h"
+#include "CacheFile.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    constexpr char MAGIC[4] = {'L', 'G', 'T', 'C'};
+
+    struct CacheHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t format; // TextureCompressor::Format
+        std::uint32_t glFormat;
+        std::int64_t sourceMTime;
+        std::uint64_t sourceSize;
+        std::uint32_t levelCount;
+        std::uint32_t srgb; // mip链在sRGB空间中滤波, 与文件名中的 .srgb 一致
+    };
+
+    struct LevelRecord
+    {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint64_t offset; // byte offset from the start of the file
+        std::uint64_t size;
+    };
+}
+
+std::string TextureCache::CachePath(std::string const &sourcePath, bool srgb)
+{
+    return sourcePath + (srgb ? ".srgb.texcache" : ".texcache");
+}
+
+namespace
+{
+    // 校验缓存文件头, 键不匹配或文件损坏时返回false
+    bool readHeader(std::string const &sourcePath, bool srgb, MappedFile const &file, CacheHeader &header)
+    {
+        std::int64_t mtime;
+        std::uint64_t sourceSize;
+        if (!CacheFile::SourceKey(sourcePath, mtime, sourceSize))
+            return false;
+
+        if (!CacheFile::CheckMagic(file.Data(), file.Size(), MAGIC, TextureCache::VERSION) || file.Size() < sizeof(CacheHeader))
+            return false;
+
+        std::memcpy(&header, file.Data(), sizeof(header));
+        if (header.format > static_cast<std::uint32_t>(TextureCompressor::Format::BC5) ||
+            header.sourceMTime != mtime || header.sourceSize != sourceSize || header.srgb != static_cast<std::uint32_t>(srgb))
+            return false;
+        if (header.glFormat != TextureCompressor::GLFormat(static_cast<TextureCompressor::Format>(header.format)))
+            return false;
+        return header.levelCount <= (file.Size() - sizeof(header)) / sizeof(LevelRecord);
+    }
+
+    bool readRecord(MappedFile const &file, CacheHeader const &header, std::uint32_t index, LevelRecord &record)
+    {
+        std::memcpy(&record, file.Data() + sizeof(header) + index * sizeof(LevelRecord), sizeof(record));
+        std::size_t blockBytes = TextureCompressor::BlockBytes(static_cast<TextureCompressor::Format>(header.format));
+        std::size_t expected = static_cast<std::size_t>((record.width + 3) / 4) * ((record.height + 3) / 4) * blockBytes;
+        return record.size == expected && record.offset <= file.Size() && record.size <= file.Size() - record.offset;
+    }
+}
+
+bool TextureCache::Load(std::string const &sourcePath, bool srgb, TextureCompressor::Format &format, CompressedTexture &texture,
+                        int maxSize)
+{
+    MappedFile file(CachePath(sourcePath, srgb));
+    CacheHeader header;
+    if (!readHeader(sourcePath, srgb, file, header))
+        return false;
+
+    CompressedTexture cached;
+    cached.format = header.glFormat;
+    cached.levels.resize(header.levelCount);
+    for (std::uint32_t i = 0; i < header.levelCount; i++)
+    {
+        LevelRecord record;
+        if (!readRecord(file, header, i, record))
+            return false;
+        CompressedLevel &level = cached.levels[i];
+        level.width = static_cast<int>(record.width);
+        level.height = static_cast<int>(record.height);
+        if (maxSize <= 0 || std::max(level.width, level.height) <= maxSize)
+            level.data.assign(file.Data() + record.offset, file.Data() + record.offset + record.size);
+    }
+    format = static_cast<TextureCompressor::Format>(header.format);
+    texture = std::move(cached);
+    return true;
+}
+
+bool TextureCache::LoadLevel(std::string const &sourcePath, bool srgb, unsigned int index, CompressedLevel &level)
+{
+    MappedFile file(CachePath(sourcePath, srgb));
+    CacheHeader header;
+    LevelRecord record;
+    if (!readHeader(sourcePath, srgb, file, header) || index >= header.levelCount || !readRecord(file, header, index, record))
+        return false;
+    level.width = static_cast<int>(record.width);
+    level.height = static_cast<int>(record.height);
+    level.data.assign(file.Data() + record.offset, file.Data() + record.offset + record.size);
+    return true;
+}
+
+bool TextureCache::Save(std::string const &sourcePath, bool srgb, TextureCompressor::Format format, CompressedTexture const &texture)
+{
+    std::int64_t mtime;
+    std::uint64_t sourceSize;
+    if (!CacheFile::SourceKey(sourcePath, mtime, sourceSize))
+        return false;
+
+    return CacheFile::Write(CachePath(sourcePath, srgb), "TEXTURECACHE", [&](std::ofstream &out) {
+        CacheHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.format = static_cast<std::uint32_t>(format);
+        header.glFormat = texture.format;
+        header.sourceMTime = mtime;
+        header.sourceSize = sourceSize;
+        header.levelCount = static_cast<std::uint32_t>(texture.levels.size());
+        header.srgb = srgb;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        std::uint64_t offset = sizeof(header) + texture.levels.size() * sizeof(LevelRecord);
+        for (auto const &level : texture.levels)
+        {
+            LevelRecord record{static_cast<std::uint32_t>(level.width), static_cast<std::uint32_t>(level.height), offset, level.data.size()};
+            out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+            offset += level.data.size();
+        }
+        for (auto const &level : texture.levels)
+            out.write(reinterpret_cast<const char *>(level.data.data()), static_cast<std::streamsize>(level.data.size()));
+    });
+}
@@ -0,0 +1,300 @@
+#include "TextureCompressor.h"
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+std::size_t CompressedTexture::Bytes() const noexcept
+{
+    std::size_t bytes = 0;
+    for (auto const &level : levels)
+        bytes += level.data.size();
+    return bytes;
+}
+
+namespace
+{
+    std::uint16_t pack565(float r, float g, float b)
+    {
+        auto quantize = [](float v, int bits) {
+            int max = (1 << bits) - 1;
+            return static_cast<std::uint16_t>(std::clamp(static_cast<int>(v / 255.0f * max + 0.5f), 0, max));
+        };
+        return static_cast<std::uint16_t>(quantize(r, 5) << 11 | quantize(g, 6) << 5 | quantize(b, 5));
+    }
+
+    void unpack565(std::uint16_t c, float rgb[3])
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = static_cast<float>((r << 3) | (r >> 2));
+        rgb[1] = static_cast<float>((g << 2) | (g >> 4));
+        rgb[2] = static_cast<float>((b << 3) | (b >> 2));
+    }
+
+    // 4色模式的调色板, 返回每个像素的索引和总误差
+    float fitIndices(const unsigned char *texels, std::uint16_t c0, std::uint16_t c1, std::uint32_t &indices)
+    {
+        float palette[4][3];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int k = 0; k < 3; k++)
+        {
+            palette[2][k] = (2.0f * palette[0][k] + palette[1][k]) / 3.0f;
+            palette[3][k] = (palette[0][k] + 2.0f * palette[1][k]) / 3.0f;
+        }
+        indices = 0;
+        float total = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float best = 1e30f;
+            std::uint32_t bestIndex = 0;
+            for (std::uint32_t p = 0; p < 4; p++)
+            {
+                float dr = texels[i * 4] - palette[p][0], dg = texels[i * 4 + 1] - palette[p][1], db = texels[i * 4 + 2] - palette[p][2];
+                float d = dr * dr + dg * dg + db * db;
+                if (d < best)
+                {
+                    best = d;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (i * 2);
+            total += best;
+        }
+        return total;
+    }
+
+    // c0 > c1 保证解码为4色模式; 交换端点时对应调整索引 (0<->1, 2<->3)
+    void writeBC1(std::uint16_t c0, std::uint16_t c1, std::uint32_t indices, unsigned char *block)
+    {
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+            indices ^= 0x55555555u;
+        }
+        else if (c0 == c1)
+            indices = 0; // 两端点相同时是3色模式, 索引3会变成透明黑
+        std::memcpy(block, &c0, 2);
+        std::memcpy(block + 2, &c1, 2);
+        std::memcpy(block + 4, &indices, 4);
+    }
+}
+
+std::size_t TextureCompressor::BlockBytes(Format format) noexcept
+{
+    return format == Format::BC1 ? 8 : 16;
+}
+
+GLenum TextureCompressor::GLFormat(Format format) noexcept
+{
+    switch (format)
+    {
+    case Format::BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case Format::BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+void TextureCompressor::EncodeBC1(const unsigned char *texels, unsigned char *block)
+{
+    // 主成分方向作为端点连线 (幂迭代求协方差矩阵的主特征向量)
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            mean[k] += texels[i * 4 + k];
+    for (float &m : mean)
+        m /= 16.0f;
+    float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f}; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++)
+    {
+        float r = texels[i * 4] - mean[0], g = texels[i * 4 + 1] - mean[1], b = texels[i * 4 + 2] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max({std::abs(x), std::abs(y), std::abs(z)});
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    float tMin = 1e30f, tMax = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (texels[i * 4] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] + (texels[i * 4 + 2] - mean[2]) * axis[2];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    // 端点向内收缩1/16, 减小量化误差
+    float inset = (tMax - tMin) / 16.0f;
+    tMin += inset;
+    tMax -= inset;
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float lo[3], hi[3];
+    for (int k = 0; k < 3; k++)
+    {
+        lo[k] = std::clamp(mean[k] + axis[k] * tMin / axisLength2, 0.0f, 255.0f);
+        hi[k] = std::clamp(mean[k] + axis[k] * tMax / axisLength2, 0.0f, 255.0f);
+    }
+    std::uint16_t c0 = pack565(hi[0], hi[1], hi[2]);
+    std::uint16_t c1 = pack565(lo[0], lo[1], lo[2]);
+    std::uint32_t indices;
+    float error = fitIndices(texels, c0, c1, indices);
+
+    // 固定索引后最小二乘重新求一次端点, 误差更小才采用
+    if (c0 != c1)
+    {
+        static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[3] = {0.0f, 0.0f, 0.0f}, bx[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            float w = weights[(indices >> (i * 2)) & 3];
+            aa += w * w;
+            bb += (1.0f - w) * (1.0f - w);
+            ab += w * (1.0f - w);
+            for (int k = 0; k < 3; k++)
+            {
+                ax[k] += w * texels[i * 4 + k];
+                bx[k] += (1.0f - w) * texels[i * 4 + k];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) > 1e-6f)
+        {
+            float a[3], b[3];
+            for (int k = 0; k < 3; k++)
+            {
+                a[k] = std::clamp((ax[k] * bb - bx[k] * ab) / det, 0.0f, 255.0f);
+                b[k] = std::clamp((bx[k] * aa - ax[k] * ab) / det, 0.0f, 255.0f);
+            }
+            std::uint16_t r0 = pack565(a[0], a[1], a[2]), r1 = pack565(b[0], b[1], b[2]);
+            std::uint32_t refined;
+            float refinedError = fitIndices(texels, r0, r1, refined);
+            if (refinedError < error)
+            {
+                c0 = r0;
+                c1 = r1;
+                indices = refined;
+            }
+        }
+    }
+    writeBC1(c0, c1, indices, block);
+}
+
+void TextureCompressor::EncodeBC4(const unsigned char *values, int stride, unsigned char *block)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, static_cast<int>(values[i * stride]));
+        hi = std::max(hi, static_cast<int>(values[i * stride]));
+    }
+    // e0 > e1: 8值模式, 代码 0=e0, 1=e1, 2..7 在两端之间线性插值
+    block[0] = static_cast<unsigned char>(hi);
+    block[1] = static_cast<unsigned char>(lo);
+    std::uint64_t bits = 0;
+    if (hi > lo)
+    {
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * hi + i * lo) / 7;
+        for (int i = 0; i < 16; i++)
+        {
+            int value = values[i * stride];
+            int best = 0, bestDistance = 256;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs(value - palette[p]);
+                if (distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            bits |= static_cast<std::uint64_t>(best) << (i * 3);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = static_cast<unsigned char>(bits >> (i * 8));
+}
+
+void TextureCompressor::EncodeBC3(const unsigned char *texels, unsigned char *block)
+{
+    EncodeBC4(texels + 3, 4, block);
+    EncodeBC1(texels, block + 8);
+}
+
+void TextureCompressor::EncodeBC5(const unsigned char *texels, unsigned char *block)
+{
+    EncodeBC4(texels, 4, block);
+    EncodeBC4(texels + 1, 4, block + 8);
+}
+
+std::vector<unsigned char> TextureCompressor::Compress(const unsigned char *rgba, int width, int height, Format format)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    std::size_t blockBytes = BlockBytes(format);
+    std::vector<unsigned char> out(static_cast<std::size_t>(blocksX) * blocksY * blockBytes);
+    unsigned char texels[16 * 4];
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            for (int y = 0; y < 4; y++)
+            {
+                int sy = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    std::memcpy(texels + (y * 4 + x) * 4, rgba + (static_cast<std::size_t>(sy) * width + sx) * 4, 4);
+                }
+            }
+            unsigned char *block = out.data() + (static_cast<std::size_t>(by) * blocksX + bx) * blockBytes;
+            switch (format)
+            {
+            case Format::BC1:
+                EncodeBC1(texels, block);
+                break;
+            case Format::BC3:
+                EncodeBC3(texels, block);
+                break;
+            case Format::BC5:
+                EncodeBC5(texels, block);
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+CompressedTexture TextureCompressor::CompressMipChain(const unsigned char *rgba, int width, int height, Format format, bool srgb)
+{
+    CompressedTexture texture;
+    texture.format = GLFormat(format);
+    texture.levels.push_back(CompressedLevel{width, height, Compress(rgba, width, height, format)});
+    MipOptions options;
+    options.srgb = srgb && format != Format::BC5;
+    options.normalMap = format == Format::BC5;
+    for (MipLevel const &level : MipGenerator::Generate(rgba, width, height, 4, options))
+        texture.levels.push_back(CompressedLevel{level.width, level.height, Compress(level.data.data(), level.width, level.height, format)});
+    return texture;
+}
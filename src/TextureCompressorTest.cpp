@@ -0,0 +1,213 @@
+// TextureCompressor 的测试: BC1/BC5 编码后按规范解码, 与原图的误差在限度内. 只用CPU, 不调用GL
+#include <MipGenerator.h>
+#include <TextureCompressor.h>
+#include <TestCheck.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    TestCheck check("TEXTURECOMPRESSOR_TEST");
+
+    void unpack565(std::uint16_t c, int rgb[3])
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // 按 S3TC 规范解码一个BC1块, 写出16个RGBA像素
+    void decodeBC1(unsigned char const *block, unsigned char *texels)
+    {
+        std::uint16_t c0, c1;
+        std::uint32_t indices;
+        std::memcpy(&c0, block, 2);
+        std::memcpy(&c1, block + 2, 2);
+        std::memcpy(&indices, block + 4, 4);
+        int palette[4][4];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int k = 0; k < 3; k++)
+        {
+            if (c0 > c1)
+            {
+                palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+                palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+            }
+            else
+            {
+                palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+                palette[3][k] = 0;
+            }
+        }
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+        palette[3][3] = c0 > c1 ? 255 : 0;
+        for (int i = 0; i < 16; i++)
+            for (int k = 0; k < 4; k++)
+                texels[i * 4 + k] = static_cast<unsigned char>(palette[(indices >> (i * 2)) & 3][k]);
+    }
+
+    // 按 RGTC 规范解码一个BC4块, 第i个值写到 values[i * stride]
+    void decodeBC4(unsigned char const *block, unsigned char *values, int stride)
+    {
+        int e0 = block[0], e1 = block[1];
+        int palette[8] = {e0, e1};
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = e0 > e1 ? ((7 - i) * e0 + i * e1) / 7 : 0;
+        if (e0 <= e1)
+        {
+            for (int i = 1; i < 5; i++)
+                palette[i + 1] = ((5 - i) * e0 + i * e1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        std::uint64_t bits = 0;
+        for (int i = 0; i < 6; i++)
+            bits |= static_cast<std::uint64_t>(block[2 + i]) << (i * 8);
+        for (int i = 0; i < 16; i++)
+            values[i * stride] = static_cast<unsigned char>(palette[(bits >> (i * 3)) & 7]);
+    }
+
+    // 解码整幅图像 (宽高为4的倍数) 为RGBA; BC5 的 b 为0, a 为255
+    std::vector<unsigned char> decode(std::vector<unsigned char> const &data, int width, int height, TextureCompressor::Format format)
+    {
+        std::vector<unsigned char> rgba(static_cast<std::size_t>(width) * height * 4, 0);
+        std::size_t blockBytes = TextureCompressor::BlockBytes(format);
+        unsigned char texels[16 * 4];
+        for (int by = 0; by < height / 4; by++)
+            for (int bx = 0; bx < width / 4; bx++)
+            {
+                unsigned char const *block = data.data() + (static_cast<std::size_t>(by) * (width / 4) + bx) * blockBytes;
+                std::fill(texels, texels + 64, static_cast<unsigned char>(0));
+                if (format == TextureCompressor::Format::BC1)
+                    decodeBC1(block, texels);
+                else
+                {
+                    decodeBC4(block, texels, 4);
+                    decodeBC4(block + 8, texels + 1, 4);
+                    for (int i = 0; i < 16; i++)
+                        texels[i * 4 + 3] = 255;
+                }
+                for (int y = 0; y < 4; y++)
+                    std::memcpy(&rgba[((static_cast<std::size_t>(by) * 4 + y) * width + bx * 4) * 4], texels + y * 16, 16);
+            }
+        return rgba;
+    }
+
+    // channels 个通道上的 PSNR (dB) 和最大误差
+    double psnr(std::vector<unsigned char> const &a, std::vector<unsigned char> const &b, int channels, int &maxError)
+    {
+        double sum = 0.0;
+        std::size_t count = 0;
+        maxError = 0;
+        for (std::size_t i = 0; i < a.size(); i += 4)
+            for (int k = 0; k < channels; k++)
+            {
+                int d = a[i + k] - b[i + k];
+                sum += d * d;
+                maxError = std::max(maxError, std::abs(d));
+                count++;
+            }
+        return sum == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 * count / sum);
+    }
+}
+
+int main()
+{
+    using TextureCompressor::Format;
+    const int SIZE = 64;
+    std::mt19937 random(5);
+    std::uniform_int_distribution<int> noise(-3, 3);
+
+    // 平滑的彩色渐变加少量噪声, 接近照片类的颜色贴图
+    std::vector<unsigned char> color(SIZE * SIZE * 4);
+    for (int y = 0; y < SIZE; y++)
+        for (int x = 0; x < SIZE; x++)
+        {
+            unsigned char *p = &color[(y * SIZE + x) * 4];
+            p[0] = static_cast<unsigned char>(std::clamp(x * 4 + noise(random), 0, 255));
+            p[1] = static_cast<unsigned char>(std::clamp(y * 3 + 40 + noise(random), 0, 255));
+            p[2] = static_cast<unsigned char>(std::clamp(128 + static_cast<int>(60.0 * std::sin(x * 0.2) * std::cos(y * 0.15)), 0, 255));
+            p[3] = 255;
+        }
+    std::vector<unsigned char> bc1 = TextureCompressor::Compress(color.data(), SIZE, SIZE, Format::BC1);
+    check(bc1.size() == SIZE / 4 * SIZE / 4 * 8, "BC1 output has the wrong size");
+    int maxError = 0;
+    double colorPsnr = psnr(color, decode(bc1, SIZE, SIZE, Format::BC1), 3, maxError);
+    check(colorPsnr > 35.0, "BC1 PSNR of a smooth gradient is below 35 dB");
+    check(maxError <= 16, "BC1 error of a smooth gradient exceeds 16");
+
+    // 纯色块只有 565 的量化误差
+    std::vector<unsigned char> solid(16 * 4);
+    for (int i = 0; i < 16; i++)
+    {
+        solid[i * 4] = 200;
+        solid[i * 4 + 1] = 37;
+        solid[i * 4 + 2] = 99;
+        solid[i * 4 + 3] = 255;
+    }
+    unsigned char block[16];
+    unsigned char texels[16 * 4];
+    TextureCompressor::EncodeBC1(solid.data(), block);
+    decodeBC1(block, texels);
+    bool solidOk = true;
+    for (int i = 0; i < 16; i++)
+        solidOk = solidOk && std::abs(texels[i * 4] - 200) <= 4 && std::abs(texels[i * 4 + 1] - 37) <= 2 &&
+                  std::abs(texels[i * 4 + 2] - 99) <= 4 && texels[i * 4 + 3] == 255;
+    check(solidOk, "BC1 solid block is off by more than the 565 quantization step");
+
+    // 法线贴图: 平滑高度场的法线, xy 编码到 [0, 255]
+    std::vector<unsigned char> normals(SIZE * SIZE * 4);
+    for (int y = 0; y < SIZE; y++)
+        for (int x = 0; x < SIZE; x++)
+        {
+            float dx = 0.6f * std::cos(x * 0.15f) * std::sin(y * 0.1f), dy = 0.6f * std::sin(x * 0.15f) * std::cos(y * 0.1f);
+            float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+            unsigned char *p = &normals[(y * SIZE + x) * 4];
+            p[0] = static_cast<unsigned char>((-dx / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+            p[1] = static_cast<unsigned char>((-dy / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+            p[2] = static_cast<unsigned char>((1.0f / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+            p[3] = 255;
+        }
+    std::vector<unsigned char> bc5 = TextureCompressor::Compress(normals.data(), SIZE, SIZE, Format::BC5);
+    check(bc5.size() == SIZE / 4 * SIZE / 4 * 16, "BC5 output has the wrong size");
+    double normalPsnr = psnr(normals, decode(bc5, SIZE, SIZE, Format::BC5), 2, maxError);
+    check(normalPsnr > 45.0, "BC5 PSNR of a smooth normal map is below 45 dB");
+    check(maxError <= 4, "BC5 error of a smooth normal map exceeds 4");
+
+    // 一个块里只有两种值时 BC4 是无损的
+    unsigned char twoValues[16];
+    for (int i = 0; i < 16; i++)
+        twoValues[i] = i % 3 ? 17 : 230;
+    unsigned char decoded[16];
+    TextureCompressor::EncodeBC4(twoValues, 1, block);
+    decodeBC4(block, decoded, 1);
+    check(std::equal(twoValues, twoValues + 16, decoded), "BC4 block with two values is not lossless");
+
+    // 宽高不是4的倍数时按块数向上取整
+    check(TextureCompressor::Compress(color.data(), 6, 5, Format::BC1).size() == 2 * 2 * 8, "BC1 of a 6x5 image is not 2x2 blocks");
+
+    // mip链: 到1x1的每一级, 大小逐级减半
+    CompressedTexture chain = TextureCompressor::CompressMipChain(color.data(), SIZE, SIZE, Format::BC1, true);
+    check(chain.format == TextureCompressor::GLFormat(Format::BC1), "mip chain has the wrong GL format");
+    check(static_cast<int>(chain.levels.size()) == MipGenerator::LevelCount(SIZE, SIZE), "mip chain does not reach 1x1");
+    bool levelsOk = !chain.levels.empty();
+    for (std::size_t level = 0; level < chain.levels.size(); level++)
+    {
+        CompressedLevel const &l = chain.levels[level];
+        int expected = std::max(1, SIZE >> level);
+        levelsOk = levelsOk && l.width == expected && l.height == expected &&
+                   l.data.size() == static_cast<std::size_t>((expected + 3) / 4) * ((expected + 3) / 4) * 8;
+    }
+    check(levelsOk, "mip chain levels have the wrong size");
+    check(chain.levels.empty() || chain.levels[0].data == bc1, "mip level 0 differs from Compress");
+
+    return check.Finish("TextureCompressor", " (BC1 ", colorPsnr, " dB, BC5 ", normalPsnr, " dB)");
+}
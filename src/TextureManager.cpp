@@ -0,0 +1,702 @@
+#include "TextureManager.h"
+#include "TextureCache.h"
+#include "GLState.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+
+DecodedImage::~DecodedImage()
+{
+    if (data)
+        stbi_image_free(data);
+}
+
+TextureManager &TextureManager::Instance()
+{
+    static TextureManager manager;
+    return manager;
+}
+
+std::string TextureManager::ResolvePath(std::string const &path)
+{
+    std::error_code ec;
+    auto abs = std::filesystem::absolute(path, ec);
+    if (ec)
+        return path;
+    return abs.lexically_normal().string();
+}
+
+namespace
+{
+    bool s3tcSupported()
+    {
+#ifdef GL_EXT_texture_compression_s3tc
+        return GLAD_GL_EXT_texture_compression_s3tc != 0;
+#else
+        return true; // 桌面GL 3.3驱动都提供S3TC
+#endif
+    }
+
+    std::string decodingKey(std::string const &resolvedPath, TextureCompression compression, TextureUsage usage)
+    {
+        return resolvedPath + '#' + std::to_string(static_cast<int>(compression)) + '#' + std::to_string(static_cast<int>(usage));
+    }
+
+    // stb_image 解码出的通道数 (1-4) 对应的像素格式; 2通道 (灰度+透明度) 按 RG 上传
+    GLenum pixelFormat(int nrComponents)
+    {
+        switch (nrComponents)
+        {
+        case 1:
+            return GL_RED;
+        case 2:
+            return GL_RG;
+        case 3:
+            return GL_RGB;
+        default:
+            return GL_RGBA;
+        }
+    }
+}
+
+std::size_t TextureManager::KeyHash::operator()(Key const &key) const noexcept
+{
+    std::size_t h = std::hash<std::string>()(key.path);
+    for (GLint value : {key.sampler.wrapS, key.sampler.wrapT, key.sampler.minFilter, key.sampler.magFilter,
+                        static_cast<GLint>(key.compression), static_cast<GLint>(key.usage)})
+        h = (h ^ static_cast<std::size_t>(value)) * 1099511628211ull;
+    return h;
+}
+
+TextureHandle TextureManager::findLocked(Key const &key)
+{
+    auto it = textures.find(key);
+    if (it == textures.end())
+        return nullptr;
+    return it->second.lock();
+}
+
+TextureHandle TextureManager::Load(std::string const &path, SamplerParams const &sampler, TextureCompression compression,
+                                   TextureUsage usage)
+{
+    return Upload(path, nullptr, sampler, compression, usage);
+}
+
+std::shared_ptr<DecodedImage> TextureManager::Decode(std::string const &path, SamplerParams const &sampler,
+                                                     TextureCompression compression, TextureUsage usage)
+{
+    Key key{ResolvePath(path), sampler, compression, usage};
+    {
+        // 只看是否驻留, 不升级为句柄: 在锁内释放的临时句柄可能是最后一个引用, 删除器会在这个线程上调用GL并重新加锁
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = textures.find(key);
+        if (it != textures.end() && !it->second.expired())
+        {
+            stats.hits++;
+            return nullptr;
+        }
+    }
+    return decodeShared(key.path, compression, usage);
+}
+
+std::shared_ptr<DecodedImage> TextureManager::decodeShared(std::string const &resolvedPath, TextureCompression compression,
+                                                           TextureUsage usage)
+{
+    std::shared_ptr<DecodedImage> image;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<DecodedImage> &slot = decoding[decodingKey(resolvedPath, compression, usage)];
+        image = slot.lock();
+        if (image)
+            stats.hits++;
+        else
+        {
+            image = std::shared_ptr<DecodedImage>(new DecodedImage(), [this](DecodedImage *decoded) { releaseDecoded(decoded); });
+            image->path = resolvedPath;
+            image->compression = compression;
+            image->usage = usage;
+            slot = image;
+        }
+    }
+    // 只调用stb_image和编码器, 不涉及GL; 同一图像的其他调用者在这里等待第一个完成
+    std::call_once(image->decoded, [this, &image]() {
+        auto start = std::chrono::steady_clock::now();
+        if (image->compression != TextureCompression::None)
+            cook(*image);
+        else
+        {
+            image->data = stbi_load(image->path.c_str(), &image->width, &image->height, &image->nrComponents, 0);
+            // 每次加载都要做, 所以用最快的盒式滤波; 压缩纹理的mip链会缓存, 用 Kaiser
+            MipOptions options;
+            options.filter = MipFilter::Box;
+            options.srgb = image->usage == TextureUsage::Color;
+            options.normalMap = image->usage == TextureUsage::NormalMap;
+            if (image->data)
+                image->mips = MipGenerator::Generate(image->data, image->width, image->height, image->nrComponents, options);
+        }
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (image->compression == TextureCompression::None)
+            stats.decodes++;
+        stats.decodeMs += time.count();
+    });
+    return image;
+}
+
+void TextureManager::releaseDecoded(DecodedImage *image)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = decoding.find(decodingKey(image->path, image->compression, image->usage));
+        if (it != decoding.end() && it->second.expired())
+            decoding.erase(it);
+    }
+    delete image;
+}
+
+bool TextureManager::cook(DecodedImage &image)
+{
+    bool stream;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stream = streaming;
+    }
+    bool srgb = image.usage == TextureUsage::Color;
+    TextureCompressor::Format format;
+    CompressedTexture texture;
+    // 流式加载时只读取低分辨率的几级, 其余的按需从缓存文件读取
+    if (TextureCache::Load(image.path, srgb, format, texture, stream ? STREAM_TAIL_SIZE : 0))
+    {
+        bool compatible = image.compression == TextureCompression::NormalMap ? format == TextureCompressor::Format::BC5
+                                                                              : format != TextureCompressor::Format::BC5;
+        if (compatible && !texture.levels.empty())
+        {
+            image.width = texture.levels[0].width;
+            image.height = texture.levels[0].height;
+            image.compressed = std::move(texture);
+            image.streamable = stream;
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.cookedCacheHits++;
+            return true;
+        }
+    }
+
+    // 编码器总是吃RGBA
+    int width, height, nrComponents;
+    unsigned char *rgba = stbi_load(image.path.c_str(), &width, &height, &nrComponents, 4);
+    if (!rgba)
+        return false;
+    if (image.compression == TextureCompression::NormalMap)
+        format = TextureCompressor::Format::BC5;
+    else
+    {
+        std::size_t pixels = static_cast<std::size_t>(width) * height;
+        bool alpha = false;
+        for (std::size_t i = 0; i < pixels && !alpha; i++)
+            alpha = rgba[i * 4 + 3] != 255;
+        format = alpha ? TextureCompressor::Format::BC3 : TextureCompressor::Format::BC1;
+    }
+    image.compressed = TextureCompressor::CompressMipChain(rgba, width, height, format, srgb);
+    image.width = width;
+    image.height = height;
+    stbi_image_free(rgba);
+    if (!TextureCache::Save(image.path, srgb, format, image.compressed))
+        std::cout << "WARNING::TEXTURECACHE::could not write " << TextureCache::CachePath(image.path, srgb) << std::endl;
+    else if (stream)
+    {
+        // 已写入缓存, 高分辨率的级别之后再按需读回
+        for (CompressedLevel &level : image.compressed.levels)
+            if (std::max(level.width, level.height) > STREAM_TAIL_SIZE)
+                std::vector<unsigned char>().swap(level.data);
+        image.streamable = true;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.decodes++;
+    stats.cooked++;
+    return true;
+}
+
+TextureHandle TextureManager::Upload(std::string const &path, std::shared_ptr<DecodedImage> image, SamplerParams const &sampler,
+                                     TextureCompression compression, TextureUsage usage)
+{
+    Key key{ResolvePath(path), sampler, compression, usage};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (TextureHandle texture = findLocked(key))
+        {
+            stats.hits++;
+            return texture;
+        }
+    }
+    if (image && (image->compression != compression || image->usage != usage))
+        image = nullptr;
+    if (!image)
+        image = decodeShared(key.path, compression, usage);
+    // 没有S3TC的驱动上退回未压缩
+    if (image->compressed.format && image->compressed.format != GL_COMPRESSED_RG_RGTC2 && !s3tcSupported())
+    {
+        std::cout << "WARNING::TEXTURE::S3TC not supported, uploading " << image->path << " uncompressed" << std::endl;
+        image = decodeShared(key.path, TextureCompression::None, usage);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!uploadRing)
+        uploadRing = std::make_unique<PixelUploadRing>();
+    auto *texture = new TextureObject();
+    glGenTextures(1, &texture->id);
+    if (image->compressed.format)
+    {
+        // 上传CPU上已有的级别; 流式加载的纹理缺少高分辨率的几级, 用 BASE_LEVEL 跳过
+        bindForUpload(*texture);
+        std::vector<CompressedLevel> const &levels = image->compressed.levels;
+        std::size_t base = 0;
+        while (base + 1 < levels.size() && levels[base].data.empty())
+            base++;
+        for (std::size_t level = base; level < levels.size(); level++)
+            uploadRing->CompressedTexImage2D(static_cast<GLint>(level), image->compressed.format, levels[level].width,
+                                             levels[level].height, levels[level].data.data(), levels[level].data.size());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(base));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+        texture->width = image->width;
+        texture->height = image->height;
+        texture->bytes = image->compressed.Bytes();
+    }
+    else if (image->data)
+    {
+        GLenum format = pixelFormat(image->nrComponents);
+
+        bindForUpload(*texture);
+        // stb_image 的行是紧密排列的, RGB 图像的行宽不一定是4的倍数
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        std::size_t bytes = static_cast<std::size_t>(image->width) * image->height * image->nrComponents;
+        uploadRing->TexImage2D(0, format, image->width, image->height, format, GL_UNSIGNED_BYTE, image->data, bytes);
+        for (std::size_t level = 0; level < image->mips.size(); level++)
+        {
+            MipLevel const &mip = image->mips[level];
+            uploadRing->TexImage2D(static_cast<GLint>(level + 1), format, mip.width, mip.height, format, GL_UNSIGNED_BYTE,
+                                   mip.data.data(), mip.data.size());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image->mips.size()));
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+        texture->width = image->width;
+        texture->height = image->height;
+        // 驱动按RGBA8存储, 加上mip链约多1/3
+        texture->bytes = static_cast<std::size_t>(image->width) * image->height * 4 * 4 / 3;
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << image->path << std::endl;
+    }
+
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    TextureHandle handle = finishUpload(key, texture, time.count());
+    if (image->compressed.format && image->streamable)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        addStream(texture, {image.get()});
+    }
+    return handle;
+}
+
+TextureHandle TextureManager::finishUpload(Key const &key, TextureObject *texture, double uploadMs)
+{
+    TextureHandle handle(texture, [this, key](TextureObject *texture) { release(key, texture); });
+    std::lock_guard<std::mutex> lock(mutex);
+    textures[key] = handle;
+    stats.uploads++;
+    stats.residentBytes += texture->bytes;
+    stats.uploadMs += uploadMs;
+    return handle;
+}
+
+std::shared_ptr<DecodedImage> TextureManager::DecodeLayer(std::string const &path, TextureCompression compression,
+                                                          TextureUsage usage)
+{
+    return decodeShared(ResolvePath(path), compression, usage);
+}
+
+bool TextureManager::CanShareArray(DecodedImage const &a, DecodedImage const &b) noexcept
+{
+    // 流式加载的层只驻留低分辨率的几级, 不能与整条mip链都在内存里的层混在一起
+    if (a.width != b.width || a.height != b.height || a.compression != b.compression || a.usage != b.usage ||
+        a.streamable != b.streamable)
+        return false;
+    if (a.compressed.format || b.compressed.format)
+        return a.compressed.format == b.compressed.format && a.compressed.levels.size() == b.compressed.levels.size();
+    return a.data && b.data && a.nrComponents == b.nrComponents;
+}
+
+TextureHandle TextureManager::UploadArray(std::vector<std::shared_ptr<DecodedImage>> const &layers,
+                                          SamplerParams const &sampler, TextureCompression compression, TextureUsage usage)
+{
+    if (layers.empty())
+        return nullptr;
+    for (auto const &layer : layers)
+        if (!layer || layer->compression != compression || layer->usage != usage || !CanShareArray(*layers[0], *layer))
+        {
+            std::cout << "ERROR::TEXTURE::layers of a texture array must have the same size and format" << std::endl;
+            return nullptr;
+        }
+    DecodedImage const &first = *layers[0];
+    if (first.compressed.format && first.compressed.format != GL_COMPRESSED_RG_RGTC2 && !s3tcSupported())
+    {
+        std::cout << "ERROR::TEXTURE::S3TC not supported, cannot build a compressed texture array" << std::endl;
+        return nullptr;
+    }
+    // 键里的路径是各层路径依次拼接, 同一组层 (顺序也相同) 命中同一个数组
+    Key key{std::string(), sampler, compression, usage};
+    for (auto const &layer : layers)
+        key.path += layer->path + '|';
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (TextureHandle texture = findLocked(key))
+        {
+            stats.hits++;
+            return texture;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!uploadRing)
+        uploadRing = std::make_unique<PixelUploadRing>();
+    auto *texture = new TextureObject();
+    glGenTextures(1, &texture->id);
+    texture->target = GL_TEXTURE_2D_ARRAY;
+    texture->width = first.width;
+    texture->height = first.height;
+    texture->layers = static_cast<int>(layers.size());
+    bindForUpload(*texture);
+    std::vector<unsigned char> staging;
+    if (first.compressed.format)
+    {
+        // 各层驻留的级别可能不同 (有的来自缓存尾部, 有的刚编码完), 从所有层都有数据的一级开始
+        std::size_t levelCount = first.compressed.levels.size();
+        std::size_t base = 0;
+        for (auto const &layer : layers)
+        {
+            std::size_t layerBase = 0;
+            while (layerBase + 1 < levelCount && layer->compressed.levels[layerBase].data.empty())
+                layerBase++;
+            base = std::max(base, layerBase);
+        }
+        for (std::size_t level = base; level < levelCount; level++)
+        {
+            staging.clear();
+            for (auto const &layer : layers)
+            {
+                std::vector<unsigned char> const &data = layer->compressed.levels[level].data;
+                staging.insert(staging.end(), data.begin(), data.end());
+            }
+            CompressedLevel const &size = first.compressed.levels[level];
+            uploadRing->CompressedTexImage3D(static_cast<GLint>(level), first.compressed.format, size.width, size.height,
+                                             texture->layers, staging.data(), staging.size());
+            texture->bytes += staging.size();
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(base));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levelCount) - 1);
+        if (first.streamable && base > 0)
+        {
+            std::vector<DecodedImage const *> images;
+            for (auto const &layer : layers)
+                images.push_back(layer.get());
+            std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+            TextureHandle handle = finishUpload(key, texture, time.count());
+            std::lock_guard<std::mutex> lock(mutex);
+            addStream(texture, images);
+            return handle;
+        }
+    }
+    else
+    {
+        // 各层通道数相同 (CanShareArray), staging 每层的大小与 format 一致
+        GLenum format = pixelFormat(first.nrComponents);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (std::size_t level = 0; level <= first.mips.size(); level++)
+        {
+            staging.clear();
+            for (auto const &layer : layers)
+            {
+                if (level == 0)
+                    staging.insert(staging.end(), layer->data,
+                                   layer->data + static_cast<std::size_t>(layer->width) * layer->height * layer->nrComponents);
+                else
+                    staging.insert(staging.end(), layer->mips[level - 1].data.begin(), layer->mips[level - 1].data.end());
+            }
+            int width = level == 0 ? first.width : first.mips[level - 1].width;
+            int height = level == 0 ? first.height : first.mips[level - 1].height;
+            uploadRing->TexImage3D(static_cast<GLint>(level), format, width, height, texture->layers, format,
+                                   GL_UNSIGNED_BYTE, staging.data(), staging.size());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(first.mips.size()));
+        texture->bytes = static_cast<std::size_t>(first.width) * first.height * 4 * 4 / 3 * layers.size();
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, sampler.wrapS);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, sampler.wrapT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    return finishUpload(key, texture, time.count());
+}
+
+void TextureManager::Bind(unsigned int unit, TextureObject const &texture)
+{
+    if (GLState::Instance().BindTexture(unit, texture.target, texture.id))
+        renderStats.textureBinds++;
+}
+
+void TextureManager::bindForUpload(TextureObject const &texture)
+{
+    GLState::Instance().BindTexture(texture.target, texture.id);
+}
+
+void TextureManager::release(Key const &key, TextureObject *texture)
+{
+    glDeleteTextures(1, &texture->id);
+    GLState::Instance().DeletedTexture(texture->id);
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.residentBytes -= texture->bytes;
+    auto stream = streams.find(texture->id);
+    if (stream != streams.end() && stream->second.texture == texture)
+    {
+        stats.streamingBytes -= texture->bytes;
+        streams.erase(stream);
+    }
+    delete texture;
+    auto it = textures.find(key);
+    if (it != textures.end() && it->second.expired())
+        textures.erase(it);
+}
+
+void TextureManager::addStream(TextureObject *texture, std::vector<DecodedImage const *> const &layers)
+{
+    std::vector<CompressedLevel> const &levels = layers[0]->compressed.levels;
+    int tail = 0;
+    for (DecodedImage const *layer : layers)
+    {
+        int layerTail = 0;
+        while (layerTail + 1 < static_cast<int>(levels.size()) && layer->compressed.levels[layerTail].data.empty())
+            layerTail++;
+        tail = std::max(tail, layerTail);
+    }
+    if (tail == 0)
+        return; // 整条mip链都已驻留
+
+    Stream stream;
+    stream.texture = texture;
+    stream.serial = nextStreamSerial++;
+    for (DecodedImage const *layer : layers)
+        stream.paths.push_back(layer->path);
+    stream.format = layers[0]->compressed.format;
+    stream.srgb = layers[0]->usage == TextureUsage::Color;
+    std::size_t blockBytes = stream.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+    for (CompressedLevel const &level : levels)
+        stream.levelBytes.push_back(static_cast<std::size_t>((level.width + 3) / 4) * ((level.height + 3) / 4) * blockBytes *
+                                    layers.size());
+    stream.tailLevel = stream.baseLevel = stream.wantedLevel = tail;
+    stream.requestedLevel = static_cast<int>(levels.size());
+    stream.lastRequestFrame = streamFrame;
+    streams[texture->id] = std::move(stream);
+    stats.streamingBytes += texture->bytes;
+}
+
+void TextureManager::dropLevels(Stream &stream, int newBase)
+{
+    GLenum target = stream.texture->target;
+    bindForUpload(*stream.texture);
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, newBase);
+    for (int level = stream.baseLevel; level < newBase; level++)
+    {
+        // 重新定义为空图像, 驱动释放这一级的存储
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glCompressedTexImage3D(target, level, stream.format, 0, 0, 0, 0, 0, nullptr);
+        else
+            glCompressedTexImage2D(target, level, stream.format, 0, 0, 0, 0, nullptr);
+        stream.texture->bytes -= stream.levelBytes[level];
+        stats.residentBytes -= stream.levelBytes[level];
+        stats.streamingBytes -= stream.levelBytes[level];
+        stats.evictedLevels++;
+    }
+    stream.baseLevel = newBase;
+}
+
+void TextureManager::RequestMip(TextureHandle const &texture, int level)
+{
+    if (!texture)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = streams.find(texture->id);
+    if (it == streams.end() || it->second.texture != texture.get())
+        return;
+    Stream &stream = it->second;
+    stream.requestedLevel = std::min(stream.requestedLevel, std::clamp(level, 0, stream.tailLevel));
+    stream.lastRequestFrame = streamFrame;
+}
+
+void TextureManager::SetStreamingBudget(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    streaming = bytes > 0;
+    streamingBudget = bytes;
+}
+
+void TextureManager::UpdateStreaming()
+{
+    std::vector<StreamResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(streamQueue->mutex);
+        finished.swap(streamQueue->finished);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    streamFrame++;
+
+    // 上传读好的级别
+    for (StreamResult &result : finished)
+    {
+        stats.pendingStreams--;
+        auto it = streams.find(result.id);
+        if (it == streams.end() || it->second.serial != result.serial)
+            continue; // 纹理已释放
+        Stream &stream = it->second;
+        stream.loading = false;
+        if (!result.ok || result.data.data.size() != stream.levelBytes[result.level])
+        {
+            // 缓存文件被删除或改写, 这个纹理停留在当前的分辨率
+            std::cout << "WARNING::TEXTURESTREAM::could not read level " << result.level << " of " << stream.paths[0] << std::endl;
+            stats.streamingBytes -= stream.texture->bytes;
+            streams.erase(it);
+            continue;
+        }
+        if (result.level != stream.baseLevel - 1)
+            continue; // 读取期间被淘汰过
+        if (!uploadRing)
+            uploadRing = std::make_unique<PixelUploadRing>();
+        bindForUpload(*stream.texture);
+        if (stream.texture->target == GL_TEXTURE_2D_ARRAY)
+            uploadRing->CompressedTexImage3D(result.level, stream.format, result.data.width, result.data.height,
+                                             stream.texture->layers, result.data.data.data(), result.data.data.size());
+        else
+            uploadRing->CompressedTexImage2D(result.level, stream.format, result.data.width, result.data.height,
+                                             result.data.data.data(), result.data.data.size());
+        glTexParameteri(stream.texture->target, GL_TEXTURE_BASE_LEVEL, result.level);
+        stream.baseLevel = result.level;
+        stream.texture->bytes += result.data.data.size();
+        stats.residentBytes += result.data.data.size();
+        stats.streamingBytes += result.data.data.size();
+        stats.streamedLevels++;
+    }
+
+    // 更新每个纹理需要的级别; 长时间没有请求的纹理淘汰到初始的低分辨率
+    std::vector<Stream *> wanting;
+    std::size_t pendingBytes = 0;
+    for (auto &entry : streams)
+    {
+        Stream &stream = entry.second;
+        int levelCount = static_cast<int>(stream.levelBytes.size());
+        bool visible = streamFrame - stream.lastRequestFrame <= STREAM_EVICT_FRAMES;
+        if (stream.requestedLevel < levelCount)
+        {
+            stream.wantedLevel = stream.requestedLevel;
+            stream.requestedLevel = levelCount;
+        }
+        else if (!visible)
+            stream.wantedLevel = stream.tailLevel;
+        if (stream.loading)
+            pendingBytes += stream.levelBytes[stream.baseLevel - 1];
+        else if (!visible && stream.baseLevel < stream.tailLevel)
+            dropLevels(stream, stream.tailLevel);
+        else if (stream.wantedLevel < stream.baseLevel)
+            wanting.push_back(&stream);
+    }
+
+    // 超出预算时从最久未请求、且驻留得比需要更清晰的纹理开始淘汰
+    auto evict = [this](std::size_t target, Stream const *requester) {
+        std::vector<Stream *> candidates;
+        for (auto &entry : streams)
+            if (&entry.second != requester && !entry.second.loading && entry.second.baseLevel < entry.second.wantedLevel)
+                candidates.push_back(&entry.second);
+        std::sort(candidates.begin(), candidates.end(),
+                  [](Stream const *a, Stream const *b) { return a->lastRequestFrame < b->lastRequestFrame; });
+        for (Stream *stream : candidates)
+        {
+            while (stats.streamingBytes > target && stream->baseLevel < stream->wantedLevel)
+                dropLevels(*stream, stream->baseLevel + 1);
+            if (stats.streamingBytes <= target)
+                break;
+        }
+        return stats.streamingBytes <= target;
+    };
+    if (stats.streamingBytes > streamingBudget)
+        evict(streamingBudget, nullptr);
+
+    // 缺得最多的先载入; 每次只读比当前清晰一级, 逐帧逼近需要的级别
+    std::sort(wanting.begin(), wanting.end(), [](Stream const *a, Stream const *b) {
+        return a->baseLevel - a->wantedLevel > b->baseLevel - b->wantedLevel;
+    });
+    bool rejected = false;
+    for (Stream *stream : wanting)
+    {
+        if (stats.pendingStreams >= MAX_PENDING_STREAMS)
+            break;
+        int level = stream->baseLevel - 1;
+        std::size_t bytes = stream->levelBytes[level];
+        if (stats.streamingBytes + pendingBytes + bytes > streamingBudget &&
+            (pendingBytes + bytes > streamingBudget || !evict(streamingBudget - pendingBytes - bytes, stream)))
+        {
+            rejected = true;
+            continue;
+        }
+        stream->loading = true;
+        stats.pendingStreams++;
+        pendingBytes += bytes;
+        ThreadPool::Global().Submit([queue = streamQueue, paths = stream->paths, srgb = stream->srgb, id = stream->texture->id,
+                                     serial = stream->serial, level]() {
+            StreamResult result{id, serial, level, true, CompressedLevel()};
+            // 纹理数组的一级是各层同一级的拼接
+            for (std::string const &path : paths)
+            {
+                CompressedLevel layer;
+                result.ok = result.ok && TextureCache::LoadLevel(path, srgb, static_cast<unsigned int>(level), layer);
+                result.data.width = layer.width;
+                result.data.height = layer.height;
+                result.data.data.insert(result.data.data.end(), layer.data.begin(), layer.data.end());
+            }
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->finished.push_back(std::move(result));
+        });
+    }
+    if (rejected)
+        stats.budgetRejects++;
+}
+
+TextureManager::Stats TextureManager::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    if (uploadRing)
+        result.ring = uploadRing->GetStats();
+    result.streamingTextures = streams.size();
+    result.streamingBudget = streaming ? streamingBudget : 0;
+    result.resident = 0;
+    for (auto const &entry : textures)
+        result.resident += !entry.second.expired();
+    return result;
+}
@@ -0,0 +1,81 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : stopping(false)
+{
+    threadCount = std::max(1u, threadCount);
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+ThreadPool &ThreadPool::Global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    available.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::runParallel(ParallelState &state)
+{
+    // 抢到的下标才会调用body, 迟到的辅助任务直接退出而不访问调用者的栈
+    for (std::size_t i = state.next.fetch_add(1); i < state.count; i = state.next.fetch_add(1))
+    {
+        // 异常不能离开这里: 在辅助线程上会终止进程, 在调用线程上会让其余线程访问已销毁的fn
+        if (!state.failed.load())
+        {
+            try
+            {
+                state.body(i);
+            }
+            catch (...)
+            {
+                if (!state.failed.exchange(true))
+                    state.error = std::current_exception();
+            }
+        }
+        if (state.done.fetch_add(1) + 1 == state.count)
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished.notify_all();
+        }
+    }
+}